@@ -0,0 +1,519 @@
+/*
+
+A compact mesh format for moving meshes between machines and disks.
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "learnply.h"
+#include "compressed_mesh.h"
+
+
+/* size of the buffers that the coded streams go through */
+#define CODE_BUFFER_SIZE  (1 << 16)
+
+
+/******************************************************************************
+Buffered output of a coded stream.
+******************************************************************************/
+
+typedef struct CodeWriter {
+  FILE *fp;
+  unsigned char buffer[CODE_BUFFER_SIZE];
+  int used;
+} CodeWriter;
+
+static void flush_code(CodeWriter *out)
+{
+  fwrite (out->buffer, 1, out->used, out->fp);
+  out->used = 0;
+}
+
+static void put_code_byte(CodeWriter *out, unsigned char byte)
+{
+  if (out->used == CODE_BUFFER_SIZE)
+    flush_code (out);
+  out->buffer[out->used++] = byte;
+}
+
+/* write an unsigned integer seven bits at a time, low bits first */
+static void put_varint(CodeWriter *out, unsigned long long value)
+{
+  while (value >= 0x80) {
+    put_code_byte (out, (unsigned char) (value | 0x80));
+    value >>= 7;
+  }
+  put_code_byte (out, (unsigned char) value);
+}
+
+/* write a signed integer, small magnitudes of either sign taking few bytes */
+static void put_signed_varint(CodeWriter *out, long long value)
+{
+  put_varint (out, ((unsigned long long) value << 1) ^ (unsigned long long) (value >> 63));
+}
+
+static void put_float64(CodeWriter *out, double value)
+{
+  unsigned long long bits;
+  int i;
+
+  memcpy (&bits, &value, sizeof (bits));
+  for (i = 0; i < 8; i++)
+    put_code_byte (out, (unsigned char) (bits >> (8 * i)));
+}
+
+
+/******************************************************************************
+Buffered input of a coded stream.  A file that ends early, or a number
+that runs on too long, marks the stream as bad; from then on every byte
+reads as zero, and the reader checks "bad" before using what it got.
+******************************************************************************/
+
+typedef struct CodeReader {
+  FILE *fp;
+  unsigned char buffer[CODE_BUFFER_SIZE];
+  int used;
+  int len;
+  int bad;
+} CodeReader;
+
+static unsigned char get_code_byte(CodeReader *in)
+{
+  if (in->used == in->len) {
+    in->len = in->bad ? 0 : (int) fread (in->buffer, 1, CODE_BUFFER_SIZE, in->fp);
+    in->used = 0;
+    if (in->len == 0) {
+      in->bad = 1;
+      return (0);
+    }
+  }
+  return (in->buffer[in->used++]);
+}
+
+static unsigned long long get_varint(CodeReader *in)
+{
+  unsigned long long value = 0;
+  int shift = 0;
+  unsigned char byte;
+
+  /* away from the end of the buffer, a number is decoded without refill checks */
+  if (in->len - in->used >= 10) {
+    unsigned char *ptr = in->buffer + in->used;
+    do {
+      byte = *ptr++;
+      value |= (unsigned long long) (byte & 0x7f) << shift;
+      shift += 7;
+    } while ((byte & 0x80) && shift < 70);
+    in->used = (int) (ptr - in->buffer);
+    if (byte & 0x80)
+      in->bad = 1;
+    return (value);
+  }
+
+  do {
+    byte = get_code_byte (in);
+    if (shift > 63) {
+      in->bad = 1;
+      return (value);
+    }
+    value |= (unsigned long long) (byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+
+  return (value);
+}
+
+static long long get_signed_varint(CodeReader *in)
+{
+  unsigned long long value = get_varint (in);
+  return ((long long) (value >> 1) ^ -(long long) (value & 1));
+}
+
+static double get_float64(CodeReader *in)
+{
+  unsigned long long bits = 0;
+  double value;
+  int i;
+
+  for (i = 0; i < 8; i++)
+    bits |= (unsigned long long) get_code_byte (in) << (8 * i);
+  memcpy (&value, &bits, sizeof (value));
+  return (value);
+}
+
+
+/******************************************************************************
+Order the triangles of a polyhedron so that each one shares vertices with
+those just before it.  The vertices are walked breadth first, starting
+again at the first triangle not yet reached for each piece of the mesh, and
+the triangles around each vertex are taken as it is come to.  Only the
+triangle list is used, so the polyhedron needn't be initialized.
+
+Entry:
+  poly - polyhedron whose vertices are indexed by their place in its list
+
+Exit:
+  tri_order - the triangles' places in the triangle list, in the new order
+******************************************************************************/
+
+static void order_triangles(Polyhedron *poly, std::vector<int> &tri_order)
+{
+  int i,j;
+  int nverts = poly->nverts;
+  int ntris = poly->ntris;
+
+  /* the triangles around each vertex, one vertex after another */
+
+  std::vector<int> start (nverts + 1, 0);
+  std::vector<int> vert_tris (3 * (size_t) ntris);
+
+  for (i = 0; i < ntris; i++)
+    for (j = 0; j < 3; j++)
+      start[poly->tlist[i]->verts[j]->index + 1]++;
+  for (i = 0; i < nverts; i++)
+    start[i + 1] += start[i];
+
+  std::vector<int> fill (start.begin (), start.end () - 1);
+  for (i = 0; i < ntris; i++)
+    for (j = 0; j < 3; j++)
+      vert_tris[fill[poly->tlist[i]->verts[j]->index]++] = i;
+
+  /* walk the vertices */
+
+  std::vector<char> tri_done (ntris, 0);
+  std::vector<char> vert_seen (nverts, 0);
+  std::vector<int> queue;
+  queue.reserve (nverts);
+  tri_order.clear ();
+  tri_order.reserve (ntris);
+
+  for (int seed = 0; seed < ntris; seed++) {
+    if (tri_done[seed])
+      continue;
+    int v = poly->tlist[seed]->verts[0]->index;
+    vert_seen[v] = 1;
+    queue.push_back (v);
+
+    for (size_t next = queue.size () - 1; next < queue.size (); next++) {
+      v = queue[next];
+      for (int k = start[v]; k < start[v + 1]; k++) {
+        int t = vert_tris[k];
+        if (tri_done[t])
+          continue;
+        tri_done[t] = 1;
+        tri_order.push_back (t);
+        for (j = 0; j < 3; j++) {
+          int u = poly->tlist[t]->verts[j]->index;
+          if (!vert_seen[u]) {
+            vert_seen[u] = 1;
+            queue.push_back (u);
+          }
+        }
+      }
+    }
+  }
+}
+
+
+/******************************************************************************
+Write a polyhedron as a compressed mesh.
+
+Entry:
+  poly - polyhedron to write, which needn't be initialized
+  name - name of the file to write
+  bits - number of bits each coordinate is quantized to
+
+Exit:
+  returns 1 if the file was written, 0 if not
+******************************************************************************/
+
+int write_compressed_mesh(Polyhedron *poly, char *name, int bits)
+{
+  int i,j,k;
+  int nverts = poly->nverts;
+  int ntris = poly->ntris;
+  double min[3], scale[3];
+  long long levels = (1LL << bits) - 1;
+
+  if (bits < 1 || bits > 30)
+    return (0);
+
+  /* put the triangles in walking order, and number the vertices in the
+     order the triangles first use them */
+
+  std::vector<int> tri_order;
+  order_triangles (poly, tri_order);
+
+  std::vector<int> new_index (nverts, -1);
+  std::vector<Vertex *> order;
+  order.reserve (nverts);
+
+  for (i = 0; i < ntris; i++)
+    for (j = 0; j < 3; j++) {
+      int old = poly->tlist[tri_order[i]]->verts[j]->index;
+      if (new_index[old] == -1) {
+        new_index[old] = (int) order.size ();
+        order.push_back (poly->vlist[old]);
+      }
+    }
+
+  /* vertices that no triangle uses go last */
+  for (i = 0; i < nverts; i++)
+    if (new_index[i] == -1) {
+      new_index[i] = (int) order.size ();
+      order.push_back (poly->vlist[i]);
+    }
+
+  poly->calc_bounding_sphere ();
+  for (k = 0; k < 3; k++) {
+    double extent = poly->bbox_max.entry[k] - poly->bbox_min.entry[k];
+    min[k] = poly->bbox_min.entry[k];
+    scale[k] = (extent > 0) ? levels / extent : 0;
+  }
+
+  CodeWriter *out = new CodeWriter;
+  out->fp = fopen (name, "wb");
+  out->used = 0;
+  if (out->fp == NULL) {
+    delete out;
+    return (0);
+  }
+
+  /* header */
+
+  for (i = 0; i < 8; i++)
+    put_code_byte (out, (unsigned char) "PLYQMESH"[i]);
+  put_varint (out, COMPRESSED_MESH_VERSION);
+  put_varint (out, bits);
+  put_varint (out, nverts);
+  put_varint (out, ntris);
+  for (k = 0; k < 3; k++)
+    put_float64 (out, poly->bbox_min.entry[k]);
+  for (k = 0; k < 3; k++)
+    put_float64 (out, poly->bbox_max.entry[k]);
+
+  /* quantized positions, each one relative to the one before */
+
+  long long last[3] = {0, 0, 0};
+
+  for (i = 0; i < nverts; i++) {
+    icVector3 p = order[i]->pos ();
+    double pos[3] = {p.x, p.y, p.z};
+    for (k = 0; k < 3; k++) {
+      long long q = (long long) floor ((pos[k] - min[k]) * scale[k] + 0.5);
+      if (q < 0) q = 0;
+      if (q > levels) q = levels;
+      put_signed_varint (out, q - last[k]);
+      last[k] = q;
+    }
+  }
+
+  /* triangles, each index relative to the one before */
+
+  long long last_index = 0;
+
+  for (i = 0; i < ntris; i++)
+    for (j = 0; j < 3; j++) {
+      long long index = new_index[poly->tlist[tri_order[i]]->verts[j]->index];
+      put_signed_varint (out, index - last_index);
+      last_index = index;
+    }
+
+  flush_code (out);
+  int ok = !ferror (out->fp);
+  if (fclose (out->fp) != 0)
+    ok = 0;
+  delete out;
+
+  return (ok);
+}
+
+
+/******************************************************************************
+See whether an open file is a compressed mesh.  The file is left at its start.
+******************************************************************************/
+
+int is_compressed_mesh(FILE *fp)
+{
+  char magic[8];
+  size_t n = fread (magic, 1, 8, fp);
+
+  rewind (fp);
+  return (n == 8 && memcmp (magic, "PLYQMESH", 8) == 0);
+}
+
+
+/******************************************************************************
+Read the counts from the start of a compressed mesh, without decoding the
+rest of it.  The file is left at its start.
+
+Entry:
+  fp - the open file
+
+Exit:
+  nverts, ntris - the counts the file declares
+  returns 1 if the file is a compressed mesh of a known version, 0 if not
+******************************************************************************/
+
+int probe_compressed_mesh(FILE *fp, size_t *nverts, size_t *ntris)
+{
+  char magic[8];
+  int i;
+
+  CodeReader *in = new CodeReader;
+  in->fp = fp;
+  in->used = in->len = 0;
+  in->bad = 0;
+
+  for (i = 0; i < 8; i++)
+    magic[i] = (char) get_code_byte (in);
+
+  int version = (int) get_varint (in);
+  get_varint (in);  /* bits */
+  *nverts = (size_t) get_varint (in);
+  *ntris = (size_t) get_varint (in);
+
+  int ok = !in->bad && memcmp (magic, "PLYQMESH", 8) == 0 &&
+           version == COMPRESSED_MESH_VERSION;
+  delete in;
+  rewind (fp);
+  return (ok);
+}
+
+
+/******************************************************************************
+Give up on a compressed mesh that can't be read, saying why.
+
+Entry:
+  in      - the stream being read
+  poly    - the polyhedron being filled, or NULL if there is none yet
+  problem - what is wrong with the file, or NULL if it has been reported
+
+Exit:
+  returns NULL, with the stream and the polyhedron deleted
+******************************************************************************/
+
+static Polyhedron *bad_compressed_mesh(CodeReader *in, Polyhedron *poly, const char *problem)
+{
+  if (in->bad)
+    fprintf (stderr, "compressed mesh ends early\n");
+  else if (problem != NULL)
+    fprintf (stderr, "%s\n", problem);
+  delete in;
+  if (poly != NULL) {
+    poly->finalize ();
+    delete poly;
+  }
+  return (NULL);
+}
+
+
+/******************************************************************************
+Read a compressed mesh into a new polyhedron.  The vertices and triangles
+are created as their codes are read, so nothing but the polyhedron and a
+small buffer is held in memory.
+
+Entry:
+  fp - the open file, at its start
+
+Exit:
+  returns the polyhedron, which still has to be initialized, or NULL (with
+  the problem reported on stderr) if the file is malformed or ends early
+******************************************************************************/
+
+Polyhedron *read_compressed_mesh(FILE *fp)
+{
+  int i,j,k;
+  char magic[8];
+  Polyhedron *poly;
+
+  CodeReader *in = new CodeReader;
+  in->fp = fp;
+  in->used = in->len = 0;
+  in->bad = 0;
+
+  for (i = 0; i < 8; i++)
+    magic[i] = (char) get_code_byte (in);
+  if (memcmp (magic, "PLYQMESH", 8) != 0) {
+    fprintf (stderr, "not a compressed mesh\n");
+    return (bad_compressed_mesh (in, NULL, NULL));
+  }
+
+  int version = (int) get_varint (in);
+  int bits = (int) get_varint (in);
+  unsigned long long nverts = get_varint (in);
+  unsigned long long ntris = get_varint (in);
+
+  if (in->bad)
+    return (bad_compressed_mesh (in, NULL, NULL));
+  if (version != COMPRESSED_MESH_VERSION || bits < 1 || bits > 30 ||
+      nverts > 0x7fffffff || ntris > 0x7fffffff) {
+    fprintf (stderr, "can't read compressed mesh of version %d\n", version);
+    return (bad_compressed_mesh (in, NULL, NULL));
+  }
+
+  double min[3], max[3], step[3];
+  long long levels = (1LL << bits) - 1;
+
+  for (k = 0; k < 3; k++)
+    min[k] = get_float64 (in);
+  for (k = 0; k < 3; k++)
+    max[k] = get_float64 (in);
+  for (k = 0; k < 3; k++)
+    step[k] = (max[k] - min[k]) / levels;
+  if (in->bad)
+    return (bad_compressed_mesh (in, NULL, NULL));
+
+  poly = new Polyhedron;
+  delete[] poly->vlist;
+  delete[] poly->tlist;
+
+  poly->nverts = poly->max_verts = (int) nverts;
+  poly->ntris = poly->max_tris = (int) ntris;
+  poly->vlist = new Vertex *[nverts];
+  poly->tlist = new Triangle *[ntris];
+  poly->vert_pool.reserve (nverts);
+  poly->tri_pool.reserve (ntris);
+
+  /* vertices */
+
+  long long q[3] = {0, 0, 0};
+
+  for (i = 0; i < (int) nverts; i++) {
+    for (k = 0; k < 3; k++) {
+      q[k] += get_signed_varint (in);
+      if (in->bad || q[k] < 0 || q[k] > levels)
+        return (bad_compressed_mesh (in, poly, "bad position in compressed mesh"));
+    }
+    Vertex *v = poly->make_vertex (min[0] + q[0] * step[0],
+                                   min[1] + q[1] * step[1],
+                                   min[2] + q[2] * step[2]);
+    v->other_props = NULL;
+    poly->vlist[i] = v;
+  }
+
+  /* triangles */
+
+  long long index = 0;
+
+  for (i = 0; i < (int) ntris; i++) {
+    Triangle *t = poly->tri_pool.make ();
+    t->nverts = 3;
+    t->other_props = NULL;
+    for (j = 0; j < 3; j++) {
+      index += get_signed_varint (in);
+      if (in->bad || index < 0 || index >= (long long) nverts)
+        return (bad_compressed_mesh (in, poly, "bad vertex index in compressed mesh"));
+      t->verts[j] = poly->vlist[index];
+    }
+    poly->tlist[i] = t;
+  }
+
+  delete in;
+  return (poly);
+}
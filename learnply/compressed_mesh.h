@@ -0,0 +1,58 @@
+/*
+
+A compact mesh format for moving meshes between machines and disks.
+
+A compressed mesh holds only vertex positions and triangles.  Positions are
+quantized against the mesh's bounding box.  The triangles are put in the
+order of a breadth-first walk over the mesh, and the vertices renumbered in
+the order the triangles first use them, so that consecutive vertices are
+close together and the triangles refer mostly to recent vertices.  Both
+streams are delta-coded and written as variable-length integers, and every
+multi-byte value is stored little-endian, so the files are portable.
+
+Layout:
+
+  "PLYQMESH"                       magic
+  varint version, bits, nverts, ntris
+  float64 min[3], max[3]           bounding box
+  nverts * 3 varints               zigzag deltas of the quantized x,y,z
+  ntris * 3 varints                zigzag deltas of the vertex indices
+
+*/
+
+#ifndef __COMPRESSED_MESH_H__
+#define __COMPRESSED_MESH_H__
+
+#include <stdio.h>
+
+class Polyhedron;
+
+#define COMPRESSED_MESH_VERSION  1
+
+/* default number of bits each coordinate is quantized to */
+const int COMPRESSED_MESH_BITS = 16;
+
+/*
+Write a polyhedron, which needn't be initialized, as a compressed mesh,
+with each coordinate quantized to "bits" bits (1 to 30).  Other properties
+and the order of the triangles are not kept.  Returns 1 on
+success, 0 if the file can't be written.
+*/
+int write_compressed_mesh(Polyhedron *, char *name, int bits = COMPRESSED_MESH_BITS);
+
+/* check whether an open file holds a compressed mesh, leaving it at its start */
+int is_compressed_mesh(FILE *);
+
+/* read the vertex and triangle counts of a compressed mesh, leaving it at
+   its start; returns 0 if it isn't one that can be read */
+int probe_compressed_mesh(FILE *, size_t *nverts, size_t *ntris);
+
+/*
+Read a compressed mesh, filling the vertex and triangle lists of a new
+polyhedron as the file is decoded.  The polyhedron is not initialized.
+Returns NULL, after saying what is wrong on stderr, if the file is
+malformed or ends early.
+*/
+Polyhedron *read_compressed_mesh(FILE *);
+
+#endif /* __COMPRESSED_MESH_H__ */
@@ -2,9 +2,9 @@
 
 void Corner::findAngle() {
 	//find vectors from self to other points
-	//printf("x: %lf\n", n->v->x);
-	icVector3 v1 = icVector3(n->v->x, n->v->y, n->v->z) - icVector3(v->x,v->y,v->z);
-	icVector3 v2 = icVector3(p->v->x, p->v->y, p->v->z) - icVector3(v->x, v->y, v->z);
+	//printf("x: %lf\n", n->v->pos().x);
+	icVector3 v1 = n->v->pos() - v->pos();
+	icVector3 v2 = p->v->pos() - v->pos();
 	double magv1 = length(v1);
 	double magv2 = length(v2);
 
@@ -0,0 +1,174 @@
+/*
+
+Compact corner table of a triangle mesh, after Rossignac.
+
+*/
+
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+
+#include "learnply.h"
+#include "corner_table.h"
+#include "parallel.h"
+
+
+/* fewest corners worth handing to a thread of their own */
+#define MIN_CORNER_BLOCK  65536
+
+/* bits of an edge key sorted on each pass */
+#define KEY_DIGIT_BITS  11
+
+
+int edge_key_bits(int nverts)
+{
+  int bits = 1;
+
+  while ((1LL << bits) < nverts)
+    bits++;
+  return (bits);
+}
+
+
+/******************************************************************************
+Sort edge keys with a least-significant-digit radix sort, which is stable,
+so that the corners of an edge come together in the order they are given.
+Each pass counts and then places the digits of a piece of the keys per
+thread, only going through as many digits as the keys have bits.
+
+Entry:
+  keys     - keys to sort
+  key_bits - number of bits the keys take
+
+Exit:
+  keys  - sorted
+  order - where each sorted key was in the keys as given
+******************************************************************************/
+
+void sort_edge_keys(std::vector<unsigned long long> &keys, int key_bits,
+                    std::vector<int> &order)
+{
+  const int radix = 1 << KEY_DIGIT_BITS;
+  size_t n = keys.size();
+  int nthreads = parallel_thread_count ((int) (n / MIN_CORNER_BLOCK));
+  int npasses = (key_bits + KEY_DIGIT_BITS - 1) / KEY_DIGIT_BITS;
+
+  std::vector<unsigned long long> sorted_keys (n);
+  std::vector<int> sorted (n);
+  std::vector<size_t> counts ((size_t) nthreads * radix);
+
+  order.resize (n);
+  for (size_t k = 0; k < n; k++)
+    order[k] = (int) k;
+
+  for (int pass = 0; pass < npasses; pass++) {
+    int shift = pass * KEY_DIGIT_BITS;
+
+    parallel_for (nthreads, [&](int t) {
+      size_t first = n * t / nthreads, last = n * (t + 1) / nthreads;
+      size_t *count = &counts[(size_t) t * radix];
+      std::fill (count, count + radix, 0);
+      for (size_t k = first; k < last; k++)
+        count[(keys[k] >> shift) & (radix - 1)]++;
+    });
+
+    /* each thread's keys with a digit go after those of earlier threads */
+    size_t total = 0;
+    for (int d = 0; d < radix; d++)
+      for (int t = 0; t < nthreads; t++) {
+        size_t c = counts[(size_t) t * radix + d];
+        counts[(size_t) t * radix + d] = total;
+        total += c;
+      }
+
+    parallel_for (nthreads, [&](int t) {
+      size_t first = n * t / nthreads, last = n * (t + 1) / nthreads;
+      size_t *next = &counts[(size_t) t * radix];
+      for (size_t k = first; k < last; k++) {
+        size_t to = next[(keys[k] >> shift) & (radix - 1)]++;
+        sorted_keys[to] = keys[k];
+        sorted[to] = order[k];
+      }
+    });
+
+    keys.swap (sorted_keys);
+    order.swap (sorted);
+  }
+}
+
+
+/******************************************************************************
+Build the corner table of a polyhedron from its triangles alone.
+
+The corners are sorted by the edge each one faces, and two corners that
+are alone on an edge and go along it in opposite directions are made each
+other's opposite.  Every vertex starts its swing at its lowest-numbered
+corner that has no previous corner around it, or at its lowest-numbered
+corner if it is not on a boundary.
+
+Entry:
+  poly - polyhedron whose vertex and triangle lists are filled in
+******************************************************************************/
+
+CornerTable::CornerTable(Polyhedron *poly)
+{
+  int ntris = poly->ntris;
+  int n = 3 * ntris;
+  int nthreads = parallel_thread_count (n / MIN_CORNER_BLOCK);
+
+  nverts = poly->nverts;
+
+  V.resize (n);
+  O.assign (n, -1);
+  first.assign (nverts, -1);
+
+  /* vertices, and the key of the edge each corner faces */
+
+  int bits = edge_key_bits (nverts);
+  std::vector<unsigned long long> keys (n);
+
+  parallel_for (nthreads, [&](int t) {
+    int first_tri = (int) ((size_t) ntris * t / nthreads);
+    int last_tri = (int) ((size_t) ntris * (t + 1) / nthreads);
+    for (int k = first_tri; k < last_tri; k++) {
+      Triangle *tri = poly->tlist[k];
+      V[3*k] = tri->verts[0]->index;
+      V[3*k+1] = tri->verts[1]->index;
+      V[3*k+2] = tri->verts[2]->index;
+    }
+    for (int c = 3 * first_tri; c < 3 * last_tri; c++)
+      keys[c] = edge_key (V[next (c)], V[prev (c)], bits);
+  });
+
+  std::vector<int> order;
+  sort_edge_keys (keys, 2 * bits, order);
+
+  /* pair the corners of edges that have just two, facing each other */
+
+  parallel_for (nthreads, [&](int t) {
+    int first_key = (int) ((size_t) n * t / nthreads);
+    int last_key = (int) ((size_t) n * (t + 1) / nthreads);
+    for (int k = first_key; k < last_key && k + 1 < n; k++) {
+      if (keys[k] != keys[k+1])
+        continue;
+      if ((k > 0 && keys[k-1] == keys[k]) || (k + 2 < n && keys[k+2] == keys[k]))
+        continue;
+      int a = order[k];
+      int b = order[k+1];
+      if (V[next (a)] == V[prev (b)]) {
+        O[a] = b;
+        O[b] = a;
+      }
+    }
+  });
+
+  /* where to start swinging around each vertex */
+
+  for (int c = 0; c < n; c++)
+    if (first[V[c]] == -1)
+      first[V[c]] = c;
+
+  for (int c = 0; c < n; c++)
+    if (unswing (c) == -1 && unswing (first[V[c]]) != -1)
+      first[V[c]] = c;
+}
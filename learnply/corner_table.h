@@ -0,0 +1,95 @@
+/*
+
+Compact corner table of a triangle mesh, after Rossignac.
+
+Corner 3t+k is the k'th corner of triangle t, so a corner's triangle, the
+next and the previous corner are found by arithmetic on its number, and
+the whole topology is two arrays of ints: the vertex of each corner and
+the corner opposite it, across the edge it faces.  The edge a corner faces
+is named by the lower-numbered of the corner and its opposite.
+
+O[c] is -1 where c's edge is on the boundary, is shared by more than two
+triangles, or is shared by two triangles that disagree on orientation, so
+that swinging around a vertex always stays on its corners and never loops
+without coming back to where it began.
+
+*/
+
+#ifndef __CORNER_TABLE_H__
+#define __CORNER_TABLE_H__
+
+#include <vector>
+
+class Polyhedron;
+
+class CornerTable {
+public:
+  std::vector<int> V;       /* vertex of each corner, three per triangle */
+  std::vector<int> O;       /* opposite corner, or -1 if there is none */
+  std::vector<int> first;   /* corner where swinging around each vertex starts, or -1 */
+  int nverts;
+
+public:
+  CornerTable(Polyhedron *);
+
+  int ncorners() const { return (int) V.size(); }
+  int ntris() const { return (int) V.size() / 3; }
+
+  static int tri(int c) { return c / 3; }
+  static int next(int c) { return (c % 3 == 2) ? c - 2 : c + 1; }
+  static int prev(int c) { return (c % 3 == 0) ? c + 2 : c - 1; }
+
+  int vert(int c) const { return V[c]; }
+  int opposite(int c) const { return O[c]; }
+
+  /* corner of the edge c faces that represents it: c or its opposite */
+  int edge(int c) const { return (O[c] != -1 && O[c] < c) ? O[c] : c; }
+
+  /* next corner around the vertex of c, turning toward prev(c), or -1 at a boundary */
+  int swing(int c) const { int o = O[next(c)]; return (o == -1) ? -1 : next(o); }
+
+  /* previous corner around the vertex of c, or -1 at a boundary */
+  int unswing(int c) const { int o = O[prev(c)]; return (o == -1) ? -1 : prev(o); }
+};
+
+/*
+Walk the corners around a vertex by swinging, starting at a boundary if
+the vertex is on one:
+
+  for (CornerSwing s(table, v); !s.done(); s.next())
+    ... s.corner() ...
+
+A vertex whose triangles form several fans (a non-manifold vertex) is only
+walked around the fan of first[v].
+*/
+class CornerSwing {
+  const CornerTable &table;
+  int start, c;
+
+public:
+  CornerSwing(const CornerTable &t, int vert) : table(t) { start = c = t.first[vert]; }
+
+  bool done() const { return c == -1; }
+  int corner() const { return c; }
+  void next() { c = table.swing(c); if (c == start) c = -1; }
+};
+
+/* number of bits a vertex index takes in an edge key */
+int edge_key_bits(int nverts);
+
+/* key of the edge between two vertices, the same whichever way it is given */
+inline unsigned long long edge_key(int a, int b, int bits)
+{
+  return (a < b) ? ((unsigned long long) a << bits) | (unsigned long long) b
+                 : ((unsigned long long) b << bits) | (unsigned long long) a;
+}
+
+/*
+Find the order that sorts edge keys of key_bits bits into increasing order,
+keeping equal keys in the order they are given: order[i] is the position of
+the i'th smallest key.  The keys are left sorted.
+*/
+void sort_edge_keys(std::vector<unsigned long long> &keys, int key_bits,
+                    std::vector<int> &order);
+
+#endif /* __CORNER_TABLE_H__ */
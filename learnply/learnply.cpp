@@ -8,6 +8,7 @@ Eugene Zhang, 2005
 #include <stdlib.h>
 #include <stdio.h>
 #include <algorithm>
+#include <atomic>
 #include <math.h>
 #include "glut.h"
 #include <string.h>
@@ -19,10 +20,15 @@ Eugene Zhang, 2005
 #include "learnply_io.h"
 #include "trackball.h"
 #include "tmatrix.h"
-
-static PlyFile *in_ply;
-
-unsigned char orientation;  // 0=ccw, 1=cw
+#include "stream_subdivide.h"
+#include "mesh_cache.h"
+#include "model_loader.h"
+#include "compressed_mesh.h"
+#include "mesh_formats.h"
+#include "mesh_weld.h"
+#include "parallel.h"
+#include "corner_table.h"
+#include "mesh_check.h"
 
 FILE *this_file;
 const int win_width=1024;
@@ -65,6 +71,61 @@ void display(void);
 void mouse(int button, int state, int x, int y);
 void display_shape(GLenum mode, Polyhedron *poly);
 
+/******************************************************************************
+Name a model after its file, without the directory or the extension.
+******************************************************************************/
+
+static char *model_name(char *path)
+{
+	char *start = path;
+	for (char *p = path; *p != '\0'; p++)
+		if (*p == '/' || *p == '\\')
+			start = p + 1;
+
+	char *name = strdup(start);
+	char *dot = strrchr(name, '.');
+	if (dot != NULL && dot != name)
+		*dot = '\0';
+	return name;
+}
+
+/******************************************************************************
+Describe a model from the header of its file, without reading the body:
+the file type, the elements with their counts and properties, and the
+memory the model would take once loaded.
+******************************************************************************/
+
+static int print_model_stats(char *path)
+{
+	static char *file_types[] = {"invalid", "ascii", "binary_big_endian", "binary_little_endian"};
+
+	PlyFile *ply = probe_ply(path);
+	if (ply == NULL) {
+		fprintf(stderr, "can't read the header of %s\n", path);
+		return 0;
+	}
+
+	printf("%s: %s\n", path, file_types[ply->file_type]);
+	for (int i = 0; i < ply->num_elem_types; i++) {
+		PlyElement *elem = ply->elems[i];
+		printf("  %s %d\n", elem->name, elem->num);
+		for (int j = 0; j < elem->nprops; j++) {
+			PlyProperty *prop = elem->props[j];
+			if (prop->is_list == PLY_LIST)
+				printf("    list %s %s %s\n", type_names[prop->count_external],
+					   type_names[prop->external_type], prop->name);
+			else if (prop->is_list == PLY_STRING)
+				printf("    string %s\n", prop->name);
+			else
+				printf("    %s %s\n", type_names[prop->external_type], prop->name);
+		}
+	}
+	free_ply(ply);
+
+	printf("  estimated memory %.1f MB\n", estimate_model_memory(path) / 1048576.0);
+	return 1;
+}
+
 /******************************************************************************
 Main program.
 ******************************************************************************/
@@ -77,35 +138,115 @@ int main(int argc, char *argv[])
 
   progname = argv[0];
 
+	/* learnply -weld <distance> ... merges vertices that close together in every model read below */
+	if (argc >= 3 && strcmp(argv[1], "-weld") == 0) {
+		weld_distance() = atof(argv[2]);
+		argv[2] = argv[0];
+		argv += 2;
+		argc -= 2;
+	}
+
+	/* learnply -subdivide <levels> <in.ply> <out.ply> subdivides out of core, without the viewer */
+	if (argc == 5 && strcmp(argv[1], "-subdivide") == 0)
+		return (stream_subdivide_regular(argv[3], argv[4], atoi(argv[2])) == 0) ? 0 : 1;
+
+	/* learnply -compress <in.ply> <out.plyq> [bits] writes a compressed mesh, without the viewer */
+	if ((argc == 4 || argc == 5) && strcmp(argv[1], "-compress") == 0) {
+		Polyhedron *in_poly = read_polyhedron(argv[2]);  // only the positions and triangles are needed
+		if (in_poly == NULL)
+			return 1;
+		int bits = (argc == 5) ? atoi(argv[4]) : COMPRESSED_MESH_BITS;
+		return write_compressed_mesh(in_poly, argv[3], bits) ? 0 : 1;
+	}
+
+	/* learnply -convert <in> <out> [levels] subdivides a model and writes it in the format its name gives */
+	if ((argc == 4 || argc == 5) && strcmp(argv[1], "-convert") == 0) {
+		Polyhedron *in_poly = load_polyhedron(argv[2]);
+		if (in_poly == NULL)
+			return 1;
+		int levels = (argc == 5) ? atoi(argv[4]) : 0;
+		for (int i = 0; i < levels; i++)
+			in_poly->subdivideRegular();
+
+		char *dot = strrchr(argv[3], '.');
+		if (dot != NULL && strcmp(dot, ".plyq") == 0)
+			return write_compressed_mesh(in_poly, argv[3]) ? 0 : 1;
+		if (mesh_format(argv[3]) == MESH_FORMAT_OBJ)
+			return write_obj_mesh(in_poly, argv[3]) ? 0 : 1;
+		if (mesh_format(argv[3]) == MESH_FORMAT_STL)
+			return write_stl_mesh(in_poly, argv[3]) ? 0 : 1;
+
+		this_file = fopen(argv[3], "wb");
+		if (this_file == NULL)
+			return 1;
+		in_poly->write_file(this_file);  // in the input's PLY format; closes the file
+		return 0;
+	}
+
+	/* learnply -stats <model.ply ...> describes models from their headers, without the viewer */
+	if (argc >= 3 && strcmp(argv[1], "-stats") == 0) {
+		int ok = 1;
+		for (int i = 2; i < argc; i++)
+			ok &= print_model_stats(argv[i]);
+		return ok ? 0 : 1;
+	}
+
+	/* learnply -check <model ...> reports on the topology of models before it is built, without the viewer */
+	if (argc >= 3 && strcmp(argv[1], "-check") == 0) {
+		int ok = 1;
+		for (int i = 2; i < argc; i++) {
+			Polyhedron *in_poly = read_polyhedron(argv[i]);
+			if (in_poly == NULL) {  // can't be opened, isn't a mesh, or has faces that aren't triangles
+				printf("%s:\n  can't read\n", argv[i]);
+				ok = 0;
+				continue;
+			}
+			MeshReport report;
+			int good = check_mesh(in_poly, &report);
+			print_mesh_report(stdout, argv[i], &report);
+			printf("  %s\n", good ? "ok" : "has problems");
+			ok &= good;
+			in_poly->finalize();
+			delete in_poly;
+		}
+		return ok ? 0 : 1;
+	}
+
+	/* learnply [-budget <megabytes>] [-noprefetch] [model.ply ...] views the given models instead of the usual ones */
 	std::vector<char*> filepaths;
-	filepaths.push_back("../tempmodels/tetrahedron.ply");
-	modelNames.push_back("Tetrahedron");
-	filepaths.push_back("../tempmodels/dragon.ply");
-	modelNames.push_back("Dragon");
-	filepaths.push_back("../tempmodels/bunny.ply");
-	modelNames.push_back("Bunny");
-	filepaths.push_back("../tempmodels/feline.ply");
-	modelNames.push_back("Feline");
-	filepaths.push_back("../tempmodels/torus.ply");
-	modelNames.push_back("Torus");
-	
-	filepaths.push_back("../tempmodels/sphere.ply");
-	modelNames.push_back("Sphere");
-
-	polys.clear();
-	for (auto fp : filepaths) {
-		FILE* openfp = fopen(fp, "r");
-		poly = new Polyhedron(openfp);
-		fclose(openfp);
-		/*initialize the mesh*/
-		poly->initialize(); // initialize the mesh
-		poly->calc_bounding_sphere();
-		poly->calc_face_normals_and_area();
-		poly->average_normals();
-		//poly->subdivideRegular();
-		polys.push_back(poly);
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-budget") == 0 && i + 1 < argc)
+			model_memory_budget() = (size_t)atoi(argv[++i]) << 20;
+		else if (strcmp(argv[i], "-noprefetch") == 0)
+			model_prefetch() = false;
+		else {
+			filepaths.push_back(argv[i]);
+			modelNames.push_back(model_name(argv[i]));
+		}
 	}
-	poly = polys[0];
+
+	if (filepaths.empty()) {
+		filepaths.push_back("../tempmodels/tetrahedron.ply");
+		modelNames.push_back("Tetrahedron");
+		filepaths.push_back("../tempmodels/dragon.ply");
+		modelNames.push_back("Dragon");
+		filepaths.push_back("../tempmodels/bunny.ply");
+		modelNames.push_back("Bunny");
+		filepaths.push_back("../tempmodels/feline.ply");
+		modelNames.push_back("Feline");
+		filepaths.push_back("../tempmodels/torus.ply");
+		modelNames.push_back("Torus");
+
+		filepaths.push_back("../tempmodels/sphere.ply");
+		modelNames.push_back("Sphere");
+	}
+
+	/*models are read on worker threads when they are first selected, or beforehand when they are
+	  next to the selected one, and dropped again when memory runs short*/
+	open_model_list(filepaths, polys);
+	poly = select_model(0);
+	if (poly == NULL)
+		return 1;
 
 	mat_ident( rotmat );	
 	glutInit(&argc, argv);
@@ -119,7 +260,7 @@ int main(int argc, char *argv[])
 	glutMotionFunc (motion);
 	glutMouseFunc (mouse);
 	glutMainLoop(); 
-	poly->finalize();  // finalize everything
+	close_model_list();  // finalize everything
 
   return 0;    /* ANSI C requires main to return int. */
 }
@@ -154,7 +295,33 @@ void color_mapping(double percentage, double col[3])
 }
 
 /******************************************************************************
-Read in a polyhedron from a file.
+Give a block of other_props copies of its lists and strings, in storage
+that is kept along with the block.
+
+Entry:
+  other  - description of the other_props
+  block  - other_props of "count" elements
+  count  - number of elements
+  blocks - where the polyhedron keeps blocks of this element's other_props
+******************************************************************************/
+
+static void copy_other_lists(PlyOtherProp *other, char *block, int count,
+                             std::vector<char *> &blocks)
+{
+  size_t size = other_lists_size_ply (other, block, count);
+
+  if (size == 0)
+    return;
+
+  char *storage = new char[size];
+  copy_other_lists_ply (other, block, count, storage);
+  blocks.push_back (storage);
+}
+
+/******************************************************************************
+Read in a polyhedron from a file.  A file that isn't PLY, has a face that
+isn't a triangle, or has a face using a vertex it doesn't have is reported
+on stderr, and the polyhedron is left empty with read_failed set.
 ******************************************************************************/
 
 Polyhedron::Polyhedron(FILE *file)
@@ -163,8 +330,23 @@ Polyhedron::Polyhedron(FILE *file)
   int elem_count;
   char *elem_name;
 
+  nverts = max_verts = ntris = max_tris = 0;
+  vlist = NULL;
+  tlist = NULL;
+  vert_other = face_other = NULL;
+  vert_rules = face_rules = NULL;
+
   /*** Read in the original PLY object ***/
   in_ply = read_ply (file);
+  if (in_ply == NULL) {
+    fprintf (stderr, "Not a PLY file.\n");
+    fclose (file);
+    read_failed = 1;
+    return;
+  }
+
+  /* lists and other_props are only needed until they are copied out */
+  use_arena_ply (in_ply);
 
   for (i = 0; i < in_ply->num_elem_types; i++) {
 
@@ -176,6 +358,7 @@ Polyhedron::Polyhedron(FILE *file)
       /* create a vertex list to hold all the vertices */
       nverts = max_verts = elem_count;
       vlist = new Vertex *[nverts];
+      vert_pool.reserve (nverts);
 
       /* set up for getting vertex elements */
 
@@ -185,52 +368,105 @@ Polyhedron::Polyhedron(FILE *file)
       vert_other = get_other_properties_ply (in_ply, 
 					     offsetof(Vertex_io,other_props));
 
-      /* grab all the vertex elements */
+      /* grab all the vertex elements in one go */
+      Vertex_io *verts_io = new Vertex_io[nverts];
+      get_element_block_ply (in_ply, (void *) verts_io, sizeof (Vertex_io), nverts);
+
+      /* the other_props of all the vertices go in one block */
+      char *other_data = NULL;
+      if (vert_other->size > 0) {
+        other_data = new char[(size_t) vert_other->size * nverts];
+        vert_other_data.push_back (other_data);
+      }
+
       for (j = 0; j < nverts; j++) {
-        Vertex_io vert;
-        get_element_ply (in_ply, (void *) &vert);
+        Vertex_io &vert = verts_io[j];
 
         /* copy info from the "vert" structure */
-        vlist[j] = new Vertex (vert.x, vert.y, vert.z);
-        vlist[j]->other_props = vert.other_props;
+        vlist[j] = make_vertex (vert.x, vert.y, vert.z);
+        vlist[j]->other_props = NULL;
+        if (other_data != NULL) {
+          vlist[j]->other_props = other_data + (size_t) j * vert_other->size;
+          memcpy (vlist[j]->other_props, vert.other_props, vert_other->size);
+        }
       }
+      delete[] verts_io;
+
+      /* their lists and strings are in the arena, so they need copies too */
+      if (other_data != NULL)
+        copy_other_lists (vert_other, other_data, nverts, vert_other_data);
     }
     else if (equal_strings ("face", elem_name)) {
 
       /* create a list to hold all the face elements */
       ntris = max_tris = elem_count;
       tlist = new Triangle *[ntris];
+      tri_pool.reserve (ntris);
 
       /* set up for getting face elements */
       setup_property_ply (in_ply, &face_props[0]);
       face_other = get_other_properties_ply (in_ply, offsetof(Face_io,other_props));
 
-      /* grab all the face elements */
-      for (j = 0; j < elem_count; j++) {
-        Face_io face;
-        get_element_ply (in_ply, (void *) &face);
+      /* grab all the face elements in one go */
+      Face_io *faces_io = new Face_io[elem_count];
+      get_element_block_ply (in_ply, (void *) faces_io, sizeof (Face_io), elem_count);
+
+      /* the other_props of all the faces go in one block */
+      char *other_data = NULL;
+      if (face_other->size > 0) {
+        other_data = new char[(size_t) face_other->size * elem_count];
+        face_other_data.push_back (other_data);
+      }
+
+      for (j = 0; j < elem_count && !read_failed; j++) {
+        Face_io &face = faces_io[j];
 
         if (face.nverts != 3) {
           fprintf (stderr, "Face has %d vertices (should be three).\n",
                    face.nverts);
-          exit (-1);
+          read_failed = 1;
+          break;
         }
 
         /* copy info from the "face" structure */
-        tlist[j] = new Triangle;
+        tlist[j] = tri_pool.make ();
         tlist[j]->nverts = 3;
         tlist[j]->verts[0] = (Vertex *) face.verts[0];
         tlist[j]->verts[1] = (Vertex *) face.verts[1];
         tlist[j]->verts[2] = (Vertex *) face.verts[2];
-        tlist[j]->other_props = face.other_props;
+        tlist[j]->other_props = NULL;
+        if (other_data != NULL) {
+          tlist[j]->other_props = other_data + (size_t) j * face_other->size;
+          memcpy (tlist[j]->other_props, face.other_props, face_other->size);
+        }
       }
+      delete[] faces_io;
+
+      if (other_data != NULL && !read_failed)
+        copy_other_lists (face_other, other_data, elem_count, face_other_data);
     }
     else
       get_other_element_ply (in_ply);
   }
 
-  /* close the file */
+  /* close the file, and let go of the lists and other_props read from it */
   close_ply (in_ply);
+  free_arena_ply (in_ply);
+
+  /* faces that use vertices the file doesn't have make it unusable */
+  for (i = 0; i < ntris && !read_failed; i++)
+    for (j = 0; j < 3; j++)
+      if ((size_t) tlist[i]->verts[j] >= (size_t) nverts) {
+        fprintf (stderr, "Face uses vertex %d, but there are only %d.\n",
+                 (int) (size_t) tlist[i]->verts[j], nverts);
+        read_failed = 1;
+        break;
+      }
+
+  if (read_failed) {
+    ntris = 0;
+    return;
+  }
 
   /* fix up vertex pointers in triangles */
   for (i = 0; i < ntris; i++) {
@@ -239,7 +475,8 @@ Polyhedron::Polyhedron(FILE *file)
     tlist[i]->verts[2] = vlist[(int) tlist[i]->verts[2]];
   }
 
-  /* get rid of triangles that use the same vertex more than once */
+  /* get rid of triangles that use the same vertex more than once; they
+     stay in the pool until it is cleared */
 
   for (i = ntris-1; i >= 0; i--) {
 
@@ -249,7 +486,6 @@ Polyhedron::Polyhedron(FILE *file)
     Vertex *v2 = tri->verts[2];
 
     if (v0 == v1 || v1 == v2 || v2 == v0) {
-      free (tlist[i]);
       ntris--;
       tlist[i] = tlist[ntris];
     }
@@ -258,20 +494,228 @@ Polyhedron::Polyhedron(FILE *file)
 
 
 /******************************************************************************
-Write out a polyhedron to a file.
+Lay out the other_props of the vertices and faces of a PLY file just as
+Polyhedron(FILE *) does when it reads the file, but from the header alone.
+
+Entry:
+  ply - file whose header has been read
+
+Exit:
+  vert_other - description of the vertices' other_props, or NULL if there
+               are no vertices
+  face_other - likewise for the faces
 ******************************************************************************/
 
-void Polyhedron::write_file(FILE *file)
+void describe_other_props(PlyFile *ply, PlyOtherProp **vert_other,
+                          PlyOtherProp **face_other)
 {
   int i;
+  int elem_count;
+  char *elem_name;
+
+  *vert_other = *face_other = NULL;
+
+  for (i = 0; i < ply->num_elem_types; i++) {
+    elem_name = setup_element_read_ply (ply, i, &elem_count);
+    if (equal_strings ("vertex", elem_name)) {
+      setup_property_ply (ply, &vert_props[0]);
+      setup_property_ply (ply, &vert_props[1]);
+      setup_property_ply (ply, &vert_props[2]);
+      *vert_other = get_other_properties_ply (ply,
+					      offsetof(Vertex_io,other_props));
+    }
+    else if (equal_strings ("face", elem_name)) {
+      setup_property_ply (ply, &face_props[0]);
+      *face_other = get_other_properties_ply (ply, offsetof(Face_io,other_props));
+    }
+  }
+}
+
+
+/******************************************************************************
+Read in a polyhedron whose mesh and topology are taken from its cache (see
+mesh_cache.h) instead of being parsed and rebuilt.  Only the header of the
+PLY file is read, for write_file() to copy and to describe the other_props,
+which come from the cache too.  The result is initialized just as
+initialize() would leave it.
+******************************************************************************/
+
+Polyhedron::Polyhedron(FILE *file, MeshCache *cache)
+{
+  int i,j;
+  MeshCacheHeader *header = cache->header;
+
+  /*** Read in the header of the original PLY object ***/
+  in_ply = read_ply (file);
+  close_ply (in_ply);
+  vert_rules = face_rules = NULL;
+  describe_other_props (in_ply, &vert_other, &face_other);
+
+  /* a cache whose other_props don't fit the header can't supply them */
+  if (vert_other != NULL && vert_other->size != header->vert_other_size) {
+    free_other_properties_ply (vert_other);
+    vert_other = NULL;
+  }
+  if (face_other != NULL && face_other->size != header->face_other_size) {
+    free_other_properties_ply (face_other);
+    face_other = NULL;
+  }
+
+  char *vert_other_block = NULL;
+  char *face_other_block = NULL;
+  if (vert_other != NULL && vert_other->size > 0) {
+    vert_other_block = new char[(size_t) vert_other->size * header->nverts];
+    memcpy (vert_other_block, cache->vert_other,
+            (size_t) vert_other->size * header->nverts);
+    vert_other_data.push_back (vert_other_block);
+  }
+  if (face_other != NULL && face_other->size > 0) {
+    face_other_block = new char[(size_t) face_other->size * header->ntris];
+    memcpy (face_other_block, cache->face_other,
+            (size_t) face_other->size * header->ntris);
+    face_other_data.push_back (face_other_block);
+  }
+
+  nverts = max_verts = header->nverts;
+  ntris = max_tris = header->ntris;
+  nedges = max_edges = header->nedges;
+
+  /* vertices */
+
+  vlist = new Vertex *[nverts];
+  vert_pool.reserve (nverts);
+  for (i = 0; i < nverts; i++) {
+    vlist[i] = make_vertex (cache->x[i], cache->y[i], cache->z[i]);
+    vlist[i]->other_props = NULL;
+    if (vert_other_block != NULL)
+      vlist[i]->other_props = vert_other_block + (size_t) i * vert_other->size;
+  }
+  pack_vertices();
+
+  /* triangles */
+
+  tlist = new Triangle *[ntris];
+  tri_pool.reserve (ntris);
+  for (i = 0; i < ntris; i++) {
+    tlist[i] = tri_pool.make ();
+    tlist[i]->index = i;
+    tlist[i]->nverts = 3;
+    for (j = 0; j < 3; j++)
+      tlist[i]->verts[j] = vlist[cache->tri_verts[3*i+j]];
+    tlist[i]->other_props = NULL;
+    if (face_other_block != NULL)
+      tlist[i]->other_props = face_other_block + (size_t) i * face_other->size;
+  }
+
+  /* edges, and the pointers between edges and triangles */
+
+  elist = new Edge *[nedges];
+  edge_pool.reserve (nedges);
+  for (i = 0; i < nedges; i++) {
+    Edge *e = elist[i] = edge_pool.make ();
+    int first = cache->edge_tri_start[i];
+    e->index = i;
+    e->verts[0] = vlist[cache->edge_verts[2*i]];
+    e->verts[1] = vlist[cache->edge_verts[2*i+1]];
+    e->ntris = cache->edge_tri_start[i+1] - first;
+    e->tris = edge_tri_pool.alloc (e->ntris < 2 ? 2 : e->ntris);
+    for (j = 0; j < e->ntris; j++)
+      e->tris[j] = tlist[cache->edge_tris[first + j]];
+  }
+
+  for (i = 0; i < ntris; i++)
+    for (j = 0; j < 3; j++)
+      tlist[i]->edges[j] = elist[cache->tri_edges[3*i+j]];
+
+  /* ordered pointers from vertices to triangles */
+
+  vert_start.assign (cache->vert_tri_start, cache->vert_tri_start + nverts + 1);
+  vert_tris.resize (3 * (size_t) ntris);
+  vert_corners.resize (3 * (size_t) ntris);
+
+  for (size_t k = 0; k < vert_tris.size (); k++)
+    vert_tris[k] = tlist[cache->vert_tris[k]];
+
+  for (i = 0; i < nverts; i++) {
+    Vertex *v = vlist[i];
+    v->ntris = vert_start[i+1] - vert_start[i];
+    v->tris = vert_tris.data () + vert_start[i];
+    v->ncorners = 0;
+    v->corners = vert_corners.data () + vert_start[i];
+  }
+
+  /* corners, created in the same order as create_corners() makes them */
+
+  std::vector<Corner *> corners (3 * (size_t) ntris);
+  corner_pool.reserve (corners.size ());
+
+  for (i = 0; i < ntris; i++) {
+    Triangle *t = tlist[i];
+    for (j = 0; j < 3; j++) {
+      Corner *c = corners[3*i+j] = corner_pool.make ();
+      c->t = t;
+      c->v = t->verts[j];
+      c->t_index = j;
+      c->e = t->edges[(j+1) % 3];
+      t->verts[j]->corners[t->verts[j]->ncorners++] = c;
+      t->corners[j] = c;
+    }
+    for (j = 0; j < 3; j++) {
+      corners[3*i+j]->n = corners[3*i + (j+1) % 3];
+      corners[3*i+j]->p = corners[3*i + (j+2) % 3];
+    }
+  }
+
+  clist.resize (corners.size ());
+  for (size_t k = 0; k < corners.size (); k++) {
+    int opposite = cache->corner_opposite[k];
+    corners[k]->o = (opposite < 0) ? NULL : corners[opposite];
+    clist[k] = corners[cache->corner_order[k]];
+  }
+
+  calc_edge_length();
+  seed = -1;
+}
+
+
+/******************************************************************************
+Write out a polyhedron to a file, in the same format as the file it was
+read from.
+******************************************************************************/
+
+void Polyhedron::write_file(FILE *file)
+{
+  write_file (file, in_ply != NULL ? in_ply->file_type : PLY_BINARY_LE);
+}
+
+
+/******************************************************************************
+Write out a polyhedron to a file in a given format (PLY_ASCII, PLY_BINARY_BE
+or PLY_BINARY_LE).  Vertices and faces are copied into contiguous batches and
+handed to put_element_block_ply(), so a binary file is written with a few
+large writes rather than one call per item.
+******************************************************************************/
+
+void Polyhedron::write_file(FILE *file, int file_type)
+{
+  int i,j;
   PlyFile *ply;
   char **elist;
   int num_elem_types;
+  const int batch_size = 65536;
 
   /*** Write out the transformed PLY object ***/
 
-  elist = get_element_list_ply (in_ply, &num_elem_types);
-  ply = write_ply (file, num_elem_types, elist, in_ply->file_type);
+  /* a polyhedron that wasn't read from a PLY file has just these */
+  static char *default_elist[] = {"vertex", "face"};
+
+  if (in_ply != NULL)
+    elist = get_element_list_ply (in_ply, &num_elem_types);
+  else {
+    elist = default_elist;
+    num_elem_types = 2;
+  }
+  ply = write_ply (file, num_elem_types, elist, file_type);
 
   /* describe what properties go into the vertex elements */
 
@@ -279,60 +723,80 @@ void Polyhedron::write_file(FILE *file)
   describe_property_ply (ply, &vert_props[0]);
   describe_property_ply (ply, &vert_props[1]);
   describe_property_ply (ply, &vert_props[2]);
-//  describe_other_properties_ply (ply, vert_other, offsetof(Vertex_io,other_props));
+  if (vert_other != NULL && vert_other->nprops > 0)
+    describe_other_properties_ply (ply, vert_other, offsetof(Vertex_io,other_props));
 
   describe_element_ply (ply, "face", ntris);
   describe_property_ply (ply, &face_props[0]);
 
-//  describe_other_properties_ply (ply, face_other,
-//                                offsetof(Face_io,other_props));
+  if (face_other != NULL && face_other->nprops > 0)
+    describe_other_properties_ply (ply, face_other,
+                                   offsetof(Face_io,other_props));
 
 //  describe_other_elements_ply (ply, in_ply->other_elems);
 
-  copy_comments_ply (ply, in_ply);
+  if (in_ply != NULL)
+    copy_comments_ply (ply, in_ply);
 	char mm[1024];
 	sprintf(mm, "modified by learnply");
 //  append_comment_ply (ply, "modified by simvizply %f");
 	  append_comment_ply (ply, mm);
-  copy_obj_info_ply (ply, in_ply);
+  if (in_ply != NULL)
+    copy_obj_info_ply (ply, in_ply);
 
   header_complete_ply (ply);
 
   /* set up and write the vertex elements */
   put_element_setup_ply (ply, "vertex");
-  for (i = 0; i < nverts; i++) {
-    Vertex_io vert;
 
-    /* copy info to the "vert" structure */
-    vert.x = vlist[i]->x;
-    vert.y = vlist[i]->y;
-    vert.z = vlist[i]->z;
-    vert.other_props = vlist[i]->other_props;
+  Vertex_io *verts_io = new Vertex_io[batch_size];
 
-    put_element_ply (ply, (void *) &vert);
+  for (i = 0; i < nverts; i += batch_size) {
+    int n = std::min (batch_size, nverts - i);
+
+    /* copy info to the "vert" structures */
+    for (j = 0; j < n; j++) {
+      Vertex_io &vert = verts_io[j];
+      vert.x = vdata.x[i+j];
+      vert.y = vdata.y[i+j];
+      vert.z = vdata.z[i+j];
+      vert.other_props = vlist[i+j]->other_props;
+    }
+
+    put_element_block_ply (ply, (void *) verts_io, sizeof (Vertex_io), n);
   }
 
-  /* index all the vertices */
-  for (i = 0; i < nverts; i++)
-    vlist[i]->index = i;
+  delete[] verts_io;
 
   /* set up and write the face elements */
   put_element_setup_ply (ply, "face");
 
-  Face_io face;
-  face.verts = new int[3];
-  
-  for (i = 0; i < ntris; i++) {
+  Face_io *faces_io = new Face_io[batch_size];
+  int *face_indices = new int[3 * batch_size];
+
+  for (i = 0; i < batch_size; i++) {
+    faces_io[i].nverts = 3;
+    faces_io[i].verts = &face_indices[3 * i];
+  }
 
-    /* copy info to the "face" structure */
-    face.nverts = 3;
-    face.verts[0] = tlist[i]->verts[0]->index;
-    face.verts[1] = tlist[i]->verts[1]->index;
-    face.verts[2] = tlist[i]->verts[2]->index;
-    face.other_props = tlist[i]->other_props;
+  for (i = 0; i < ntris; i += batch_size) {
+    int n = std::min (batch_size, ntris - i);
 
-    put_element_ply (ply, (void *) &face);
+    /* copy info to the "face" structures */
+    for (j = 0; j < n; j++) {
+      Triangle *tri = tlist[i+j];
+      face_indices[3*j]   = tri->verts[0]->index;
+      face_indices[3*j+1] = tri->verts[1]->index;
+      face_indices[3*j+2] = tri->verts[2]->index;
+      faces_io[j].other_props = tri->other_props;
+    }
+
+    put_element_block_ply (ply, (void *) faces_io, sizeof (Face_io), n);
   }
+
+  delete[] faces_io;
+  delete[] face_indices;
+
   put_other_elements_ply (ply);
 
   close_ply (ply);
@@ -350,27 +814,41 @@ void Polyhedron::initialize(){
 void Polyhedron::finalize(){
 	int i;
 
-	for (i=0; i<ntris; i++){
-		//free(tlist[i]->other_props);
-		free(tlist[i]);
-	}
-	for (i=0; i<nedges; i++) {
-		free(elist[i]->tris);
-		free(elist[i]);
-	}
-	for (i=0; i<nverts; i++) {
-		free(vlist[i]->tris);
-		//free(vlist[i]->other_props);
-		free(vlist[i]);
-	}
+	delete ctable;
+	ctable = NULL;
+	std::vector<Vertex *>().swap(edge_midpoints);
 
-	free(tlist);
-	free(elist);
-	free(vlist);
-	if (!vert_other)
-		free(vert_other);
-	if (!face_other)
-		free(face_other);
+	//the elements go a block at a time with their pools
+	clist.clear();
+	corner_pool.clear();
+	edge_tri_pool.clear();
+	edge_pool.clear();
+	tri_pool.clear();
+	vert_pool.clear();
+	vdata = VertexArrays();
+
+	delete[] tlist;
+	delete[] elist;
+	delete[] vlist;
+	tlist = NULL;
+	elist = NULL;
+	vlist = NULL;
+	ntris = nedges = nverts = 0;
+	free_rule_ply(vert_rules);
+	free_rule_ply(face_rules);
+	vert_rules = face_rules = NULL;
+	free_other_properties_ply(vert_other);
+	free_other_properties_ply(face_other);
+	vert_other = face_other = NULL;
+	for (i = 0; i < vert_other_data.size(); i++)
+		delete[] vert_other_data[i];
+	for (i = 0; i < face_other_data.size(); i++)
+		delete[] face_other_data[i];
+	vert_other_data.clear();
+	face_other_data.clear();
+	if (in_ply != NULL)
+		free_ply(in_ply);
+	in_ply = NULL;
 }
 
 /******************************************************************************
@@ -455,7 +933,8 @@ void Polyhedron::create_edge(Vertex *v1, Vertex *v2)
 
   if (nedges >= max_edges) {
 
-    max_edges += 100;
+    /* only a mesh with a boundary outgrows the list made by create_edges() */
+    max_edges += max_edges / 2 + 100;
     Edge **list = new Edge *[max_edges];
 
     /* copy the old list to the new one */
@@ -463,13 +942,13 @@ void Polyhedron::create_edge(Vertex *v1, Vertex *v2)
       list[i] = elist[i];
 
     /* replace list */
-    free (elist);
+    delete[] elist;
     elist = list;
   }
 
   /* create the edge */
 
-  elist[nedges] = new Edge;
+  elist[nedges] = edge_pool.make ();
   Edge *e = elist[nedges];
   e->index = nedges;
   e->verts[0] = v1;
@@ -495,9 +974,9 @@ void Polyhedron::create_edge(Vertex *v1, Vertex *v2)
 
   /* make room for the face pointers (at least two) */
   if (e->ntris < 2)
-    e->tris = new Triangle *[2];
+    e->tris = edge_tri_pool.alloc (2);
   else
-    e->tris = new Triangle *[e->ntris];
+    e->tris = edge_tri_pool.alloc (e->ntris);
 
   /* create pointers from edges to faces and vice-versa */
 
@@ -564,35 +1043,80 @@ bool compareCorner(Corner* c1,Corner* c2) {
 	return ((c1min < c2min));
 }
 
+/******************************************************************************
+Sort corners into the order std::stable_sort() with compareCorner() gives,
+by the lower and then the higher index of the two vertices across from each
+corner.  The two indices are packed into an edge key per corner, on several
+threads, and the keys are radix sorted by sort_edge_keys(), which is
+stable, so the corners are never compared.
+
+Entry:
+  corners - corners whose vertices have been indexed
+  nverts  - number of vertices
+******************************************************************************/
+
+static void sort_corners(std::vector<Corner*> &corners, int nverts)
+{
+	const size_t min_block = 65536;  // fewest corners worth a thread of their own
+
+	size_t n = corners.size();
+	int nthreads = parallel_thread_count((int)(n / min_block));
+	int index_bits = edge_key_bits(nverts);
+
+	std::vector<unsigned long long> keys(n);
+	std::vector<int> order;
+	std::vector<Corner*> sorted(n);
+
+	parallel_for(nthreads, [&](int t) {
+		size_t first = n * t / nthreads, last = n * (t + 1) / nthreads;
+		for (size_t k = first; k < last; k++)
+			keys[k] = edge_key(corners[k]->n->v->index, corners[k]->p->v->index, index_bits);
+	});
+
+	sort_edge_keys(keys, 2 * index_bits, order);
+
+	for (size_t k = 0; k < n; k++)
+		sorted[k] = corners[order[k]];
+	corners.swap(sorted);
+}
+
 void Polyhedron::clear_corner_vectors() {
 	for (int i = 0; i < nverts; i++) {
-		 vlist[i]->corners.clear();
+		 vlist[i]->ncorners = 0;
 	}
 }
 void Polyhedron::create_corners() {
+	//every vertex gets a corner for each of its triangles, in its slots of
+	//vert_corners (set up by vertex_to_tri_ptrs())
 	clear_corner_vectors();
+	//in place of any corners the polyhedron had
+	clist.clear();
+	corner_pool.clear();
+	corner_pool.reserve(3 * (size_t)ntris);
 	for (int i = 0; i < ntris; i++) {
-		Corner* c0 = new Corner;
-		Corner* c1 = new Corner;
-		Corner* c2 = new Corner;
+		Corner* c0 = corner_pool.make();
+		Corner* c1 = corner_pool.make();
+		Corner* c2 = corner_pool.make();
 		//, c1, c2;
 		Triangle* t = tlist[i];
 		//set all corners triangle pointer
 		c0->t = t;		c1->t = t;		c2->t = t;
+		//no opposite corner until the pairing below finds one
+		c0->o = NULL;		c1->o = NULL;		c2->o = NULL;
 		//set all vertices
 		
 		c0->v = t->verts[0];		c1->v = t->verts[1];		c2->v = t->verts[2];
 
 		//Put all corners onto their vertice holders
 		c0->t_index = 0;
-		t->verts[0]->corners.push_back(c0);
-		t->corners.push_back(c0);
+		t->verts[0]->corners[t->verts[0]->ncorners++] = c0;
+		t->corners[0] = c0;
 		c1->t_index = 1;
-		t->verts[1]->corners.push_back(c1);
-		t->corners.push_back(c1);
+		t->verts[1]->corners[t->verts[1]->ncorners++] = c1;
+		t->corners[1] = c1;
 		c2->t_index = 2;
-		t->verts[2]->corners.push_back(c2);
-		t->corners.push_back(c2);
+		t->verts[2]->corners[t->verts[2]->ncorners++] = c2;
+		t->corners[2] = c2;
 		//Set all edges
 		c0->e = t->edges[1];		c1->e = t->edges[2];		c2->e = t->edges[0];
 		
@@ -612,11 +1136,12 @@ void Polyhedron::create_corners() {
 
 	
 	//all corners now added and inside of clist with all relations except for c->o
-	std::stable_sort(clist.begin(), clist.end(), compareCorner);
+	//(sorted as std::stable_sort(clist.begin(), clist.end(), compareCorner) would)
+	sort_corners(clist, nverts);
 	
 
 	//since it checks ahead don't need to event perform check on last corner
-	for (int i = 0; i < clist.size()-1; i++) {
+	for (int i = 0; i + 1 < (int)clist.size(); i++) {
 		
 		if (clist[i]->e->index == clist[i + 1]->e->index) {
 			clist[i]->o = clist[i + 1];
@@ -627,99 +1152,181 @@ void Polyhedron::create_corners() {
 
 /******************************************************************************
 Create edges.
+
+Every side of every triangle gets the edge key of its two vertices, and the
+keys are radix sorted by sort_edge_keys(), which is stable, so that all the
+copies of an edge come together in the order of the triangles.  Taken in
+that order, the first copy of an edge makes it, pointing the same way as
+that side, and every copy adds its triangle to the edge.  This gives the
+same edges, in the same order, as calling create_edge() on each side that
+has no edge yet, but in time linear in the number of triangles.
 ******************************************************************************/
 
 void Polyhedron::create_edges()
 {
   int i,j;
-  Triangle *f;
-  Vertex *v1,*v2;
-  double count = 0;
+  int nsides = 3 * ntris;
+  int index_bits = edge_key_bits (nverts);
 
-  /* count up how many edges we may require */
+  /* key each side by its two vertices, and sort the keys */
 
-  for (i = 0; i < ntris; i++) {
-    f = tlist[i];
-    for (j = 0; j < f->nverts; j++) {
-      v1 = f->verts[j];
-      v2 = f->verts[(j+1) % f->nverts];
-      Triangle *result = find_common_edge (f, v1, v2);
-      if (result)
-        count += 0.5;
-      else
-        count += 1;
-    }
+  std::vector<unsigned long long> keys (nsides);
+  std::vector<int> order;
+
+  for (i = 0; i < nsides; i++) {
+    Triangle *f = tlist[i / 3];
+    keys[i] = edge_key (f->verts[i % 3]->index, f->verts[(i % 3 + 1) % 3]->index, index_bits);
   }
 
+  sort_edge_keys (keys, 2 * index_bits, order);
 
-  /* create space for edge list */
+  /* point each side at the first side with the same key */
 
-  max_edges = (int) (count + 10);  /* leave some room for expansion */
-  elist = new Edge *[max_edges];
-  nedges = 0;
+  std::vector<int> first_copy (nsides);
 
-  /* zero out all the pointers from faces to edges */
+  for (i = 0; i < nsides; i++) {
+    if (i == 0 || keys[i] != keys[i - 1])
+      j = order[i];
+    first_copy[order[i]] = j;
+  }
 
-  for (i = 0; i < ntris; i++)
-    for (j = 0; j < 3; j++)
-      tlist[i]->edges[j] = NULL;
+  /* number the edges by the first side of each, and count their triangles */
 
-  /* create all the edges by examining all the triangles */
+  std::vector<int> edge_of (nsides);
+  std::vector<int> first_side;
+  std::vector<int> edge_ntris;
+  first_side.reserve ((nsides + 1) / 2);
+  edge_ntris.reserve ((nsides + 1) / 2);
 
-  for (i = 0; i < ntris; i++) {
-    f = tlist[i];
-    for (j = 0; j < 3; j++) {
-      /* skip over edges that we've already created */
-      if (f->edges[j])
-        continue;
-      v1 = f->verts[j];
-      v2 = f->verts[(j+1) % (f->nverts)];
-      create_edge (v1, v2);
+  for (i = 0; i < nsides; i++) {
+    if (first_copy[i] == i) {
+      edge_of[i] = (int) first_side.size ();
+      first_side.push_back (i);
+      edge_ntris.push_back (1);
+    }
+    else {
+      edge_of[i] = edge_of[first_copy[i]];
+      edge_ntris[edge_of[i]]++;
     }
   }
+
+  /* make the edges, with room for their triangles (at least two), in
+     place of any the polyhedron had */
+
+  delete[] elist;
+  edge_pool.clear ();
+  edge_tri_pool.clear ();
+
+  nedges = max_edges = (int) first_side.size ();
+  elist = new Edge *[max_edges];
+
+  size_t ntri_ptrs = 0;
+  for (i = 0; i < nedges; i++)
+    ntri_ptrs += (edge_ntris[i] < 2) ? 2 : edge_ntris[i];
+  edge_pool.reserve (nedges);
+  edge_tri_pool.reserve (ntri_ptrs);
+
+  for (i = 0; i < nedges; i++) {
+    Triangle *f = tlist[first_side[i] / 3];
+    j = first_side[i] % 3;
+    Edge *e = edge_pool.make ();
+    e->index = i;
+    e->verts[0] = f->verts[j];
+    e->verts[1] = f->verts[(j+1) % 3];
+    e->ntris = 0;
+    e->tris = edge_tri_pool.alloc (edge_ntris[i] < 2 ? 2 : edge_ntris[i]);
+    elist[i] = e;
+  }
+
+  /* create pointers from edges to faces and vice-versa */
+
+  for (i = 0; i < nsides; i++) {
+    Triangle *f = tlist[i / 3];
+    Edge *e = elist[edge_of[i]];
+    e->tris[e->ntris++] = f;
+    f->edges[i % 3] = e;
+  }
 }
 
 
 /******************************************************************************
 Create pointers from vertices to faces.
+
+The triangles around every vertex are kept one vertex after another in
+vert_tris, in compressed sparse row form, and each vertex points at its
+own run.  The triangles are split into pieces, one per thread; each thread
+counts how many times every vertex appears in its piece, a prefix sum over
+the vertices and then the threads gives where each thread writes each
+vertex's triangles, and the threads fill them in.  A vertex's triangles
+come out in the order of the triangle list, as if they were appended one
+at a time.  vert_corners is laid out the same way for create_corners().
 ******************************************************************************/
 
 void Polyhedron::vertex_to_tri_ptrs()
 {
-  int i,j;
-  Triangle *f;
-  Vertex *v;
-
-  /* zero the count of number of pointers to faces */
+  int i;
+  const int min_block = 65536;  /* fewest triangles worth a thread of their own */
+  int nthreads = parallel_thread_count (ntris / min_block);
 
-  for (i = 0; i < nverts; i++)
-    vlist[i]->max_tris = 0;
+  /* count the triangles of each vertex, all threads adding to the same
+     counts */
 
-  /* first just count all the face pointers needed for each vertex */
+  std::vector<std::atomic<int> > counts (nverts);
 
-  for (i = 0; i < ntris; i++) {
-    f = tlist[i];
-    for (j = 0; j < f->nverts; j++)
-      f->verts[j]->max_tris++;
-  }
+  parallel_for (nthreads, [&](int t) {
+    int first = (int) ((size_t) ntris * t / nthreads);
+    int last = (int) ((size_t) ntris * (t + 1) / nthreads);
+    for (int k = first; k < last; k++)
+      for (int j = 0; j < tlist[k]->nverts; j++)
+        counts[tlist[k]->verts[j]->index].fetch_add (1, std::memory_order_relaxed);
+  });
 
-  /* allocate memory for face pointers of vertices */
+  /* each vertex's triangles start after those of the vertices before it;
+     the counts become where the next triangle of each vertex goes */
 
+  vert_start.resize (nverts + 1);
+  int total = 0;
   for (i = 0; i < nverts; i++) {
-    vlist[i]->tris = (Triangle **)
-		      malloc (sizeof (Triangle *) * vlist[i]->max_tris);
-    vlist[i]->ntris = 0;
+    vert_start[i] = total;
+    total += counts[i].load (std::memory_order_relaxed);
+    counts[i].store (vert_start[i], std::memory_order_relaxed);
   }
+  vert_start[nverts] = total;
+
+  vert_tris.resize (total);
+  vert_corners.assign (total, NULL);
 
   /* now actually create the face pointers */
 
-  for (i = 0; i < ntris; i++) {
-    f = tlist[i];
-    for (j = 0; j < f->nverts; j++) {
-      v = f->verts[j];
-      v->tris[v->ntris] = f;
-      v->ntris++;
-    }
+  parallel_for (nthreads, [&](int t) {
+    int first = (int) ((size_t) ntris * t / nthreads);
+    int last = (int) ((size_t) ntris * (t + 1) / nthreads);
+    for (int k = first; k < last; k++)
+      for (int j = 0; j < tlist[k]->nverts; j++) {
+        int v = tlist[k]->verts[j]->index;
+        vert_tris[counts[v].fetch_add (1, std::memory_order_relaxed)] = tlist[k];
+      }
+  });
+
+  /* the threads placed the triangles of a vertex in no particular order,
+     so put each run back in the order of the triangle list */
+
+  if (nthreads > 1)
+    parallel_for (nthreads, [&](int t) {
+      int first = (int) ((size_t) nverts * t / nthreads);
+      int last = (int) ((size_t) nverts * (t + 1) / nthreads);
+      for (int k = first; k < last; k++)
+        std::sort (vert_tris.begin () + vert_start[k],
+                   vert_tris.begin () + vert_start[k+1],
+                   [](Triangle *a, Triangle *b) { return (a->index < b->index); });
+    });
+
+  for (i = 0; i < nverts; i++) {
+    Vertex *v = vlist[i];
+    v->ntris = vert_start[i+1] - vert_start[i];
+    v->tris = vert_tris.data () + vert_start[i];
+    v->ncorners = 0;
+    v->corners = vert_corners.data () + vert_start[i];
   }
 }
 
@@ -743,107 +1350,111 @@ Triangle *Polyhedron::other_triangle(Edge *edge, Triangle *tri)
 
 
 /******************************************************************************
-Order the pointers to faces that are around a given vertex.
+Put the faces of a vertex in the order of the fan that starts at a given
+corner of it, walking forwards (counterclockwise) by swinging.
 
 Entry:
-  v - vertex whose face list is to be ordered
+  v     - vertex whose face list is to be ordered
+  first - corner of v to start from
+
+Exit:
+  returns 2 if the walk reached all of v's faces and came back to the
+  start, 1 if it reached them all and ended at a boundary, and 0 (with the
+  face list overwritten) if it missed some
 ******************************************************************************/
 
-void Polyhedron::order_vertex_to_tri_ptrs(Vertex *v)
+static int place_fan(Vertex *v, Corner *first)
 {
-  int i,j;
-  Triangle *f;
-  Triangle *fnext;
-  int nf;
-  int vindex;
-  int boundary;
-  int count;
+  int count = 0;
+  Corner *c = first;
 
-  nf = v->ntris;
-  f = v->tris[0];
+  do {
+    v->tris[count++] = c->t;
+    c = OneRing::swing (c);
+  } while (c != NULL && c != first && count < v->ntris);
 
-  /* go backwards (clockwise) around faces that surround a vertex */
-  /* to find out if we reach a boundary */
-
-  boundary = 0;
+  if (count < v->ntris || (c != NULL && c != first))
+    return (0);
+  return ((c == first) ? 2 : 1);
+}
 
-  for (i = 1; i <= nf; i++) {
 
-    /* find reference to v in f */
-    vindex = -1;
-    for (j = 0; j < f->nverts; j++)
-      if (f->verts[j] == v) {
-	vindex = j;
-	break;
-      }
+/******************************************************************************
+Order the pointers to faces that are around a given vertex.
 
-    /* error check */
-    if (vindex == -1) {
-      fprintf (stderr, "can't find vertex #1\n");
-      exit (-1);
-    }
+The corners of the vertex must already exist, and each step around it is a
+swing between corners, so ordering takes time in proportion to the
+valence.  The faces are first walked forwards from the first one, which is
+all that is needed if that comes back around; otherwise the walk goes
+backwards (clockwise) to a boundary and the faces are placed forwards from
+there.  If that misses some of the faces, because the vertex joins several
+fans, the faces that are reached are swapped into place one by one instead
+and the rest are left after them.
 
-    /* corresponding face is the previous one around v */
-    fnext = other_triangle (f->edges[vindex], f);
+Entry:
+  v - vertex whose face list is to be ordered
+******************************************************************************/
 
-    /* see if we've reached a boundary, and if so then place the */
-    /* current face in the first position of the vertice's face list */
+void Polyhedron::order_vertex_to_tri_ptrs(Vertex *v)
+{
+  int i,j;
+  int nf = v->ntris;
+  Corner *first;
+  Corner *c;
 
-    if (fnext == NULL) {
-      /* find reference to f in v */
-      for (j = 0; j < v->ntris; j++)
-        if (v->tris[j] == f) {
-	  v->tris[j] = v->tris[0];
-	  v->tris[0] = f;
-	  break;
-	}
-      boundary = 1;
-      break;
-    }
+  if (nf == 0)
+    return;
 
-    f = fnext;
+  first = OneRing::corner_in (v->tris[0], v);
+  if (first == NULL) {
+    fprintf (stderr, "can't find vertex #1\n");
+    exit (-1);
   }
 
-  /* now walk around the faces in the forward direction and place */
-  /* them in order */
-
-  f = v->tris[0];
-  count = 0;
+  /* an interior vertex's faces close up around it, and a boundary vertex
+     may already start at the boundary */
 
-  for (i = 1; i < nf; i++) {
+  int placed = place_fan (v, first);
+  if (placed == 2 || (placed == 1 && OneRing::unswing (first) == NULL))
+    return;
 
-    /* find reference to vertex in f */
-    vindex = -1;
-    for (j = 0; j < f->nverts; j++)
-      if (f->verts[(j+1) % f->nverts] == v) {
-	vindex = j;
-	break;
-      }
+  /* go backwards (clockwise) around the faces to find out if we reach a
+     boundary, and if so then start from the face there */
 
-    /* error check */
-    if (vindex == -1) {
-      fprintf (stderr, "can't find vertex #2\n");
-      exit (-1);
+  c = first;
+  for (i = 1; i <= nf; i++) {
+    Corner *prev = OneRing::unswing (c);
+    if (prev == NULL) {
+      first = c;
+      break;
     }
+    c = prev;
+  }
+
+  if (place_fan (v, first))
+    return;
 
-    /* corresponding face is next one around v */
-    fnext = other_triangle (f->edges[vindex], f);
+  /* the vertex's corners are still in the order its faces were in */
+  for (j = 0; j < nf; j++)
+    v->tris[j] = v->corners[j]->t;
 
-    /* break out of loop if we've reached a boundary */
-    count = i;
-    if (fnext == NULL) {
+  for (j = 0; j < nf; j++)
+    if (v->tris[j] == first->t) {
+      v->tris[j] = v->tris[0];
+      v->tris[0] = first->t;
       break;
     }
 
+  OneRing r(first);
+  for (r.next(), i = 1; !r.done() && i < nf; r.next(), i++) {
+
     /* swap the next face into its proper place in the face list */
-    for (j = 0; j < v->ntris; j++)
-      if (v->tris[j] == fnext) {
-	v->tris[j] = v->tris[i];
-	v->tris[i] = fnext;
-	break;
+    for (j = 0; j < nf; j++)
+      if (v->tris[j] == r.tri()) {
+        v->tris[j] = v->tris[i];
+        v->tris[i] = r.tri();
+        break;
       }
-
-    f = fnext;
   }
 }
 
@@ -881,10 +1492,13 @@ void Polyhedron::create_pointers()
 {
   int i;
 
+  /* the corner table describes the old topology */
+  delete ctable;
+  ctable = NULL;
+
   /* index the vertices and triangles */
 
-  for (i = 0; i < nverts; i++)
-    vlist[i]->index = i;
+  pack_vertices();
 
   for (i = 0; i < ntris; i++) 
     tlist[i]->index = i;
@@ -895,57 +1509,134 @@ void Polyhedron::create_pointers()
   /* make edges */
   create_edges();
 
-
-  /* order the pointers from vertices to faces */
-	for (i = 0; i < nverts; i++){
-//		if (i %1000 == 0)
-//			fprintf(stderr, "ordering %d of %d vertices\n", i, nverts);
-    order_vertex_to_tri_ptrs(vlist[i]);
-		
-	}
   /* index the edges */
 
-  for (i = 0; i < nedges; i++){
-//		if (i %1000 == 0)
-//			fprintf(stderr, "indexing %d of %d edges\n", i, nedges);
+  for (i = 0; i < nedges; i++)
     elist[i]->index = i;
-	}
 
   /*make corners*/
   //First allocate all needed space
   clist.reserve((ntris * 3));
   printf("max corner size: %d\n", clist.max_size());
   create_corners();
+
+  /* order the pointers from vertices to faces by walking around them with
+     the corners; each vertex only reorders its own run of vert_tris, so the
+     vertices are split among threads */
+  int nthreads = parallel_thread_count (nverts / 16384);
+  parallel_for (nthreads, [&](int t) {
+    int first = (int) ((size_t) nverts * t / nthreads);
+    int last = (int) ((size_t) nverts * (t + 1) / nthreads);
+    for (int k = first; k < last; k++)
+      order_vertex_to_tri_ptrs(vlist[k]);
+  });
+
   printf("%d faces\n", ntris);
   printf("%d corners found\n", clist.size());
 
 }
 
+/******************************************************************************
+Return the corner table of the polyhedron, making it the first time it is
+asked for after the topology is built.
+******************************************************************************/
+
+CornerTable *Polyhedron::corner_table()
+{
+  if (ctable == NULL)
+    ctable = new CornerTable (this);
+  return (ctable);
+}
+
+/******************************************************************************
+Make a vertex, with its position in a new slot at the end of the vertex
+arrays.
+
+Entry:
+  x,y,z - position of the vertex
+
+Exit:
+  returns the vertex, indexed by its slot, for the caller to put at the
+  same place in the vertex list or to reorder with reorder_vertices()
+******************************************************************************/
+
+Vertex *Polyhedron::make_vertex(double x, double y, double z)
+{
+  vdata.x.push_back (x);
+  vdata.y.push_back (y);
+  vdata.z.push_back (z);
+  return (vert_pool.make (&vdata, vdata.size () - 1));
+}
+
+
+/******************************************************************************
+Put the positions of a list of vertices in the vertex arrays in the order of
+the list, and index the vertices by their places in it.  The slots of any
+vertices that aren't on the list are dropped.
+
+Entry:
+  list  - the vertices, each indexed by its slot
+  count - number of vertices on the list
+******************************************************************************/
+
+void Polyhedron::reorder_vertices(Vertex **list, int count)
+{
+  int i;
+  std::vector<double> x (count), y (count), z (count);
+
+  for (i = 0; i < count; i++) {
+    int k = list[i]->index;
+    x[i] = vdata.x[k];
+    y[i] = vdata.y[k];
+    z[i] = vdata.z[k];
+  }
+  for (i = 0; i < count; i++)
+    list[i]->index = i;
+
+  vdata.x.swap (x);
+  vdata.y.swap (y);
+  vdata.z.swap (z);
+}
+
+
+/******************************************************************************
+Put the positions in the vertex arrays in the order of the vertex list,
+indexing the vertices to match, and give each vertex a zero normal and the
+default color.
+******************************************************************************/
+
+void Polyhedron::pack_vertices()
+{
+  reorder_vertices (vlist, nverts);
+
+  vdata.nx.assign (nverts, 0.0);
+  vdata.ny.assign (nverts, 0.0);
+  vdata.nz.assign (nverts, 0.0);
+  vdata.r.assign (nverts, DEFAULT_VERTEX_COLOR);
+  vdata.g.assign (nverts, DEFAULT_VERTEX_COLOR);
+  vdata.b.assign (nverts, DEFAULT_VERTEX_COLOR);
+}
+
 void Polyhedron::calc_bounding_sphere()
 {
-  unsigned int i;
+  int i, k;
   icVector3 min, max;
-
-  for (i=0; i<nverts; i++) {
-    if (i==0)  {
-			min.set(vlist[i]->x, vlist[i]->y, vlist[i]->z);
-			max.set(vlist[i]->x, vlist[i]->y, vlist[i]->z);
+  const double *coord[3] = {vdata.x.data(), vdata.y.data(), vdata.z.data()};
+
+  /* one coordinate at a time, straight through its array */
+  for (k=0; k<3; k++) {
+    const double *c = coord[k];
+    double lo = (nverts > 0) ? c[0] : 0.0;
+    double hi = lo;
+    for (i=1; i<nverts; i++) {
+      lo = (c[i] < lo) ? c[i] : lo;
+      hi = (c[i] > hi) ? c[i] : hi;
     }
-    else {
-			if (vlist[i]->x < min.entry[0])
-			  min.entry[0] = vlist[i]->x;
-			if (vlist[i]->x > max.entry[0])
-			  max.entry[0] = vlist[i]->x;
-			if (vlist[i]->y < min.entry[1])
-			  min.entry[1] = vlist[i]->y;
-			if (vlist[i]->y > max.entry[1])
-			  max.entry[1] = vlist[i]->y;
-			if (vlist[i]->z < min.entry[2])
-			  min.entry[2] = vlist[i]->z;
-			if (vlist[i]->z > max.entry[2])
-			  max.entry[2] = vlist[i]->z;
-		}
+    min.entry[k] = lo;
+    max.entry[k] = hi;
   }
+  bbox_min = min;
+  bbox_max = max;
   center = (min + max) * 0.5;
   radius = length(center - min);
 }
@@ -953,12 +1644,11 @@ void Polyhedron::calc_bounding_sphere()
 void Polyhedron::calc_edge_length()
 {
 	int i;
-	icVector3 v1, v2;
 
 	for (i=0; i<nedges; i++) {
-		v1.set(elist[i]->verts[0]->x, elist[i]->verts[0]->y, elist[i]->verts[0]->z);
-		v2.set(elist[i]->verts[1]->x, elist[i]->verts[1]->y, elist[i]->verts[1]->z);
-		elist[i]->length = length(v1-v2);
+		int a = elist[i]->verts[0]->index;
+		int b = elist[i]->verts[1]->index;
+		elist[i]->length = length(vdata.pos(a) - vdata.pos(b));
 	}
 }
 
@@ -978,9 +1668,9 @@ void Polyhedron::calc_face_normals_and_area()
 
 		area += tlist[i]->area;
 		temp_t = tlist[i];
-		v1.set(vlist[tlist[i]->verts[0]->index]->x, vlist[tlist[i]->verts[0]->index]->y, vlist[tlist[i]->verts[0]->index]->z);
-		v2.set(vlist[tlist[i]->verts[1]->index]->x, vlist[tlist[i]->verts[1]->index]->y, vlist[tlist[i]->verts[1]->index]->z);
-		v0.set(vlist[tlist[i]->verts[2]->index]->x, vlist[tlist[i]->verts[2]->index]->y, vlist[tlist[i]->verts[2]->index]->z);
+		v1 = vdata.pos(temp_t->verts[0]->index);
+		v2 = vdata.pos(temp_t->verts[1]->index);
+		v0 = vdata.pos(temp_t->verts[2]->index);
 		tlist[i]->normal = cross(v0-v1, v2-v1);
 		normalize(tlist[i]->normal);
 	}
@@ -988,7 +1678,7 @@ void Polyhedron::calc_face_normals_and_area()
 	double signedvolume = 0.0;
 	icVector3 test = center;
 	for (i=0; i<ntris; i++){
-		icVector3 cent(vlist[tlist[i]->verts[0]->index]->x, vlist[tlist[i]->verts[0]->index]->y, vlist[tlist[i]->verts[0]->index]->z);
+		icVector3 cent = vdata.pos(tlist[i]->verts[0]->index);
 		signedvolume += dot(test-cent, tlist[i]->normal)*tlist[i]->area;
 	}
 	signedvolume /= area;
@@ -1084,7 +1774,7 @@ void init(void) {
 	// may need it
   glPixelStorei(GL_PACK_ALIGNMENT,1);
 	glEnable(GL_NORMALIZE);
-	if (orientation == 0) 
+	if (poly->orientation == 0) 
 		glFrontFace(GL_CW);
 	else 
 		glFrontFace(GL_CCW);
@@ -1093,43 +1783,37 @@ void init(void) {
 * My functions
 ****************************************************************/
 void resetVertexColors() {
-	for (int i = 0; i < poly->nverts; i++) {
-		poly->vlist[i]->r = .6;
-		poly->vlist[i]->g = .6;
-		poly->vlist[i]->b = .6;
-	}
+	VertexArrays& vdata = poly->vdata;
+	std::fill(vdata.r.begin(), vdata.r.end(), DEFAULT_VERTEX_COLOR);
+	std::fill(vdata.g.begin(), vdata.g.end(), DEFAULT_VERTEX_COLOR);
+	std::fill(vdata.b.begin(), vdata.b.end(), DEFAULT_VERTEX_COLOR);
 }
 void findValenceDeficit(){
 	resetVertexColors();
 	int totalDeficit = 0;
 	int totalVertsInDeficit = 0;
+	//each vertex's corners are a run of vert_corners, as long as the gap to the next vertex's
+	std::vector<int> valence(poly->nverts);
+	for (int i = 0; i < poly->nverts; i++)
+		valence[i] = poly->vert_start[i + 1] - poly->vert_start[i];
+	VertexArrays& vdata = poly->vdata;
 	for (int i = 0; i < poly->nverts; i++) {
-		Vertex* v = poly->vlist[i];
-		if (v->corners.size() < 6) {
-			int deficit = 6 - v->corners.size();
-			/*v->r += (.2 * deficit);
-			v->g -= (.2 * deficit);
-			v->b -= (.2 * deficit);*/
-			if (deficit == 1){
-				v->r = 1;
-				v->g = .7;
-				v->b = 0;
-			}
-			else if (deficit == 2) {
-				v->r = 1;
-				v->g = .3;
-				v->b = 0;
-			}
-			else {
-				v->r = 1;
-				v->g = .0;
-				v->b = 0;
-			}
+		if (valence[i] < 6) {
+			int deficit = 6 - valence[i];
+			/*vdata.r[i] += (.2 * deficit);
+			vdata.g[i] -= (.2 * deficit);
+			vdata.b[i] -= (.2 * deficit);*/
+			if (deficit == 1)
+				vdata.set_color(i, 1, .7, 0);
+			else if (deficit == 2)
+				vdata.set_color(i, 1, .3, 0);
+			else
+				vdata.set_color(i, 1, .0, 0);
 			
 			totalVertsInDeficit++;
-			//printf("vert %d has %d deficit\n", i,(6 - v->corners.size()));
+			//printf("vert %d has %d deficit\n", i,(6 - valence[i]));
 		}
-		totalDeficit = totalDeficit + (6 - v->corners.size());
+		totalDeficit = totalDeficit + (6 - valence[i]);
 	}
 	printf("Total Deficit: %d\n", totalDeficit);
 	printf("Total Verts in Deficit: %d\n", totalVertsInDeficit);
@@ -1144,41 +1828,41 @@ void findValenceDeficit(){
 void findAngleDeficit() {
 	resetVertexColors();
 	
-	//find all angles for all corners
-	for (int i = 0; i < poly->clist.size(); i++) {
-		Corner* c = poly->clist[i];
-		c->findAngle();
-		//printf("found angle %lf\n", c->theta);
-	}
+	//find all angles for all corners, from the corner table
+	CornerTable* table = poly->corner_table();
+	VertexArrays& vdata = poly->vdata;
+	int ncorners = table->ncorners();
+	std::vector<double> theta(ncorners);
+	int nthreads = parallel_thread_count(ncorners / 65536);
+	parallel_for(nthreads, [&](int t) {
+		int first = (int)((size_t)ncorners * t / nthreads);
+		int last = (int)((size_t)ncorners * (t + 1) / nthreads);
+		for (int c = first; c < last; c++) {
+			icVector3 v = vdata.pos(table->vert(c));
+			icVector3 n = vdata.pos(table->vert(CornerTable::next(c)));
+			icVector3 p = vdata.pos(table->vert(CornerTable::prev(c)));
+			//same as Corner::findAngle()
+			icVector3 v1 = n - v;
+			icVector3 v2 = p - v;
+			theta[c] = acos(dot(v1, v2) / (length(v1) * length(v2)));
+		}
+	});
+	//add up all corners thetas and subtract total from 2pi
+	std::vector<double> deficits(poly->nverts, 2.0f*PI);
+	for (int c = 0; c < ncorners; c++)
+		deficits[table->vert(c)] -= theta[c];
+
 	double totalDeficit = 0.0;
 	//find each vertex angle deficit
 	for (int i = 0; i < poly->nverts; i++) {
-		Vertex* v = poly->vlist[i];
-
-		double thisVertDeficit = 2.0f*PI;
-		//add up all corners thetas and subtract total from 2pi
-		for (int j = 0; j < v->corners.size(); j++) {
-			Corner* c = v->corners[j];
-			thisVertDeficit = thisVertDeficit - c->theta;
-			
-			
-		}
+		double thisVertDeficit = deficits[i];
 		//printf("this deficit: %lf\n", thisVertDeficit);
-		if (thisVertDeficit >= PI/8.0f && thisVertDeficit < PI/4.0f) {
-			v->r = 1;
-			v->g = .7;
-			v->b = 0;
-		}
-		else if (thisVertDeficit >= PI / 4.0f && thisVertDeficit < PI/2.0f) {
-			v->r = 1;
-			v->g = .3;
-			v->b = 0;
-		}
-		else if (thisVertDeficit > PI/2.0f ) {
-			v->r = 1;
-			v->g = 0.0;
-			v->b = 0;
-		}
+		if (thisVertDeficit >= PI/8.0f && thisVertDeficit < PI/4.0f)
+			vdata.set_color(i, 1, .7, 0);
+		else if (thisVertDeficit >= PI / 4.0f && thisVertDeficit < PI/2.0f)
+			vdata.set_color(i, 1, .3, 0);
+		else if (thisVertDeficit > PI/2.0f )
+			vdata.set_color(i, 1, 0.0, 0);
 		
 		totalDeficit = totalDeficit + thisVertDeficit;
 		
@@ -1186,6 +1870,423 @@ void findAngleDeficit() {
 	printf("Total angle deficit: %lf\n", totalDeficit);
 }
 
+/******************************************************************************
+Create the other_props of new vertices or triangles, each combined from the
+other_props of the same number of existing ones by the element's propagation
+rules (averaging, unless they are changed with modify_rule_ply()), with all
+sources weighted alike.  The whole run is combined at once by
+get_new_props_block_ply().
+
+Entry:
+  elem_name - "vertex" or "face"
+  nsources  - number of sources of each new element
+  sources   - other_props of the sources, nsources in a row for each new one
+
+Exit:
+  returns a block holding the other_props of the new elements one after
+  another, which the polyhedron keeps until finalize(), or NULL if the
+  elements have no other_props
+******************************************************************************/
+
+char *Polyhedron::combine_other_props(char *elem_name, int nsources,
+                                      std::vector<void *> &sources)
+{
+  int i;
+  int vertex = equal_strings ("vertex", elem_name);
+  PlyOtherProp *other = vertex ? vert_other : face_other;
+  PlyPropRules *&rules = vertex ? vert_rules : face_rules;
+  int count = (int) (sources.size () / nsources);
+
+  if (in_ply == NULL || other == NULL || other->size == 0 || count == 0)
+    return (NULL);
+
+  if (rules == NULL)
+    rules = init_rule_ply (in_ply, elem_name);
+
+  start_props_ply (in_ply, rules);
+  for (i = 0; i < nsources; i++)
+    weight_props_ply (in_ply, 1.0f / nsources, NULL);
+
+  char *block = new char[(size_t) other->size * count];
+  memset (block, 0, (size_t) other->size * count);
+  get_new_props_block_ply (in_ply, &sources[0], count, block);
+
+  /* lists and strings are still the sources', which may go before these */
+  std::vector<char *> &blocks = vertex ? vert_other_data : face_other_data;
+  blocks.push_back (block);
+  copy_other_lists (other, block, count, blocks);
+
+  return (block);
+}
+
+
+/* subdivideRegular() makes four children of each triangle, in the order
+   left, middle, top, right; the left, top and right ones are at verts[0],
+   verts[1] and verts[2], and each keeps that vertex in the same slot */
+static const int corner_child[3] = {0, 2, 3};
+#define MIDDLE_CHILD  1
+
+/* the children with the midpoint of side k, in order, and its slot in each */
+static const int mid_child[3][3] = {{0, 1, 2}, {1, 2, 3}, {0, 1, 3}};
+static const int mid_slot[3][3] = {{1, 0, 0}, {1, 2, 1}, {2, 2, 0}};
+
+/* the halves of the sides of a triangle are numbered 2*k+end, for the half
+   of side k at verts[(k+end)%3] */
+#define HALF_SIDE(h)  ((h) / 2)
+#define HALF_END(h)   ((h) % 2)
+
+/* the sides of the children (child, side) that can be the first of an
+   edge, in the order create_edges() comes to them; three are inside the
+   parent, with the other child on each given, and six are halves of the
+   parent's sides, each first only in the lowest triangle on that side */
+static const int new_side[9][2] = {
+  {0,0}, {0,1}, {0,2}, {1,0}, {1,1}, {2,0}, {2,1}, {3,1}, {3,2}
+};
+static const int new_side_half[9] = {0, -1, 5, -1, -1, 1, 2, 3, 4};
+static const int new_side_other[9] = {-1, 1, -1, 2, 3, -1, -1, -1, -1};
+
+/* which of new_side[] each half is */
+static const int half_new_side[6] = {0, 5, 6, 7, 8, 2};
+
+/* which edge each side of each child is: one of new_side[] inside the
+   parent, or -1-h for half h of a side */
+static const int child_side[4][3] = {
+  {-1, 1, -6}, {3, 4, 1}, {-2, -3, 3}, {4, -4, -5}
+};
+
+/* the corner across the edge inside the parent from each corner of each
+   child, as 3*child+slot, or -1 if the corner faces a half of a side */
+static const int inner_opposite[4][3] = {
+  {4, -1, -1}, {11, 0, 7}, {-1, 5, -1}, {-1, -1, 3}
+};
+
+
+static int side_of(Triangle *t, Edge *e)
+{
+  for (int k = 0; k < 3; k++)
+    if (t->edges[k] == e)
+      return (k);
+  return (-1);
+}
+
+
+static int slot_of(Triangle *t, Vertex *v)
+{
+  for (int k = 0; k < 3; k++)
+    if (t->verts[k] == v)
+      return (k);
+  return (-1);
+}
+
+
+/* is the side of a triangle's children given by new_side[which] the first
+   of its edge? */
+static int makes_edge(Triangle *t, int which)
+{
+  int h = new_side_half[which];
+  return (h < 0 || t->edges[HALF_SIDE (h)]->tris[0] == t);
+}
+
+
+/* the number of the half of an old edge at one of its ends, in a triangle
+   on the edge */
+static int half_in(Triangle *t, Edge *old, Vertex *end)
+{
+  int k = side_of (t, old);
+  return (2 * k + (t->verts[k] == end ? 0 : 1));
+}
+
+
+/* how many of a triangle's first sides come before new_side[which] */
+static int edge_rank(Triangle *t, int which)
+{
+  int rank = 0;
+  for (int i = 0; i < which; i++)
+    rank += makes_edge (t, i);
+  return (rank);
+}
+
+
+/******************************************************************************
+Find out if the pointers of a polyhedron can be carried through a regular
+subdivision by subdivide_pointers(): every triangle has three different
+vertices and every edge is on one triangle, or on two that go along it in
+opposite directions and that it lists in order.
+******************************************************************************/
+
+int Polyhedron::splits_cleanly()
+{
+  int i;
+
+  for (i = 0; i < ntris; i++) {
+    Triangle *t = tlist[i];
+    if (t->verts[0] == t->verts[1] || t->verts[1] == t->verts[2] ||
+        t->verts[2] == t->verts[0])
+      return (0);
+  }
+
+  for (i = 0; i < nedges; i++) {
+    Edge *e = elist[i];
+    if (e->ntris == 1)
+      continue;
+    if (e->ntris != 2 || e->tris[0]->index >= e->tris[1]->index)
+      return (0);
+    Triangle *t = e->tris[0];
+    Triangle *s = e->tris[1];
+    if ((t->verts[side_of (t, e)] == e->verts[0]) ==
+        (s->verts[side_of (s, e)] == e->verts[0]))
+      return (0);
+  }
+
+  return (1);
+}
+
+
+/******************************************************************************
+Make the edges, corners and vertex lists of a polyhedron that has just been
+split by subdivideRegular() straight from those of the polyhedron before,
+in place of create_pointers().
+
+Every element of the new mesh stands in a fixed relation to one of the old,
+so each is made in constant time and the triangles can be split among
+threads.  A triangle makes the three edges inside it and the halves of each
+of its sides that it is the lowest triangle of, with their triangles the
+children at the ends of the old edge; the corners facing a half are opposite
+those facing it from the other side of the old edge.  A midpoint's fan goes
+around the three children on either side of its edge, and an old vertex's
+fan is its old one with each triangle traded for the child at the vertex.
+The edges are numbered, pointed and listed as create_edges() would make
+them, and the fans ordered as order_vertex_to_tri_ptrs() would leave them;
+only clist differs, which holds the corners in the order of the triangles
+rather than sorted by edge.
+
+Entry:
+  kids     - the 4*ntris new triangles in a row, four for each old one, with
+             their vertices filled in
+  n_vlist  - the midpoints in the order they were made, then the old vertices
+  n_nverts - number of vertices in n_vlist
+
+Exit:
+  the new vertices (with their positions put in the same order) and
+  triangles are indexed, and the edges, corners and
+  vertex lists are those of the new mesh; vlist, tlist, nverts and ntris are
+  left for the caller to change over
+******************************************************************************/
+
+void Polyhedron::subdivide_pointers(Triangle *kids, Vertex **n_vlist, int n_nverts)
+{
+  int i;
+  const int min_block = 16384;  /* fewest triangles worth a thread of their own */
+  int nthreads = parallel_thread_count (ntris / min_block);
+  int nmids = n_nverts - nverts;
+
+  /* the corner table describes the old topology */
+  delete ctable;
+  ctable = NULL;
+
+  reorder_vertices (n_vlist, n_nverts);
+
+  /* number the edges that each triangle makes after those of the triangles
+     before it */
+
+  std::vector<int> edge_first (ntris + 1);
+  int n_nedges = 0;
+  for (i = 0; i < ntris; i++) {
+    edge_first[i] = n_nedges;
+    n_nedges += edge_rank (tlist[i], 9);
+  }
+  edge_first[ntris] = n_nedges;
+
+  Pool<Edge> n_edge_pool;
+  Pool<Triangle *> n_edge_tri_pool;
+  Pool<Corner> n_corner_pool;
+  Edge *edges = n_edge_pool.alloc (n_nedges);
+  Triangle **edge_tris = n_edge_tri_pool.alloc (2 * (size_t) n_nedges);
+  Corner *corners = n_corner_pool.alloc (12 * (size_t) ntris);
+  Edge **n_elist = new Edge *[n_nedges];
+
+  /* the edge of each side of the children, the edges each triangle makes,
+     and the corners of the children */
+
+  parallel_for (nthreads, [&](int th) {
+    int first = (int) ((size_t) ntris * th / nthreads);
+    int last = (int) ((size_t) ntris * (th + 1) / nthreads);
+
+    for (int k = first; k < last; k++) {
+      Triangle *t = tlist[k];
+      Triangle *kid = kids + 4 * (size_t) k;
+      Corner *kid_corners = corners + 12 * (size_t) k;
+      int m, j;
+
+      for (m = 0; m < 4; m++) {
+        kid[m].index = 4 * k + m;
+        for (j = 0; j < 3; j++) {
+          int which = child_side[m][j];
+          if (which >= 0) {
+            kid[m].edges[j] = edges + edge_first[k] + edge_rank (t, which);
+            continue;
+          }
+
+          /* a half is made by the lowest triangle on the old edge */
+          int h = -1 - which;
+          Edge *old = t->edges[HALF_SIDE (h)];
+          Triangle *low = old->tris[0];
+          which = half_new_side[half_in (low, old, t->verts[(HALF_SIDE (h) + HALF_END (h)) % 3])];
+          kid[m].edges[j] = edges + edge_first[low->index] + edge_rank (low, which);
+        }
+      }
+
+      for (int which = 0, n = edge_first[k]; which < 9; which++) {
+        if (!makes_edge (t, which))
+          continue;
+        Edge *e = edges + n;
+        Triangle *f = kid + new_side[which][0];
+        j = new_side[which][1];
+        e->index = n;
+        e->verts[0] = f->verts[j];
+        e->verts[1] = f->verts[(j+1) % 3];
+        e->tris = edge_tris + 2 * (size_t) n;
+
+        int h = new_side_half[which];
+        if (h < 0) {
+          e->ntris = 2;
+          e->tris[0] = f;
+          e->tris[1] = kid + new_side_other[which];
+        }
+        else {
+          Edge *old = t->edges[HALF_SIDE (h)];
+          Vertex *end = t->verts[(HALF_SIDE (h) + HALF_END (h)) % 3];
+          e->ntris = old->ntris;
+          for (int q = 0; q < old->ntris; q++) {
+            Triangle *o = old->tris[q];
+            e->tris[q] = kids + 4 * (size_t) o->index + corner_child[slot_of (o, end)];
+          }
+        }
+        n_elist[n++] = e;
+      }
+
+      for (m = 0; m < 4; m++)
+        for (j = 0; j < 3; j++) {
+          Corner *c = kid_corners + 3 * m + j;
+          c->t = kid + m;
+          c->v = kid[m].verts[j];
+          c->t_index = j;
+          c->n = kid_corners + 3 * m + (j+1) % 3;
+          c->p = kid_corners + 3 * m + (j+2) % 3;
+          c->e = kid[m].edges[(j+1) % 3];
+          kid[m].corners[j] = c;
+
+          int inner = inner_opposite[m][j];
+          if (inner >= 0) {
+            c->o = kid_corners + inner;
+            continue;
+          }
+
+          /* the corner facing the same half from the other triangle on
+             the old edge, if there is one */
+          int h = -1 - child_side[m][(j+1) % 3];
+          Edge *old = t->edges[HALF_SIDE (h)];
+          if (old->ntris < 2) {
+            c->o = NULL;
+            continue;
+          }
+          Triangle *o = (old->tris[0] == t) ? old->tris[1] : old->tris[0];
+          int across = half_new_side[half_in (o, old, t->verts[(HALF_SIDE (h) + HALF_END (h)) % 3])];
+          c->o = corners + 12 * (size_t) o->index + 3 * new_side[across][0] +
+                 (new_side[across][1] + 2) % 3;
+        }
+    }
+  });
+
+  /* the triangles and corners of each vertex: the midpoints' for the
+     triangles on their edges, and the old vertices' as many as before */
+
+  std::vector<Edge *> mid_edge (nmids);
+  for (i = 0; i < nedges; i++)
+    mid_edge[edge_midpoints[i]->index] = elist[i];
+
+  std::vector<int> n_vert_start (n_nverts + 1);
+  int total = 0;
+  for (i = 0; i < n_nverts; i++) {
+    n_vert_start[i] = total;
+    total += (i < nmids) ? 3 * mid_edge[i]->ntris : n_vlist[i]->ntris;
+  }
+  n_vert_start[n_nverts] = total;
+
+  std::vector<Triangle *> n_vert_tris (total);
+  std::vector<Corner *> n_vert_corners (total);
+  int vthreads = parallel_thread_count (n_nverts / min_block);
+
+  parallel_for (vthreads, [&](int th) {
+    int first = (int) ((size_t) n_nverts * th / vthreads);
+    int last = (int) ((size_t) n_nverts * (th + 1) / vthreads);
+
+    for (int k = first; k < last; k++) {
+      Vertex *v = n_vlist[k];
+      Triangle **vt = n_vert_tris.data () + n_vert_start[k];
+      Corner **vc = n_vert_corners.data () + n_vert_start[k];
+      int count = n_vert_start[k+1] - n_vert_start[k];
+
+      if (k < nmids) {
+        Edge *old = mid_edge[k];
+
+        /* the fan goes from the child at the far end of the side to the
+           one at the near end, and on into the triangle across */
+        Triangle *ring[6];
+        for (int q = 0; q < old->ntris; q++) {
+          Triangle *o = old->tris[q];
+          int side = side_of (o, old);
+          Triangle *kid = kids + 4 * (size_t) o->index;
+          Corner *kid_corners = corners + 12 * (size_t) o->index;
+          ring[3*q] = kid + corner_child[(side+1) % 3];
+          ring[3*q+1] = kid + MIDDLE_CHILD;
+          ring[3*q+2] = kid + corner_child[side];
+          for (int r = 0; r < 3; r++)
+            vc[3*q+r] = kid_corners + 3 * mid_child[side][r] + mid_slot[side][r];
+        }
+
+        /* one that closes up starts from its lowest triangle */
+        int start = 0;
+        if (old->ntris == 2)
+          for (int r = 1; r < 3; r++)
+            if (ring[r]->index < ring[start]->index)
+              start = r;
+        for (int r = 0; r < count; r++)
+          vt[r] = ring[(start + r) % count];
+      }
+      else {
+        for (int q = 0; q < count; q++) {
+          Triangle *o = v->tris[q];
+          vt[q] = kids + 4 * (size_t) o->index + corner_child[slot_of (o, v)];
+          Corner *c = v->corners[q];
+          vc[q] = corners + 12 * (size_t) c->t->index + 3 * corner_child[c->t_index] + c->t_index;
+        }
+      }
+
+      v->ntris = v->ncorners = count;
+      v->tris = vt;
+      v->corners = vc;
+    }
+  });
+
+  /* change over to the new edges, corners and lists */
+
+  clist.resize (12 * (size_t) ntris);
+  for (size_t k = 0; k < clist.size (); k++)
+    clist[k] = corners + k;
+
+  delete[] elist;
+  elist = n_elist;
+  nedges = max_edges = n_nedges;
+  edge_pool.swap (n_edge_pool);
+  edge_tri_pool.swap (n_edge_tri_pool);
+  corner_pool.swap (n_corner_pool);
+  vert_start.swap (n_vert_start);
+  vert_tris.swap (n_vert_tris);
+  vert_corners.swap (n_vert_corners);
+}
+
+
 void Polyhedron::subdivideRegular() {
 	printf("cur: %d\tmax: %d\n", polys.size(), polys.max_size());
 	Vertex** n_vlist;
@@ -1202,115 +2303,71 @@ void Polyhedron::subdivideRegular() {
 	}
 	int newverts = 0;
 	int newtris = 0;
+	std::vector<void*> vertSources;  //other_props each new vertex is made from
+	std::vector<void*> faceSources;
+	vertSources.reserve(2 * (size_t)nedges);
+	faceSources.reserve(4 * (size_t)ntris);
+
+	//the children go in a row in a pool of their own, which takes the place
+	//of the parents' at the end; the midpoints join the old vertices
+	Pool<Triangle> n_tri_pool;
+	Triangle* kids;
+	try {
+		kids = n_tri_pool.alloc(4 * (size_t)ntris);
+	}
+	catch (std::bad_alloc& ba) {
+		delete[] n_vlist;
+		delete[] n_tlist;
+		printf(ba.what());
+		return;
+	}
+	vert_pool.reserve(nedges);
 
+	//split each edge once, the first time one of its corners comes up
+	edge_midpoints.assign(nedges, NULL);
 	for (int i = 0; i < nverts; i++) {
-		for (int j = 0; j < vlist[i]->corners.size(); j++) {
+		for (int j = 0; j < vlist[i]->ncorners; j++) {
 			Corner* c = vlist[i]->corners[j];
-			Edge* brokenEdge1 = new Edge();
-			Edge* brokenEdge2 = new Edge();
 
 			//find new vertex
 			Edge* eToBreak = c->e;
-			double newx = (double)(eToBreak->verts[0]->x + eToBreak->verts[1]->x) / 2.0f;
-			double newy = (double)(eToBreak->verts[0]->y + eToBreak->verts[1]->y) / 2.0f;
-			double newz = (double)(eToBreak->verts[0]->z + eToBreak->verts[1]->z) / 2.0f;
-			//icVector3 nVertPos = icVector3((eToBreak->verts[0]->pos() + eToBreak->verts[1]->pos()) /= 2.0f);
-			icVector3 nVertPos = icVector3(newx, newy, newz);
-			//printf("new vert x: %f\t y: %f\tz: %f\n", nVertPos.x, nVertPos.y, nVertPos.z);
-			Vertex* nVert = new Vertex(nVertPos);
+			if (edge_midpoints[eToBreak->index] != NULL)
+				continue;
+			int a = eToBreak->verts[0]->index, b = eToBreak->verts[1]->index;
+			double newx = (vdata.x[a] + vdata.x[b]) / 2.0;
+			double newy = (vdata.y[a] + vdata.y[b]) / 2.0;
+			double newz = (vdata.z[a] + vdata.z[b]) / 2.0;
+			//printf("new vert x: %f\t y: %f\tz: %f\n", newx, newy, newz);
+			Vertex* nVert = make_vertex(newx, newy, newz);
 
 			//add new vertex to new vert list
 			n_vlist[newverts] = nVert;
 			newverts++;
+			vertSources.push_back(eToBreak->verts[0]->other_props);
+			vertSources.push_back(eToBreak->verts[1]->other_props);
 
-			//create and add broken edges
-			brokenEdge1->verts[0] = eToBreak->verts[0];
-			brokenEdge1->verts[1] = nVert;
-
-			brokenEdge2->verts[0] = eToBreak->verts[1];
-			brokenEdge2->verts[1] = nVert;
-
-			//Add broken edges to both tris
-			c->t->brokenEdges.push_back(brokenEdge1);
-			c->t->brokenEdges.push_back(brokenEdge2);
-			if (c->o != nullptr) {
-				c->o->t->brokenEdges.push_back(brokenEdge1);
-				c->o->t->brokenEdges.push_back(brokenEdge2);
-				//find and corner from opposite vertex
-				int cIndex = 0;
-				for (int k = 0; k < c->o->v->corners.size(); k++) {
-					if (c->o->v->corners[k] == c->o) {
-						cIndex = k;
-						break;
-					}
-				}
-				c->o->v->corners.erase(c->o->v->corners.begin() + cIndex);
-			}
-
-			//throw in new vertex
-			c->t->newVerts.push_back(nVert);
-			c->o->t->newVerts.push_back(nVert);
+			//every triangle on the edge finds the new vertex here
+			edge_midpoints[eToBreak->index] = nVert;
 		}
-		Vertex* v = vlist[i];
-		v->corners.clear();
 	}
 
 	//find new triangles
 	for (int i = 0; i < ntris; i++) {
 		Triangle* t = tlist[i];
 
-		Vertex* newVerts[3] = {};
-	
-		for (int j = 0; j < t->brokenEdges.size()-1; j+=2) {
-			Edge* e_0 = t->brokenEdges[j];
-			Edge* e_1 = t->brokenEdges[j + 1];
-
-			//if between 0 and 1 it must be newvert 0
-			if (e_0->verts[0] == t->verts[0] && e_1->verts[0] == t->verts[1] && (e_0->verts[1] == e_1->verts[1])) {
-				newVerts[0] = e_0->verts[1];
-			}
-			else if (e_0->verts[0] == t->verts[1] && e_1->verts[0] == t->verts[0] && (e_0->verts[1] == e_1->verts[1])) {
-				newVerts[0] = e_0->verts[1];
-			}
-
-			//if between 1 and 2 must be 1
-			if (e_0->verts[0] == t->verts[1] && e_1->verts[0] == t->verts[2] && (e_0->verts[1] == e_1->verts[1])) {
-				newVerts[1] = e_0->verts[1];
-			}
-			else if (e_0->verts[0] == t->verts[2] && e_1->verts[0] == t->verts[1] && (e_0->verts[1] == e_1->verts[1])) {
-				newVerts[1] = e_0->verts[1];
-			}
-
-			//if between 2 and 0 must be 2
-			if (e_0->verts[0] == t->verts[2] && e_1->verts[0] == t->verts[0] && (e_0->verts[1] == e_1->verts[1])) {
-				newVerts[2] = e_0->verts[1];
-			}
-			else if (e_0->verts[0] == t->verts[0] && e_1->verts[0] == t->verts[2] && (e_0->verts[1] == e_1->verts[1])) {
-				newVerts[2] = e_0->verts[1];
-			}
-		}
+		//newVerts[k] is on the edge from verts[k] to verts[(k+1)%3]
+		Vertex* newVerts[3];
+		for (int j = 0; j < 3; j++)
+			newVerts[j] = edge_midpoints[t->edges[j]->index];
 
 
-		Triangle* leftTri;// = new Triangle();
-		Triangle* topTri;// = new Triangle();
-		Triangle* rightTri;// = new Triangle();
-		Triangle* middleTri;// = new Triangle();
 		//Build triangles
-		try {
-			leftTri = new Triangle;
-			topTri = new Triangle;
-			rightTri = new Triangle;
-			middleTri = new Triangle;
-		}
-		catch (std::bad_alloc& ba) {
-			free(n_vlist);
-			free(n_tlist);
-			printf(ba.what());
-			return;
-		}
-		
+		Triangle* leftTri = kids + 4 * (size_t)i;
+		Triangle* middleTri = leftTri + 1;
+		Triangle* topTri = leftTri + 2;
+		Triangle* rightTri = leftTri + 3;
 
-		//printf("mid:-- x: %f\t y: %f\tz: %f\n", newVerts[2]->x, newVerts[2]->y, newVerts[2]->z);
+		//printf("mid:-- x: %f\t y: %f\tz: %f\n", newVerts[2]->pos().x, newVerts[2]->pos().y, newVerts[2]->pos().z);
 		middleTri->verts[0] = newVerts[0];		middleTri->verts[1] = newVerts[1];		middleTri->verts[2] = newVerts[2];
 		leftTri->verts[0] = t->verts[0];		leftTri->verts[1] = newVerts[0];		leftTri->verts[2] = newVerts[2];
 		topTri->verts[0] = newVerts[0];			topTri->verts[1] = t->verts[1];			topTri->verts[2] = newVerts[1];
@@ -1326,35 +2383,54 @@ void Polyhedron::subdivideRegular() {
 		n_tlist[newtris] = middleTri; newtris++;
 		n_tlist[newtris] = topTri; newtris++;
 		n_tlist[newtris] = rightTri; newtris++;
+		for (int j = 0; j < 4; j++)
+			faceSources.push_back(t->other_props);
 
 	}
 
+	//midpoints take the average of their edge's ends, children their parent's
+	char* vertOther = combine_other_props("vertex", 2, vertSources);
+	for (int i = 0; i < newverts; i++)
+		n_vlist[i]->other_props = vertOther ? vertOther + (size_t)i * vert_other->size : NULL;
+	std::vector<char*> oldFaceOther;
+	oldFaceOther.swap(face_other_data);
+	char* faceOther = combine_other_props("face", 1, faceSources);
+	for (int i = 0; i < newtris; i++)
+		n_tlist[i]->other_props = faceOther ? faceOther + (size_t)i * face_other->size : NULL;
+	for (int i = 0; i < oldFaceOther.size(); i++)
+		delete[] oldFaceOther[i];
+
 	//move and clear verts
 	for (int i = 0; i < nverts; i++) {
 		n_vlist[newverts] = vlist[i];
 		newverts++;
 	}
 	
-	//clear corners
-	for (int i = 0; i < clist.size(); i++) {		delete clist[i];	}
-	clist.clear();
-	for (int i = 0; i < ntris; i++) {
-		delete tlist[i];
-	}
-	for (int i = 0; i < nedges; i++) {
-		delete elist[i];
-	}
-	free(tlist);
-	free(elist);
+	//the children's edges, corners and fans follow from the parents', unless
+	//some edge is shared oddly, and then initialize() finds them anew
+	int direct = splits_cleanly();
+	if (direct)
+		subdivide_pointers(kids, n_vlist, newverts);
+
+	//the parents go with their pool, a block at a time
+	tri_pool.swap(n_tri_pool);
+	n_tri_pool.clear();
+	delete[] tlist;
+	delete[] vlist;
 
-	
 	vlist = n_vlist;
 	tlist = n_tlist;
 	nverts = newverts;
 	ntris = newtris;
-	poly->initialize();
-	poly->calc_face_normals_and_area();
-	poly->average_normals();
+	if (direct) {
+		pack_vertices();
+		calc_edge_length();
+		seed = -1;
+	}
+	else
+		initialize();
+	calc_face_normals_and_area();
+	average_normals();
 
 }
 
@@ -1374,99 +2450,92 @@ void Polyhedron::subdivideIrregular() {
 	}
 	int newverts = 0;
 	int newtris = 0;
+	std::vector<void*> vertSources;  //other_props each new vertex is made from
+	std::vector<void*> faceSources;
+	std::vector<Triangle*> childTris;
 	//find all angles for all corners
-	for (int i = 0; i < poly->clist.size(); i++) {
-		Corner* c = poly->clist[i];
+	for (int i = 0; i < clist.size(); i++) {
+		Corner* c = clist[i];
 		c->findAngle();
 	}
 	double avgArea = 0;
 	for (int i = 0; i < ntris; i++) {
 		Triangle* t = tlist[i];
-		t->newVerts.reserve(3 * sizeof(Vertex*));
 		avgArea = avgArea + t->area;
 	}
 	avgArea = avgArea / (double)ntris;
 	//printf("avg area: %f\n", avgArea);
 
+	//the split edges of this pass, by edge index; an edge is broken once it has one
+	edge_midpoints.assign(nedges, NULL);
+	std::vector<Vertex*>& broken = edge_midpoints;
+
 	//For each triagle
 	for (int i = 0; i < ntris; i++) {
 		Triangle* t = tlist[i];
 		
-		std::vector<Corner*> c;
-		c.reserve(3 * sizeof(Corner*));
-		
-		c.clear();
-		//printf("%d\n", t->corners.size());
-		c.push_back( t->corners[0]); c.push_back (t->corners[1]); c.push_back(t->corners[2]);
+		Corner* c[3] = { t->corners[0], t->corners[1], t->corners[2] };
+		//new_verts[k] is on the edge from verts[k] to verts[(k+1)%3], once it is broken
+		Vertex* new_verts[3];
 		//Find what type of break to do
 		for (int j = 0; j < 3; j++) {
 			//If any angle is greater then 90 must be a massive edge
 			if (c[j]->theta > PI / 2) {
-				if (c[j]->e->broken) {
-					//printf("cj broken it shouldnt be\n");
-				}
 				//printf("Performing 1 edge break\n");
 				//if()
 				n_tlist[newtris] = t;
-				t->brokenEdges.clear();
-				t->corners.clear();
-				t->newVerts.clear();
 				newtris++;
 				break;
 			}
 			//if any angle is less then 30 degrees and all others are greater the 60
-			else if (c[j]->theta < PI / 6 && c[(j+1) % 3]->theta > PI/3 && c[(j + 2) % 3]->theta > PI / 3 && !c[j]->e->broken) {
+			else if (c[j]->theta < PI / 6 && c[(j+1) % 3]->theta > PI/3 && c[(j + 2) % 3]->theta > PI / 3 && !broken[c[j]->e->index]) {
 				if (t->area < avgArea / (double)4) {
 					printf("small tri found will not subdivide\n");
 					n_tlist[newtris] = t;
-					t->brokenEdges.clear();
-					t->corners.clear();
-					t->newVerts.clear();
 					newtris++;
 					continue;
 				}
-				if (c[j]->e->broken) {
-					printf("cj broken it shouldnt be\n");
-				}
 				//printf("Performing 2 edge break\n");
 				int index[2] = { ((j + 1) % 3),((j + 2) % 3 )};
 				for (int m = 0; m < 2; m++) {
-					if (!c[index[m]]->e->broken) {
-						c[index[m]]->e->broken = true;
+					if (!broken[c[index[m]]->e->index]) {
 						Edge* eToBreak = c[index[m]]->e;
-						double newx = (double)(eToBreak->verts[0]->x + eToBreak->verts[1]->x) / 2.0f;
-						double newy = (double)(eToBreak->verts[0]->y + eToBreak->verts[1]->y) / 2.0f;
-						double newz = (double)(eToBreak->verts[0]->z + eToBreak->verts[1]->z) / 2.0f;
-						icVector3 nVertPos = icVector3(newx, newy, newz);
-						Vertex* nVert = new Vertex(nVertPos);
+						int a = eToBreak->verts[0]->index, b = eToBreak->verts[1]->index;
+						double newx = (vdata.x[a] + vdata.x[b]) / 2.0;
+						double newy = (vdata.y[a] + vdata.y[b]) / 2.0;
+						double newz = (vdata.z[a] + vdata.z[b]) / 2.0;
+						Vertex* nVert = make_vertex(newx, newy, newz);
 
 						//add new vertex to new vert list
 						n_vlist[newverts] = nVert;
 						newverts++;
-						t->new_verts[(c[index[m]]->t_index + 1) % 3] = nVert;
-						c[index[m]]->o->t->new_verts[(c[index[m]]->o->t_index + 1) % 3] = nVert;
+						vertSources.push_back(eToBreak->verts[0]->other_props);
+						vertSources.push_back(eToBreak->verts[1]->other_props);
+						broken[eToBreak->index] = nVert;
 					}
 				}
 				//perform 2 edge break
+				for (int m = 0; m < 3; m++)
+					new_verts[m] = broken[t->edges[m]->index];
 				Vertex* sortedNewV[2];
-				if (t->new_verts[0] == NULL) {
-					sortedNewV[0] = t->new_verts[1];
-					sortedNewV[1] = t->new_verts[2];
-				}else if (t->new_verts[1] == NULL) {
-					sortedNewV[0] = t->new_verts[0];
-					sortedNewV[1] = t->new_verts[2];
+				if (new_verts[0] == NULL) {
+					sortedNewV[0] = new_verts[1];
+					sortedNewV[1] = new_verts[2];
+				}else if (new_verts[1] == NULL) {
+					sortedNewV[0] = new_verts[0];
+					sortedNewV[1] = new_verts[2];
 				}
 				else {
-					sortedNewV[0] = t->new_verts[0];
-					sortedNewV[1] = t->new_verts[1];
+					sortedNewV[0] = new_verts[0];
+					sortedNewV[1] = new_verts[1];
 				}
 				Triangle* leftTri; Triangle* topTri; Triangle* rightTri;
 				try {
-					leftTri = new Triangle;	topTri = new Triangle;	rightTri = new Triangle;
+					leftTri = tri_pool.make();	topTri = tri_pool.make();	rightTri = tri_pool.make();
 				}
 				catch (std::bad_alloc& ba) {
-					free(n_vlist);
-					free(n_tlist);
+					delete[] n_vlist;
+					delete[] n_tlist;
 					printf(ba.what());
 					return;
 				}
@@ -1480,6 +2549,9 @@ void Polyhedron::subdivideIrregular() {
 				n_tlist[newtris] = leftTri; newtris++;
 				n_tlist[newtris] = topTri; newtris++;
 				n_tlist[newtris] = rightTri; newtris++;
+				childTris.push_back(leftTri); childTris.push_back(topTri); childTris.push_back(rightTri);
+				for (int m = 0; m < 3; m++)
+					faceSources.push_back(t->other_props);
 
 				break;
 			}
@@ -1488,37 +2560,39 @@ void Polyhedron::subdivideIrregular() {
 				//perform 3 edge break
 				//for all corners break opposite edge if unbroken 
 				for (int m = 0; m < 3; m++) {
-					if (!c[m]->e->broken) {
-						c[m]->e->broken = true;
+					if (!broken[c[m]->e->index]) {
 						Edge* eToBreak = c[m]->e;
-						double newx = (double)(eToBreak->verts[0]->x + eToBreak->verts[1]->x) / 2.0f;
-						double newy = (double)(eToBreak->verts[0]->y + eToBreak->verts[1]->y) / 2.0f;
-						double newz = (double)(eToBreak->verts[0]->z + eToBreak->verts[1]->z) / 2.0f;
-						icVector3 nVertPos = icVector3(newx, newy, newz);
-						Vertex* nVert = new Vertex(nVertPos);
+						int a = eToBreak->verts[0]->index, b = eToBreak->verts[1]->index;
+						double newx = (vdata.x[a] + vdata.x[b]) / 2.0;
+						double newy = (vdata.y[a] + vdata.y[b]) / 2.0;
+						double newz = (vdata.z[a] + vdata.z[b]) / 2.0;
+						Vertex* nVert = make_vertex(newx, newy, newz);
 
 						//add new vertex to new vert list
 						n_vlist[newverts] = nVert;
 						newverts++;
-						t->new_verts[(c[m]->t_index+1) % 3] = nVert;
-						c[m]->o->t->new_verts[(c[m]->o->t_index + 1) % 3] = nVert;
+						vertSources.push_back(eToBreak->verts[0]->other_props);
+						vertSources.push_back(eToBreak->verts[1]->other_props);
+						broken[eToBreak->index] = nVert;
 					}
 				}
+				for (int m = 0; m < 3; m++)
+					new_verts[m] = broken[t->edges[m]->index];
 				Triangle* leftTri;Triangle* topTri;Triangle* rightTri;Triangle* middleTri;
 				//Build triangles
 				try {
-					leftTri = new Triangle;	topTri = new Triangle;	rightTri = new Triangle;	middleTri = new Triangle;
+					leftTri = tri_pool.make();	topTri = tri_pool.make();	rightTri = tri_pool.make();	middleTri = tri_pool.make();
 				}
 				catch (std::bad_alloc& ba) {
-					free(n_vlist);
-					free(n_tlist);
+					delete[] n_vlist;
+					delete[] n_tlist;
 					printf(ba.what());
 					return;
 				}
-				middleTri->verts[0] = t->new_verts[0];		middleTri->verts[1] = t->new_verts[1];		middleTri->verts[2] = t->new_verts[2];
-				leftTri->verts[0] = t->verts[0];		leftTri->verts[1] = t->new_verts[0];		leftTri->verts[2] = t->new_verts[2];
-				topTri->verts[0] = t->new_verts[0];			topTri->verts[1] = t->verts[1];			topTri->verts[2] = t->new_verts[1];
-				rightTri->verts[0] = t->new_verts[2];		rightTri->verts[1] = t->new_verts[1];		rightTri->verts[2] = t->verts[2];
+				middleTri->verts[0] = new_verts[0];		middleTri->verts[1] = new_verts[1];		middleTri->verts[2] = new_verts[2];
+				leftTri->verts[0] = t->verts[0];		leftTri->verts[1] = new_verts[0];		leftTri->verts[2] = new_verts[2];
+				topTri->verts[0] = new_verts[0];			topTri->verts[1] = t->verts[1];			topTri->verts[2] = new_verts[1];
+				rightTri->verts[0] = new_verts[2];		rightTri->verts[1] = new_verts[1];		rightTri->verts[2] = t->verts[2];
 
 				middleTri->nverts = 3;		leftTri->nverts = 3;		rightTri->nverts = 3;		topTri->nverts = 3;
 				//store triangles back into ntriangle list
@@ -1526,6 +2600,9 @@ void Polyhedron::subdivideIrregular() {
 				n_tlist[newtris] = middleTri; newtris++;
 				n_tlist[newtris] = topTri; newtris++;
 				n_tlist[newtris] = rightTri; newtris++;
+				childTris.push_back(leftTri); childTris.push_back(middleTri); childTris.push_back(topTri); childTris.push_back(rightTri);
+				for (int m = 0; m < 4; m++)
+					faceSources.push_back(t->other_props);
 				
 				break;
 			}				
@@ -1537,31 +2614,32 @@ void Polyhedron::subdivideIrregular() {
 
 
 
+	//midpoints take the average of their edge's ends, children their parent's
+	char* vertOther = combine_other_props("vertex", 2, vertSources);
+	for (int i = 0; i < newverts; i++)
+		n_vlist[i]->other_props = vertOther ? vertOther + (size_t)i * vert_other->size : NULL;
+	char* faceOther = combine_other_props("face", 1, faceSources);
+	for (int i = 0; i < childTris.size(); i++)
+		childTris[i]->other_props = faceOther ? faceOther + (size_t)i * face_other->size : NULL;
+
 	//move and clear verts
 	for (int i = 0; i < nverts; i++) {
 		n_vlist[newverts] = vlist[i];
 		newverts++;
 	}
 
-	//clear corners
-	for (int i = 0; i < clist.size(); i++) { delete clist[i]; }
-	clist.clear();
-	/*for (int i = 0; i < ntris; i++) {
-		delete tlist[i];
-	}*/
-	for (int i = 0; i < nedges; i++) {
-		delete elist[i];
-	}
-	free(tlist);
-	free(elist);
+	//the triangles that were split stay in the pool with the ones kept; the
+	//edges and corners are made again by initialize()
+	delete[] tlist;
+	delete[] vlist;
 
 	vlist = n_vlist;
 	tlist = n_tlist;
 	nverts = newverts;
 	ntris = newtris;
-	poly->initialize();
-	poly->calc_face_normals_and_area();
-	poly->average_normals();
+	initialize();
+	calc_face_normals_and_area();
+	average_normals();
 }
 
 double L = .1;
@@ -1579,15 +2657,16 @@ int colorSwitch(double pos) {
 }
 
 void findCheckerboard() {
-	resetVertexColors();
-
-	for (int i = 0; i < poly->nverts; i++) {
-		Vertex* v = poly->vlist[i];
-
-		v->r = colorSwitch(((double)v->x/L));
-		v->g = colorSwitch((double)(v->y)/L);
-		v->b = colorSwitch((double)(v->z)/L);
-	}
+	//every color is set, so no need to reset them first; each coordinate
+	//picks its color straight through its own array
+	VertexArrays& vdata = poly->vdata;
+	int n = vdata.size();
+	for (int i = 0; i < n; i++)
+		vdata.r[i] = colorSwitch(vdata.x[i]/L);
+	for (int i = 0; i < n; i++)
+		vdata.g[i] = colorSwitch(vdata.y[i]/L);
+	for (int i = 0; i < n; i++)
+		vdata.b[i] = colorSwitch(vdata.z[i]/L);
 }
 
 
@@ -1598,12 +2677,12 @@ Process a keyboard action.  In particular, exit the program when an
 ******************************************************************************/
 char lastcommand; int curPoly = 0;
 void keyboard(unsigned char key, int x, int y) {
-	int i;
+	int i, n;
 
   /* set escape key to exit */
   switch (key) {
     case 27:
-			poly->finalize();  // finalize_everything
+			close_model_list();  // finalize_everything
       exit(0);
       break;
 
@@ -1640,6 +2719,7 @@ void keyboard(unsigned char key, int x, int y) {
 			//lastcommand = '4';
 			display_mode = 6;
 			poly->subdivideRegular();
+			select_model(curPoly);  // make room for the finer mesh
 			keyboard(lastcommand, 0, 0);
 			//display();
 
@@ -1649,6 +2729,7 @@ void keyboard(unsigned char key, int x, int y) {
 			lastcommand = '5';
 			display_mode = 6;
 			poly->subdivideIrregular();
+			select_model(curPoly);  // make room for the finer mesh
 			display();
 			break;
 
@@ -1695,6 +2776,32 @@ void keyboard(unsigned char key, int x, int y) {
 			display();
 			break;
 
+		case 'w':
+			{
+				/* export the current (possibly subdivided) model as binary PLY */
+				char out_name[1024];
+				sprintf(out_name, "%s_out.ply", modelNames[curPoly]);
+				this_file = fopen(out_name, "wb");
+				if (this_file == NULL) {
+					fprintf(stderr, "can't write %s\n", out_name);
+					break;
+				}
+				poly->write_file(this_file, PLY_BINARY_LE);  // closes the file
+				fprintf(stderr, "wrote %s\n", out_name);
+			}
+			break;
+
+		case 'o':
+		case 's':
+			{
+				/* export the current model as OBJ or binary STL */
+				char out_name[1024];
+				sprintf(out_name, "%s_out.%s", modelNames[curPoly], key == 'o' ? "obj" : "stl");
+				int ok = (key == 'o') ? write_obj_mesh(poly, out_name) : write_stl_mesh(poly, out_name);
+				fprintf(stderr, ok ? "wrote %s\n" : "can't write %s\n", out_name);
+			}
+			break;
+
 		case '|':
 			this_file = fopen("rotmat.txt", "w");
 			for (i=0; i<4; i++) 
@@ -1710,9 +2817,15 @@ void keyboard(unsigned char key, int x, int y) {
 			display();
 			break;
 		case ']':
+			i = curPoly;
 			curPoly = (curPoly + 1) % polys.size();
 			
-			poly = polys[curPoly];
+			poly = select_model(curPoly);
+			if (poly == NULL) {  // its mesh has problems; go back to the last one
+				curPoly = i;
+				poly = select_model(curPoly);
+				break;
+			}
 			printf("--------");
 			printf(modelNames[curPoly]);
 			printf(" Info----------\n");
@@ -1725,8 +2838,15 @@ void keyboard(unsigned char key, int x, int y) {
 			display();
 			break;
 		case '[':
-			curPoly = (curPoly - 1) % polys.size();
-			poly = polys[curPoly];
+			i = curPoly;
+			n = (int) polys.size();
+			curPoly = (curPoly + n - 1) % n;
+			poly = select_model(curPoly);
+			if (poly == NULL) {
+				curPoly = i;
+				poly = select_model(curPoly);
+				break;
+			}
 			printf("--------");
 			printf(modelNames[curPoly]);
 			printf(" Info----------\n");
@@ -1746,6 +2866,9 @@ Polyhedron::Polyhedron()
 {
 	nverts = nedges = ntris = 0;
 	max_verts = max_tris = 50;
+	in_ply = NULL;
+	vert_other = face_other = NULL;
+	vert_rules = face_rules = NULL;
 
 	vlist = new Vertex *[max_verts];
 	tlist = new Triangle *[max_tris];		
@@ -1951,6 +3074,7 @@ void display_object()
 {
 	unsigned int i, j;
 	Polyhedron *the_patch = poly;
+	VertexArrays &vdata = poly->vdata;
 	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 	glShadeModel(GL_SMOOTH);
 	glEnable(GL_LIGHTING);
@@ -1966,9 +3090,9 @@ void display_object()
 		
 		glNormal3d(temp_t->normal.entry[0], temp_t->normal.entry[1], temp_t->normal.entry[2]);
 		for (j=0; j<3; j++) {
-			Vertex *temp_v = temp_t->verts[j];
-			glColor3d(temp_v->r, temp_v->g, temp_v->b);
-			glVertex3d(temp_v->x, temp_v->y, temp_v->z);
+			int k = temp_t->verts[j]->index;
+			glColor3d(vdata.r[k], vdata.g[k], vdata.b[k]);
+			glVertex3d(vdata.x[k], vdata.y[k], vdata.z[k]);
 		}
 		glEnd();
 	}
@@ -1978,6 +3102,7 @@ void display_shape(GLenum mode, Polyhedron *this_poly)
 {
 	unsigned int i, j;
 	GLfloat mat_diffuse[4];
+	VertexArrays &vdata = this_poly->vdata;
 
   glEnable (GL_POLYGON_OFFSET_FILL);
   glPolygonOffset (1., 1.);
@@ -2012,15 +3137,15 @@ void display_shape(GLenum mode, Polyhedron *this_poly)
 			glBegin(GL_POLYGON);
 			for (j=0; j<3; j++) {
 
-				Vertex *temp_v = temp_t->verts[j];
-				glNormal3d(temp_v->normal.entry[0], temp_v->normal.entry[1], temp_v->normal.entry[2]);
+				int k = temp_t->verts[j]->index;
+				glNormal3d(vdata.nx[k], vdata.ny[k], vdata.nz[k]);
 				if (i==this_poly->seed)
 					glColor3f(0.0, 0.0, 1.0);
 				else
 					glColor3f(1.0, 1.0, 0.0);
 				
 				glColor3d(1.0, .0, .0);
-				glVertex3d(temp_v->x, temp_v->y, temp_v->z);
+				glVertex3d(vdata.x[k], vdata.y[k], vdata.z[k]);
 			}
 			glEnd();
 			break;
@@ -2029,14 +3154,14 @@ void display_shape(GLenum mode, Polyhedron *this_poly)
 			//glBegin(GL_LINE_LOOP);
 			glBegin(GL_POLYGON);
 			for (j=0; j<3; j++) {
-				Vertex *temp_v = temp_t->verts[j];
+				int k = temp_t->verts[j]->index;
 				glNormal3d(temp_t->normal.entry[0], temp_t->normal.entry[1], temp_t->normal.entry[2]);
-				//glColor3d(temp_v->r, temp_v->g, temp_v->b);
-				mat_diffuse[0] = temp_v->r;
-				mat_diffuse[1] = temp_v->g;
-				mat_diffuse[2] = temp_v->b;
+				//glColor3d(vdata.r[k], vdata.g[k], vdata.b[k]);
+				mat_diffuse[0] = vdata.r[k];
+				mat_diffuse[1] = vdata.g[k];
+				mat_diffuse[2] = vdata.b[k];
 				glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
-				glVertex3d(temp_v->x, temp_v->y, temp_v->z);
+				glVertex3d(vdata.x[k], vdata.y[k], vdata.z[k]);
 			}
 			glEnd();
 			break;
@@ -2044,15 +3169,15 @@ void display_shape(GLenum mode, Polyhedron *this_poly)
 			glDisable(GL_LIGHTING);
 			glBegin(GL_POLYGON);
 			for (j = 0; j < 3; j++) {
-				Vertex* temp_v = temp_t->verts[j];
+				int k = temp_t->verts[j]->index;
 				glNormal3d(temp_t->normal.entry[0], temp_t->normal.entry[1], temp_t->normal.entry[2]);
-				//glColor3d(temp_v->r, temp_v->g, temp_v->b);
-				/*mat_diffuse[0] = temp_v->r;
-				mat_diffuse[1] = temp_v->g;
-				mat_diffuse[2] = temp_v->b;*/
-				glColor3d(temp_v->r, temp_v->g, temp_v->b);
+				//glColor3d(vdata.r[k], vdata.g[k], vdata.b[k]);
+				/*mat_diffuse[0] = vdata.r[k];
+				mat_diffuse[1] = vdata.g[k];
+				mat_diffuse[2] = vdata.b[k];*/
+				glColor3d(vdata.r[k], vdata.g[k], vdata.b[k]);
 				//glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
-				glVertex3d(temp_v->x, temp_v->y, temp_v->z);
+				glVertex3d(vdata.x[k], vdata.y[k], vdata.z[k]);
 			}
 			glEnd();
 			break;
@@ -2066,11 +3191,11 @@ void display_shape(GLenum mode, Polyhedron *this_poly)
 		
 				glMaterialfv(GL_FRONT, GL_DIFFUSE, mat_diffuse);
 
-				Vertex *temp_v = temp_t->verts[j];
+				int k = temp_t->verts[j]->index;
 				glNormal3d(temp_t->normal.entry[0], temp_t->normal.entry[1], temp_t->normal.entry[2]);
 
 				glColor3f(1.0, 0.0, 0.0);
-				glVertex3d(temp_v->x, temp_v->y, temp_v->z);
+				glVertex3d(vdata.x[k], vdata.y[k], vdata.z[k]);
 			}
 			glEnd();
 			break;
@@ -2117,14 +3242,21 @@ void display(void)
 
 void Polyhedron::average_normals()
 {
-	int i, j;
-
-	for (i=0; i<nverts; i++) {
-		vlist[i]->normal = icVector3(0.0);
-		for (j=0; j<vlist[i]->ntris; j++) 
-			vlist[i]->normal += vlist[i]->tris[j]->normal;
-		normalize(vlist[i]->normal);
-	}
+	//each vertex reads its own run of vert_tris, so split them among threads
+	int nthreads = parallel_thread_count(nverts / 16384);
+	parallel_for(nthreads, [&](int t) {
+		int first = (int)((size_t)nverts * t / nthreads);
+		int last = (int)((size_t)nverts * (t + 1) / nthreads);
+		for (int i = first; i < last; i++) {
+			icVector3 normal(0.0);
+			for (int j = vert_start[i]; j < vert_start[i + 1]; j++)
+				normal += vert_tris[j]->normal;
+			normalize(normal);
+			vdata.nx[i] = normal.x;
+			vdata.ny[i] = normal.y;
+			vdata.nz[i] = normal.z;
+		}
+	});
 }
 
 
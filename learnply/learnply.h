@@ -12,6 +12,7 @@ Eugene Zhang 2005
 
 #include "ply.h"
 #include "icVector.H"
+#include "pool.h"
 #include <vector>
 
 
@@ -21,28 +22,49 @@ const double PI=3.1415926535898;
 /* forward declarations */
 class Triangle;
 class Corner;
+class CornerTable;
+struct MeshCache;
+
+/*
+Positions, normals and colors of a polyhedron's vertices, each coordinate
+in an array of its own indexed by Vertex::index, so that loops over all the
+vertices read memory straight through.  The arrays are the only copy of the
+positions: a vertex is given its slot when it is made, by
+Polyhedron::make_vertex(), and Polyhedron::pack_vertices() puts the slots
+in the order of the vertex list again after it has changed.
+*/
+class VertexArrays {
+public:
+  std::vector<double> x, y, z;      /* positions */
+  std::vector<double> nx, ny, nz;   /* normals, from average_normals() */
+  std::vector<double> r, g, b;      /* colors */
+
+  int size() const { return (int) x.size(); }
+
+  icVector3 pos(int i) const { return icVector3(x[i], y[i], z[i]); }
+  icVector3 normal(int i) const { return icVector3(nx[i], ny[i], nz[i]); }
+
+  void set_color(int i, double rr, double gg, double bb) { r[i] = rr; g[i] = gg; b[i] = bb; }
+};
 
 class Vertex {
 public:
-  double x,y,z;
-  int index;
+  int index;                  /* place in the vertex list and in the VertexArrays */
+  const VertexArrays *data;   /* the arrays holding the position */
 
-  int ntris;
-  Triangle **tris;
-  std::vector<Corner*> corners;
-  int max_tris;
+  int ntris = 0;
+  Triangle **tris = NULL;     /* ntris entries of the polyhedron's vert_tris */
+  int ncorners = 0;
+  Corner **corners = NULL;    /* ncorners entries of the polyhedron's vert_corners */
 
-	icVector3 normal;
   void *other_props;
 
-  //holds vertex color settings
-  double r = .60, g = .60, b = .6;
+  /* the position, normal and color are kept in the VertexArrays, at index */
 
 public:
-  Vertex(double xx, double yy, double zz) { x = xx; y = yy; z = zz; }
-  Vertex(icVector3 pos) { x = pos.x; y =  pos.y; z = pos.z; }
-  icVector3 pos() {
-	  return icVector3(x, y, z);
+  Vertex(const VertexArrays *arrays, int i) { data = arrays; index = i; }
+  icVector3 pos() const {
+	  return data->pos(index);
   }
 };
 
@@ -53,7 +75,6 @@ public:
   int ntris;
   Triangle **tris;
 	double length;
-	bool broken = false;
 };
 
 class Triangle {
@@ -61,14 +82,8 @@ public:
   int index;
   int nverts;
   Vertex *verts[3];
-  //for irregular
-  Vertex* new_verts[3] = { NULL, NULL, NULL };
-  Edge *edges[3];
-  std::vector<Edge*> brokenEdges;
-  //for regualr
-  std::vector<Vertex*> newVerts;
-  std::vector<Corner*> corners;
-	double angle[3];
+  Edge *edges[3];             /* edges[k] goes from verts[k] to verts[(k+1)%3] */
+  Corner *corners[3] = { NULL, NULL, NULL };  /* corner at each of verts, from create_corners() */
 	float area;
 
 	icVector3 normal;
@@ -101,6 +116,75 @@ public:
 	void findAngle();
 };
 
+/*
+Walk the fan of triangles around a vertex in order, swinging from each of
+the vertex's corners to the next across the edge they share by way of the
+opposite corners, without allocating anything.  Going forward, each
+triangle shares corner()->p->v with the one after it; the ring of
+neighboring vertices is corner()->n->v of every step, and at a boundary
+also corner()->p->v of the last.
+
+  for (OneRing r(v); !r.done(); r.next())
+    ... r.corner(), r.tri(), r.vert() ...
+
+The walk starts at v->tris[0], which create_pointers() puts on a boundary
+if the vertex is on one, and ends at a boundary or back at the start.  It
+takes at most as many steps as the vertex has corners, so a vertex whose
+triangles form several fans is only walked around one of them.
+*/
+class OneRing {
+	Corner *start, *c;
+	int steps, max_steps;
+
+public:
+	OneRing(Vertex *v) { begin(v->ntris > 0 ? corner_in(v->tris[0], v) : NULL); }
+	OneRing(Corner *from) { begin(from); }
+
+	bool done() const { return c == NULL; }
+	void next() {
+		c = swing(c);
+		if (c == start || ++steps >= max_steps)
+			c = NULL;
+	}
+
+	Corner *corner() const { return c; }
+	Triangle *tri() const { return c->t; }
+	Vertex *vert() const { return c->n->v; }
+
+	/* the corner of a triangle at a vertex, or NULL */
+	static Corner *corner_in(Triangle *t, Vertex *v) {
+		for (int j = 0; j < 3; j++)
+			if (t->corners[j] != NULL && t->corners[j]->v == v)
+				return t->corners[j];
+		return NULL;
+	}
+
+	/* the next corner around c->v, across the edge from c->v to c->p->v, or NULL */
+	static Corner *swing(Corner *c) {
+		Corner *o = c->n->o;
+		if (o == NULL)
+			return NULL;
+		return (o->n->v == c->v) ? o->n : (o->p->v == c->v) ? o->p : NULL;
+	}
+
+	/* the previous corner around c->v, across the edge from c->v to c->n->v, or NULL */
+	static Corner *unswing(Corner *c) {
+		Corner *o = c->p->o;
+		if (o == NULL)
+			return NULL;
+		return (o->p->v == c->v) ? o->p : (o->n->v == c->v) ? o->n : NULL;
+	}
+
+private:
+	void begin(Corner *from) {
+		start = c = from;
+		steps = 0;
+		max_steps = (from != NULL) ? from->v->ncorners : 0;
+	}
+};
+
+
+#define DEFAULT_VERTEX_COLOR  0.6
 
 
 class Polyhedron {
@@ -117,21 +201,52 @@ int index;
   int nverts;
   int max_verts;
 
-  Edge **elist;      /* list of edges */
-  int nedges;
-  int max_edges;
+  Edge **elist = NULL;  /* list of edges, made by initialize() */
+  int nedges = 0;
+  int max_edges = 0;
+
+  /* triangles and corners around each vertex, one vertex after another;
+     vertex i's are from vert_start[i] up to vert_start[i+1] */
+  std::vector<int> vert_start;
+  std::vector<Triangle *> vert_tris;
+  std::vector<Corner *> vert_corners;
+
+  VertexArrays vdata;   /* positions, normals and colors, by vertex index */
+
+  /* where subdivision splits each edge, by edge index, or NULL; filled
+     anew by every pass, which reuses the space of the one before */
+  std::vector<Vertex *> edge_midpoints;
+
+  /* the elements are made in these, and are only freed all together: the
+     edges and corners when they are made again, everything by finalize() */
+  Pool<Vertex> vert_pool;
+  Pool<Triangle> tri_pool;
+  Pool<Edge> edge_pool;
+  Pool<Triangle *> edge_tri_pool;   /* the tris of every edge */
+  Pool<Corner> corner_pool;
 
 icVector3 center;
 double radius;
+icVector3 bbox_min, bbox_max;  /* bounding box, from calc_bounding_sphere() */
 double area;
 
 int seed;
+unsigned char orientation;  // 0=ccw, 1=cw
+
+  CornerTable *ctable = NULL;     /* made by corner_table() when first needed */
 
+  PlyFile *in_ply;                 /* header of the file this was read from */
   PlyOtherProp *vert_other,*face_other;
+  PlyPropRules *vert_rules,*face_rules;  /* how subdivision combines other_props */
+  std::vector<char *> vert_other_data,face_other_data;  /* blocks holding the other_props */
+  int read_failed = 0;             /* set by Polyhedron(FILE *) when the file can't be used */
 
 	void average_normals();
 	void subdivideRegular();
 	void subdivideIrregular();
+	int splits_cleanly();
+	void subdivide_pointers(Triangle *, Vertex **, int);
+	char *combine_other_props(char *, int, std::vector<void *> &);
 	void create_corners();
 	void clear_corner_vectors();
 	void create_edge(Vertex *, Vertex *);
@@ -144,17 +259,26 @@ int seed;
 	void calc_bounding_sphere();
 	void calc_face_normals_and_area();
 	void calc_edge_length();
+	void pack_vertices();
+	void reorder_vertices(Vertex **, int);
+	Vertex *make_vertex(double, double, double);
 
 	Polyhedron();
   Polyhedron(FILE *);
+  Polyhedron(FILE *, MeshCache *);
   void write_file(FILE *);
+  void write_file(FILE *, int);
 
   void create_pointers();
+  CornerTable *corner_table();
 
 	// initialization and finalization
 	void initialize();
 	void finalize();
 };
 
+/* lay out the other_props of a PLY file's vertices and faces from its header */
+void describe_other_props(PlyFile *, PlyOtherProp **, PlyOtherProp **);
+
 #endif /* __LEARNPLY_H__ */
 
@@ -0,0 +1,743 @@
+/*
+
+Cache files that hold a mesh together with its topology.
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "learnply.h"
+#include "mesh_cache.h"
+#include "mesh_check.h"
+#include "compressed_mesh.h"
+#include "mesh_formats.h"
+#include "mesh_weld.h"
+
+
+/* how much of the source file goes into its hash */
+#define HASH_SAMPLES      64
+#define HASH_SAMPLE_SIZE  4096
+
+
+/******************************************************************************
+Name of the cache file that goes with a PLY file.  The caller deletes it.
+******************************************************************************/
+
+static char *cache_name(char *ply_name)
+{
+  char *name = new char[strlen (ply_name) + 2];
+
+  strcpy (name, ply_name);
+  strcat (name, "c");
+  return (name);
+}
+
+
+/******************************************************************************
+Identify the current contents of a PLY file by its size, its modification
+time and a hash of its start, its end and evenly spaced blocks in between.
+Hashing a sample keeps this cheap for large scans, while still catching a
+file that was rewritten with the same size within the same second.
+
+Entry:
+  ply_name - name of the file
+
+Exit:
+  size  - size of the file
+  mtime - modification time of the file
+  hash  - hash of the sampled blocks
+  returns 1 if the file could be read, 0 if not
+******************************************************************************/
+
+static int source_fingerprint(
+  char *ply_name,
+  long long *size,
+  long long *mtime,
+  unsigned long long *hash
+)
+{
+  struct stat st;
+  FILE *fp;
+  char block[HASH_SAMPLE_SIZE];
+  unsigned long long h = 14695981039346656037ULL;
+  int i;
+
+  if (stat (ply_name, &st) != 0)
+    return (0);
+
+  fp = fopen (ply_name, "rb");
+  if (fp == NULL)
+    return (0);
+
+  *size = (long long) st.st_size;
+  *mtime = (long long) st.st_mtime;
+
+  for (i = 0; i < HASH_SAMPLES; i++) {
+    long long pos;
+    size_t n;
+
+    if (*size <= (long long) HASH_SAMPLE_SIZE * HASH_SAMPLES)
+      pos = (long long) i * HASH_SAMPLE_SIZE;
+    else
+      pos = (*size - HASH_SAMPLE_SIZE) / (HASH_SAMPLES - 1) * i;
+    if (pos >= *size)
+      break;
+
+    fseek (fp, (long) pos, SEEK_SET);
+    n = fread (block, 1, HASH_SAMPLE_SIZE, fp);
+
+    /* FNV-1a */
+    for (size_t j = 0; j < n; j++) {
+      h ^= (unsigned char) block[j];
+      h *= 1099511628211ULL;
+    }
+  }
+
+  fclose (fp);
+  *hash = h;
+  return (1);
+}
+
+
+/******************************************************************************
+Size in bytes of one section of a cache file.
+******************************************************************************/
+
+static size_t section_size(MeshCacheHeader *header, int section)
+{
+  size_t nverts = header->nverts;
+  size_t ntris = header->ntris;
+  size_t nedges = header->nedges;
+
+  switch (section) {
+    case CACHE_VERT_X:
+    case CACHE_VERT_Y:
+    case CACHE_VERT_Z:
+      return (sizeof (double) * nverts);
+    case CACHE_TRI_VERTS:
+    case CACHE_TRI_EDGES:
+    case CACHE_VERT_TRIS:
+    case CACHE_CORNER_OPPOSITE:
+    case CACHE_CORNER_ORDER:
+      return (sizeof (int) * 3 * ntris);
+    case CACHE_EDGE_VERTS:
+      return (sizeof (int) * 2 * nedges);
+    case CACHE_EDGE_TRI_START:
+      return (sizeof (int) * (nedges + 1));
+    case CACHE_EDGE_TRIS:
+      return (sizeof (int) * (size_t) header->nedge_tris);
+    case CACHE_VERT_TRI_START:
+      return (sizeof (int) * (nverts + 1));
+    case CACHE_VERT_OTHER:
+      return ((size_t) header->vert_other_size * nverts);
+    case CACHE_FACE_OTHER:
+      return ((size_t) header->face_other_size * ntris);
+  }
+
+  return (0);
+}
+
+
+/******************************************************************************
+Check that every entry of an index array lies in [0, limit), or is -1 when
+"allow_none" is set.
+******************************************************************************/
+
+static int indices_in_range(int *list, size_t count, int limit, int allow_none)
+{
+  for (size_t i = 0; i < count; i++)
+    if ((list[i] < 0 || list[i] >= limit) && !(allow_none && list[i] == -1))
+      return (0);
+  return (1);
+}
+
+
+/******************************************************************************
+Check that an array of start positions rises from 0 to "total".
+******************************************************************************/
+
+static int starts_in_order(int *start, int count, int total)
+{
+  if (start[0] != 0 || start[count] != total)
+    return (0);
+  for (int i = 0; i < count; i++)
+    if (start[i] > start[i+1])
+      return (0);
+  return (1);
+}
+
+
+/******************************************************************************
+Release the memory-mapped view of a cache file.
+******************************************************************************/
+
+static void unmap_cache(MeshCache *cache)
+{
+  if (cache->map_base == NULL)
+    return;
+
+#ifdef _WIN32
+  UnmapViewOfFile (cache->map_base);
+  CloseHandle ((HANDLE) cache->map_handle);
+#else
+  munmap (cache->map_base, cache->map_size);
+#endif
+
+  cache->map_base = NULL;
+}
+
+
+/******************************************************************************
+Map a cache file into memory.
+
+Entry:
+  fp - the open cache file
+
+Exit:
+  cache - map_base, map_size and map_handle are set
+  returns 1 if the file is mapped, 0 if not
+******************************************************************************/
+
+static int map_cache(FILE *fp, MeshCache *cache)
+{
+#ifdef _WIN32
+  HANDLE file = (HANDLE) _get_osfhandle (_fileno (fp));
+  HANDLE mapping;
+  LARGE_INTEGER file_size;
+
+  if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx (file, &file_size))
+    return (0);
+  if (file_size.QuadPart < (LONGLONG) sizeof (MeshCacheHeader) ||
+      (unsigned long long) file_size.QuadPart > (size_t) -1)
+    return (0);
+
+  mapping = CreateFileMapping (file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping == NULL)
+    return (0);
+
+  cache->map_base = (char *) MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0);
+  if (cache->map_base == NULL) {
+    CloseHandle (mapping);
+    return (0);
+  }
+
+  cache->map_size = (size_t) file_size.QuadPart;
+  cache->map_handle = (void *) mapping;
+#else
+  struct stat st;
+  int fd = fileno (fp);
+  char *base;
+
+  if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode) ||
+      st.st_size < (off_t) sizeof (MeshCacheHeader))
+    return (0);
+
+  base = (char *) mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (base == (char *) MAP_FAILED)
+    return (0);
+
+  cache->map_base = base;
+  cache->map_size = st.st_size;
+  cache->map_handle = NULL;
+#endif
+
+  return (1);
+}
+
+
+/******************************************************************************
+Map the cache file of a PLY file and find its sections.  The cache is only
+used if it was made from the PLY file as it is now, and if its sections are
+consistent with each other, so a stale or damaged cache is simply ignored.
+
+Entry:
+  ply_name - name of the PLY file
+
+Exit:
+  returns the cache, or NULL if it can't be used
+******************************************************************************/
+
+MeshCache *open_mesh_cache(char *ply_name)
+{
+  char *name;
+  FILE *fp;
+  MeshCache *cache;
+  MeshCacheHeader *header;
+  long long size, mtime;
+  unsigned long long hash;
+  int ok;
+  int i;
+
+  if (!source_fingerprint (ply_name, &size, &mtime, &hash))
+    return (NULL);
+
+  name = cache_name (ply_name);
+  fp = fopen (name, "rb");
+  delete[] name;
+  if (fp == NULL)
+    return (NULL);
+
+  cache = new MeshCache;
+  cache->map_base = NULL;
+  ok = map_cache (fp, cache);
+  fclose (fp);
+  if (!ok) {
+    delete cache;
+    return (NULL);
+  }
+
+  /* make sure the cache belongs to this version of the PLY file */
+
+  header = cache->header = (MeshCacheHeader *) cache->map_base;
+
+  ok = memcmp (header->magic, "PLYCACHE", 8) == 0 &&
+       header->version == MESH_CACHE_VERSION &&
+       header->byte_order == 1 &&
+       header->source_size == size &&
+       header->source_mtime == mtime &&
+       header->source_hash == hash &&
+       header->nverts > 0 && header->ntris > 0 &&
+       header->nedges > 0 && header->nedge_tris >= 0 &&
+       header->vert_other_size >= 0 && header->face_other_size >= 0;
+
+  for (i = 0; i < CACHE_NSECTIONS && ok; i++)
+    if (header->offset[i] < (long long) sizeof (MeshCacheHeader) ||
+        header->offset[i] % MESH_CACHE_ALIGN != 0 ||
+        (unsigned long long) header->offset[i] + section_size (header, i) > cache->map_size)
+      ok = 0;
+
+  if (!ok) {
+    close_mesh_cache (cache);
+    return (NULL);
+  }
+
+  cache->x = (double *) (cache->map_base + header->offset[CACHE_VERT_X]);
+  cache->y = (double *) (cache->map_base + header->offset[CACHE_VERT_Y]);
+  cache->z = (double *) (cache->map_base + header->offset[CACHE_VERT_Z]);
+  cache->tri_verts = (int *) (cache->map_base + header->offset[CACHE_TRI_VERTS]);
+  cache->tri_edges = (int *) (cache->map_base + header->offset[CACHE_TRI_EDGES]);
+  cache->edge_verts = (int *) (cache->map_base + header->offset[CACHE_EDGE_VERTS]);
+  cache->edge_tri_start = (int *) (cache->map_base + header->offset[CACHE_EDGE_TRI_START]);
+  cache->edge_tris = (int *) (cache->map_base + header->offset[CACHE_EDGE_TRIS]);
+  cache->vert_tri_start = (int *) (cache->map_base + header->offset[CACHE_VERT_TRI_START]);
+  cache->vert_tris = (int *) (cache->map_base + header->offset[CACHE_VERT_TRIS]);
+  cache->corner_opposite = (int *) (cache->map_base + header->offset[CACHE_CORNER_OPPOSITE]);
+  cache->corner_order = (int *) (cache->map_base + header->offset[CACHE_CORNER_ORDER]);
+  cache->vert_other = cache->map_base + header->offset[CACHE_VERT_OTHER];
+  cache->face_other = cache->map_base + header->offset[CACHE_FACE_OTHER];
+
+  /* every index has to point at something that exists */
+
+  size_t ncorners = 3 * (size_t) header->ntris;
+  ok = indices_in_range (cache->tri_verts, ncorners, header->nverts, 0) &&
+       indices_in_range (cache->tri_edges, ncorners, header->nedges, 0) &&
+       indices_in_range (cache->edge_verts, 2 * (size_t) header->nedges, header->nverts, 0) &&
+       starts_in_order (cache->edge_tri_start, header->nedges, header->nedge_tris) &&
+       indices_in_range (cache->edge_tris, header->nedge_tris, header->ntris, 0) &&
+       starts_in_order (cache->vert_tri_start, header->nverts, (int) ncorners) &&
+       indices_in_range (cache->vert_tris, ncorners, header->ntris, 0) &&
+       indices_in_range (cache->corner_opposite, ncorners, (int) ncorners, 1) &&
+       indices_in_range (cache->corner_order, ncorners, (int) ncorners, 0);
+
+  if (!ok) {
+    close_mesh_cache (cache);
+    return (NULL);
+  }
+
+  return (cache);
+}
+
+
+/******************************************************************************
+Release a cache opened by open_mesh_cache().
+******************************************************************************/
+
+void close_mesh_cache(MeshCache *cache)
+{
+  unmap_cache (cache);
+  delete cache;
+}
+
+
+/******************************************************************************
+Write out one section of a cache file, padded to the section alignment.
+******************************************************************************/
+
+static void write_section(FILE *fp, void *data, size_t size, long long *pos)
+{
+  static const char zeros[MESH_CACHE_ALIGN] = {0};
+
+  fwrite (data, 1, size, fp);
+  *pos += size;
+
+  size_t pad = (MESH_CACHE_ALIGN - *pos % MESH_CACHE_ALIGN) % MESH_CACHE_ALIGN;
+  fwrite (zeros, 1, pad, fp);
+  *pos += pad;
+}
+
+
+/******************************************************************************
+See if other_props hold lists or strings, whose pointers mean nothing once
+written out.
+
+Entry:
+  other - description of the other_props, or NULL
+
+Exit:
+  returns 1 if any of them is a list or a string, 0 if not
+******************************************************************************/
+
+static int has_other_lists(PlyOtherProp *other)
+{
+  int i;
+
+  if (other == NULL)
+    return (0);
+
+  for (i = 0; i < other->nprops; i++)
+    if (other->props[i]->is_list != PLY_SCALAR)
+      return (1);
+
+  return (0);
+}
+
+
+/******************************************************************************
+Write the cache file for a PLY file from a polyhedron that was read from it
+and then initialized.  The cache is written under a temporary name and then
+renamed, so a cache that is being written is never picked up by a reader.
+Models whose other_props have lists or strings are not cached.
+
+Entry:
+  poly     - initialized polyhedron
+  ply_name - name of the PLY file it was read from
+
+Exit:
+  returns 1 if the cache was written, 0 if not
+******************************************************************************/
+
+int write_mesh_cache(Polyhedron *poly, char *ply_name)
+{
+  MeshCacheHeader header;
+  char *name;
+  char *temp_name;
+  FILE *fp;
+  int i,j;
+  int nverts = poly->nverts;
+  int ntris = poly->ntris;
+  int nedges = poly->nedges;
+  size_t ncorners = 3 * (size_t) ntris;
+  long long pos;
+
+  if (nverts <= 0 || ntris <= 0 || nedges <= 0)
+    return (0);
+  if (has_other_lists (poly->vert_other) || has_other_lists (poly->face_other))
+    return (0);
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, "PLYCACHE", 8);
+  header.version = MESH_CACHE_VERSION;
+  header.byte_order = 1;
+  if (!source_fingerprint (ply_name, &header.source_size,
+                           &header.source_mtime, &header.source_hash))
+    return (0);
+  header.nverts = nverts;
+  header.ntris = ntris;
+  header.nedges = nedges;
+  header.nedge_tris = 0;
+  for (i = 0; i < nedges; i++)
+    header.nedge_tris += poly->elist[i]->ntris;
+  if (poly->vert_other != NULL)
+    header.vert_other_size = poly->vert_other->size;
+  if (poly->face_other != NULL)
+    header.face_other_size = poly->face_other->size;
+
+  /* lay out the sections */
+
+  pos = sizeof (MeshCacheHeader);
+  for (i = 0; i < CACHE_NSECTIONS; i++) {
+    pos = (pos + MESH_CACHE_ALIGN - 1) / MESH_CACHE_ALIGN * MESH_CACHE_ALIGN;
+    header.offset[i] = pos;
+    pos += section_size (&header, i);
+  }
+
+  /* gather the sections */
+
+  std::vector<double> x (nverts), y (nverts), z (nverts);
+  std::vector<int> vert_tri_start (nverts + 1);
+  std::vector<int> vert_tris (ncorners);
+  std::vector<int> tri_verts (ncorners), tri_edges (ncorners);
+  std::vector<int> corner_opposite (ncorners, -1), corner_order (ncorners);
+  std::vector<int> edge_verts (2 * (size_t) nedges);
+  std::vector<int> edge_tri_start (nedges + 1);
+  std::vector<int> edge_tris (header.nedge_tris > 0 ? header.nedge_tris : 1);
+  std::vector<char> vert_other (section_size (&header, CACHE_VERT_OTHER) + 1);
+  std::vector<char> face_other (section_size (&header, CACHE_FACE_OTHER) + 1);
+
+  vert_tri_start[0] = 0;
+  for (i = 0; i < nverts; i++) {
+    Vertex *v = poly->vlist[i];
+    x[i] = poly->vdata.x[i];
+    y[i] = poly->vdata.y[i];
+    z[i] = poly->vdata.z[i];
+    if (header.vert_other_size > 0)
+      memcpy (&vert_other[(size_t) i * header.vert_other_size], v->other_props,
+              header.vert_other_size);
+    if (vert_tri_start[i] + v->ntris > (int) ncorners)
+      return (0);
+    for (j = 0; j < v->ntris; j++)
+      vert_tris[vert_tri_start[i] + j] = v->tris[j]->index;
+    vert_tri_start[i+1] = vert_tri_start[i] + v->ntris;
+  }
+  if (vert_tri_start[nverts] != (int) ncorners)
+    return (0);
+
+  for (i = 0; i < ntris; i++) {
+    Triangle *t = poly->tlist[i];
+    for (j = 0; j < 3; j++) {
+      tri_verts[3*i+j] = t->verts[j]->index;
+      tri_edges[3*i+j] = t->edges[j]->index;
+    }
+    if (header.face_other_size > 0)
+      memcpy (&face_other[(size_t) i * header.face_other_size], t->other_props,
+              header.face_other_size);
+  }
+
+  edge_tri_start[0] = 0;
+  for (i = 0; i < nedges; i++) {
+    Edge *e = poly->elist[i];
+    edge_verts[2*i] = e->verts[0]->index;
+    edge_verts[2*i+1] = e->verts[1]->index;
+    for (j = 0; j < e->ntris; j++)
+      edge_tris[edge_tri_start[i] + j] = e->tris[j]->index;
+    edge_tri_start[i+1] = edge_tri_start[i] + e->ntris;
+  }
+
+  if (poly->clist.size () != ncorners)
+    return (0);
+  for (size_t k = 0; k < ncorners; k++) {
+    Corner *c = poly->clist[k];
+    int id = 3 * c->t->index + c->t_index;
+    corner_order[k] = id;
+    if (c->o != NULL)
+      corner_opposite[id] = 3 * c->o->t->index + c->o->t_index;
+  }
+
+  /* write them out */
+
+  name = cache_name (ply_name);
+  temp_name = new char[strlen (name) + 8];
+  sprintf (temp_name, "%s.tmp", name);
+
+  fp = fopen (temp_name, "wb");
+  if (fp == NULL) {
+    delete[] name;
+    delete[] temp_name;
+    return (0);
+  }
+
+  pos = 0;
+  write_section (fp, &header, sizeof (header), &pos);
+  write_section (fp, &x[0], section_size (&header, CACHE_VERT_X), &pos);
+  write_section (fp, &y[0], section_size (&header, CACHE_VERT_Y), &pos);
+  write_section (fp, &z[0], section_size (&header, CACHE_VERT_Z), &pos);
+  write_section (fp, &tri_verts[0], section_size (&header, CACHE_TRI_VERTS), &pos);
+  write_section (fp, &tri_edges[0], section_size (&header, CACHE_TRI_EDGES), &pos);
+  write_section (fp, &edge_verts[0], section_size (&header, CACHE_EDGE_VERTS), &pos);
+  write_section (fp, &edge_tri_start[0], section_size (&header, CACHE_EDGE_TRI_START), &pos);
+  write_section (fp, &edge_tris[0], section_size (&header, CACHE_EDGE_TRIS), &pos);
+  write_section (fp, &vert_tri_start[0], section_size (&header, CACHE_VERT_TRI_START), &pos);
+  write_section (fp, &vert_tris[0], section_size (&header, CACHE_VERT_TRIS), &pos);
+  write_section (fp, &corner_opposite[0], section_size (&header, CACHE_CORNER_OPPOSITE), &pos);
+  write_section (fp, &corner_order[0], section_size (&header, CACHE_CORNER_ORDER), &pos);
+  write_section (fp, &vert_other[0], section_size (&header, CACHE_VERT_OTHER), &pos);
+  write_section (fp, &face_other[0], section_size (&header, CACHE_FACE_OTHER), &pos);
+
+  int ok = !ferror (fp);
+  if (fclose (fp) != 0)
+    ok = 0;
+
+  if (ok) {
+    remove (name);
+    ok = (rename (temp_name, name) == 0);
+  }
+  if (!ok)
+    remove (temp_name);
+
+  delete[] name;
+  delete[] temp_name;
+  return (ok);
+}
+
+
+/******************************************************************************
+Read in a PLY file without initializing it, or return NULL (with the
+problem reported on stderr) if the file can't be used.  The file is closed.
+******************************************************************************/
+
+static Polyhedron *read_ply_polyhedron(FILE *fp)
+{
+  Polyhedron *poly = new Polyhedron (fp);
+
+  if (poly->read_failed) {
+    poly->finalize ();
+    delete poly;
+    return (NULL);
+  }
+  return (poly);
+}
+
+
+/******************************************************************************
+Read in a polyhedron without initializing it or using a cache: a PLY file,
+a compressed mesh (see compressed_mesh.h), or an OBJ or STL file (see
+mesh_formats.h).  When weld_distance() is set, nearby vertices are merged.
+
+Entry:
+  name - name of the file
+
+Exit:
+  returns the polyhedron, with only its vertex and triangle lists, or NULL
+  if the file can't be opened or read, which is reported on stderr
+******************************************************************************/
+
+Polyhedron *read_polyhedron(char *name)
+{
+  Polyhedron *poly;
+  FILE *fp;
+
+  fp = fopen (name, "rb");
+  if (fp == NULL) {
+    fprintf (stderr, "Can't open '%s'.\n", name);
+    return (NULL);
+  }
+
+  if (is_compressed_mesh (fp)) {
+    poly = read_compressed_mesh (fp);
+    fclose (fp);
+  }
+  else if (mesh_format (name) == MESH_FORMAT_OBJ) {
+    poly = read_obj_mesh (fp);
+    fclose (fp);
+  }
+  else if (mesh_format (name) == MESH_FORMAT_STL) {
+    poly = read_stl_mesh (fp);
+    fclose (fp);
+  }
+  else
+    poly = read_ply_polyhedron (fp);
+
+  if (poly == NULL) {
+    fprintf (stderr, "Can't read '%s'.\n", name);
+    return (NULL);
+  }
+
+  if (weld_distance () > 0) {
+    int merged = weld_vertices (poly, weld_distance ());
+    fprintf (stderr, "%s: merged %d vertices\n", name, merged);
+  }
+
+  return (poly);
+}
+
+
+/******************************************************************************
+Check the topology of a polyhedron that has just been read, and initialize
+it if there is nothing wrong with it (see mesh_check.h).
+
+Entry:
+  poly - polyhedron with only its vertex and triangle lists, or NULL if the
+         file couldn't be read
+  name - name of the file it was read from, for the report
+
+Exit:
+  returns the polyhedron, or NULL (with the polyhedron deleted and the
+  report printed) if the mesh has problems
+******************************************************************************/
+
+static Polyhedron *check_and_initialize(Polyhedron *poly, char *name)
+{
+  MeshReport report;
+
+  if (poly == NULL)
+    return (NULL);
+
+  if (!check_mesh (poly, &report)) {
+    print_mesh_report (stderr, name, &report);
+    poly->finalize ();
+    delete poly;
+    return (NULL);
+  }
+
+  poly->initialize ();
+  return (poly);
+}
+
+
+/******************************************************************************
+Read in a polyhedron and initialize it.  When the PLY file has an up-to-date
+cache, the mesh and its topology are taken from the cache; otherwise the
+PLY file is parsed, its topology is checked, the topology is built, and the
+cache is written for the next time.  A compressed mesh (see
+compressed_mesh.h), or an OBJ or STL file (see mesh_formats.h), is read,
+checked and initialized instead; these have no cache.  When weld_distance()
+is set, nearby vertices are merged before the topology is checked and
+built, and the cache is neither used nor written.
+
+Entry:
+  ply_name - name of the PLY, OBJ or STL file or compressed mesh
+
+Exit:
+  returns the polyhedron, or NULL if the file can't be opened or read or its
+  mesh has problems, which are reported on stderr
+******************************************************************************/
+
+Polyhedron *load_polyhedron(char *ply_name)
+{
+  Polyhedron *poly;
+  MeshCache *cache;
+  FILE *fp;
+
+  if (weld_distance () > 0 || mesh_format (ply_name) != MESH_FORMAT_PLY)
+    return (check_and_initialize (read_polyhedron (ply_name), ply_name));
+
+  fp = fopen (ply_name, "rb");
+  if (fp == NULL) {
+    fprintf (stderr, "Can't open '%s'.\n", ply_name);
+    return (NULL);
+  }
+
+  if (is_compressed_mesh (fp)) {
+    fclose (fp);
+    return (check_and_initialize (read_polyhedron (ply_name), ply_name));
+  }
+
+  cache = open_mesh_cache (ply_name);
+  if (cache != NULL) {
+    poly = new Polyhedron (fp, cache);
+    close_mesh_cache (cache);
+  }
+  else {
+    poly = read_ply_polyhedron (fp);
+    if (poly == NULL) {
+      fprintf (stderr, "Can't read '%s'.\n", ply_name);
+      return (NULL);
+    }
+    poly = check_and_initialize (poly, ply_name);
+    if (poly != NULL)
+      write_mesh_cache (poly, ply_name);
+  }
+  return (poly);
+}
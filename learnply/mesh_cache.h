@@ -0,0 +1,92 @@
+/*
+
+Cache files that hold a mesh together with its topology, so that a PLY
+file that has been read once can be loaded again without parsing it or
+rebuilding its edges, vertex rings and corners.
+
+The cache for "name.ply" is "name.plyc".  It starts with a MeshCacheHeader
+and is followed by flat sections, each aligned to MESH_CACHE_ALIGN bytes,
+that are used in place from a memory-mapped view of the file.
+
+*/
+
+#ifndef __MESH_CACHE_H__
+#define __MESH_CACHE_H__
+
+#include <stddef.h>
+
+class Polyhedron;
+
+#define MESH_CACHE_VERSION  2
+#define MESH_CACHE_ALIGN    64
+
+/* sections of a cache file, in the order they appear */
+enum {
+  CACHE_VERT_X,           /* double[nverts]: vertex positions, one array per axis */
+  CACHE_VERT_Y,
+  CACHE_VERT_Z,
+  CACHE_TRI_VERTS,        /* int[3*ntris]: vertices of each triangle */
+  CACHE_TRI_EDGES,        /* int[3*ntris]: edges of each triangle */
+  CACHE_EDGE_VERTS,       /* int[2*nedges]: vertices of each edge */
+  CACHE_EDGE_TRI_START,   /* int[nedges+1]: where each edge's triangles start in CACHE_EDGE_TRIS */
+  CACHE_EDGE_TRIS,        /* int[nedge_tris]: triangles of each edge */
+  CACHE_VERT_TRI_START,   /* int[nverts+1]: where each vertex's ring starts in CACHE_VERT_TRIS */
+  CACHE_VERT_TRIS,        /* int[3*ntris]: ordered triangles around each vertex */
+  CACHE_CORNER_OPPOSITE,  /* int[3*ntris]: opposite of corner 3*t+i, or -1 */
+  CACHE_CORNER_ORDER,     /* int[3*ntris]: corners in the order of Polyhedron::clist */
+  CACHE_VERT_OTHER,       /* other_props of each vertex, vert_other_size bytes apiece */
+  CACHE_FACE_OTHER,       /* other_props of each triangle, face_other_size bytes apiece */
+  CACHE_NSECTIONS
+};
+
+typedef struct MeshCacheHeader {
+  char magic[8];                 /* "PLYCACHE" */
+  int version;                   /* MESH_CACHE_VERSION */
+  int byte_order;                /* 1, as written by this machine */
+  long long source_size;         /* size of the PLY file the cache was made from */
+  long long source_mtime;        /* its modification time */
+  unsigned long long source_hash;  /* hash of a sample of its contents */
+  int nverts;
+  int ntris;
+  int nedges;
+  int nedge_tris;
+  int vert_other_size;           /* size of a vertex's other_props, or 0 */
+  int face_other_size;           /* size of a triangle's other_props, or 0 */
+  long long offset[CACHE_NSECTIONS];  /* where each section starts */
+} MeshCacheHeader;
+
+typedef struct MeshCache {
+  MeshCacheHeader *header;
+  double *x, *y, *z;
+  int *tri_verts;
+  int *tri_edges;
+  int *edge_verts;
+  int *edge_tri_start;
+  int *edge_tris;
+  int *vert_tri_start;
+  int *vert_tris;
+  int *corner_opposite;
+  int *corner_order;
+  char *vert_other;
+  char *face_other;
+  char *map_base;                /* memory-mapped view of the cache file */
+  size_t map_size;
+  void *map_handle;
+} MeshCache;
+
+/* map the cache of a PLY file, or return NULL if there is none or it is out of date */
+MeshCache *open_mesh_cache(char *ply_name);
+void close_mesh_cache(MeshCache *);
+
+/* write the cache of a PLY file from an initialized polyhedron read from it */
+int write_mesh_cache(Polyhedron *, char *ply_name);
+
+/* read a polyhedron from any kind of mesh file without initializing it, welding it if asked,
+   or return NULL if the file can't be opened or read */
+Polyhedron *read_polyhedron(char *name);
+
+/* read an initialized polyhedron from a PLY file, through its cache when possible,
+   or return NULL if the file can't be read or its mesh fails check_mesh() */
+Polyhedron *load_polyhedron(char *ply_name);
+
+#endif /* __MESH_CACHE_H__ */
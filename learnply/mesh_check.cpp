@@ -0,0 +1,373 @@
+/*
+
+Checking the topology of a mesh before it is initialized.
+
+*/
+
+#include <stdio.h>
+#include <vector>
+
+#include "learnply.h"
+#include "corner_table.h"
+#include "mesh_check.h"
+#include "parallel.h"
+
+
+/* fewest corners worth handing to a thread of their own */
+#define MIN_CHECK_BLOCK  65536
+
+/* most elements of each kind that print_mesh_report() names */
+#define REPORT_EXAMPLES  5
+
+
+/* what one thread finds in the runs of corners that share an edge */
+typedef struct EdgeTally {
+  int nedges;
+  std::vector<int> boundary;      /* the corner of each boundary edge */
+  std::vector<int> nonmanifold;
+  std::vector<int> flipped;
+} EdgeTally;
+
+
+/******************************************************************************
+Count the corners in the fan of a vertex that a corner is in.  The walk
+goes from corner to corner across the edges that are on exactly two
+triangles, leaving each corner by the side it did not come in by, so the
+orientation of the triangles does not matter.  It starts out toward the
+far side of the corner if the near side is on a boundary.
+
+Entry:
+  V, O  - vertices and opposites of the corners
+  start - corner to start from
+  limit - number of corners the vertex has
+
+Exit:
+  returns the number of corners in the fan, or more than limit if the walk
+  goes on past it
+******************************************************************************/
+
+static int fan_size(const std::vector<int> &V, const std::vector<int> &O,
+                    int start, int limit)
+{
+  int v = V[start];
+  int c = start;
+  int count = 1;
+
+  /* which side to leave by: the one toward prev(c), unless that is all
+     that is left */
+  int leave_prev = (O[CornerTable::prev (c)] == -1 || O[CornerTable::next (c)] != -1);
+
+  while (count <= limit) {
+    int facing = leave_prev ? CornerTable::next (c) : CornerTable::prev (c);
+    int w = leave_prev ? V[CornerTable::prev (c)] : V[CornerTable::next (c)];
+    int o = O[facing];
+    if (o == -1)
+      break;
+
+    /* the other triangle's corner at v, and the side it was come into by */
+    int d = (V[CornerTable::next (o)] == v) ? CornerTable::next (o) : CornerTable::prev (o);
+    if (d == start)
+      break;
+    leave_prev = (V[CornerTable::next (d)] == w);
+    c = d;
+    count++;
+  }
+
+  return (count);
+}
+
+
+/******************************************************************************
+Find the boundary edge that follows one around a loop of the boundary.  The
+walk turns about the vertex it goes on from, crossing the edges that are on
+exactly two triangles, until it comes to another edge on one triangle; as
+in fan_size(), the orientation of the triangles does not matter.
+
+Entry:
+  V, O        - vertices and opposites of the corners
+  on_boundary - which corners face boundary edges
+  e           - corner facing a boundary edge
+  w           - end of that edge that the walk goes on from
+
+Exit:
+  w       - the far end of the next boundary edge
+  returns the corner facing the next boundary edge, or -1 if the walk comes
+  to an edge on more than two triangles instead
+******************************************************************************/
+
+static int next_boundary(const std::vector<int> &V, const std::vector<int> &O,
+                         const std::vector<char> &on_boundary, int e, int *w)
+{
+  int n = (int) V.size ();
+
+  /* the corners at w, at the end come from, and at the third vertex */
+  int cw = (V[CornerTable::next (e)] == *w) ? CornerTable::next (e) : CornerTable::prev (e);
+  int cx = (cw == CornerTable::next (e)) ? CornerTable::prev (e) : CornerTable::next (e);
+  int cy = e;
+
+  for (int steps = 0; steps < n; steps++) {
+
+    /* cx faces the edge from w to the third vertex */
+    int o = O[cx];
+    if (o == -1) {
+      if (!on_boundary[cx])
+        return (-1);
+      *w = V[cy];
+      return (cx);
+    }
+
+    /* cross it, coming into the other triangle from the third vertex */
+    int y = V[cy];
+    int t = o - o % 3;
+    for (int c = t; c < t + 3; c++)
+      if (V[c] == *w)
+        cw = c;
+      else if (V[c] == y)
+        cx = c;
+    cy = o;
+  }
+
+  return (-1);
+}
+
+
+/******************************************************************************
+Check the topology of a polyhedron from its vertex and triangle lists.
+
+The corners of the proper triangles are sorted by the edge each one faces,
+as for a corner table (see corner_table.h), on several threads.  Each run
+of corners on one edge tells whether the edge is on the boundary, on two
+triangles that agree or disagree on its direction, or on more than two,
+and whether a triangle repeats an earlier one.  The pairs of corners
+across edges on exactly two triangles then let the fan around every vertex
+be walked in time proportional to its valence, and a vertex whose walk
+misses some of its corners joins several fans.  Each loop of boundary
+edges is followed from edge to edge around the fans of its vertices.
+
+Entry:
+  poly - polyhedron whose vertex and triangle lists are filled in
+
+Exit:
+  report - what was found
+  returns 1 if the mesh has no problems, 0 if it has some
+******************************************************************************/
+
+int check_mesh(Polyhedron *poly, MeshReport *report)
+{
+  int i;
+  int nverts = poly->nverts;
+  int ntris = poly->ntris;
+  int n = 3 * ntris;
+  int nthreads = parallel_thread_count (n / MIN_CHECK_BLOCK);
+
+  report->nverts = nverts;
+  report->ntris = ntris;
+  report->nonmanifold_edges.clear ();
+  report->flipped_edges.clear ();
+  report->nonmanifold_verts.clear ();
+  report->isolated_verts.clear ();
+  report->degenerate_faces.clear ();
+  report->duplicate_faces.clear ();
+
+  /* vertices of the corners, and the key of the edge each one faces; the
+     corners of degenerate triangles get a key above any edge's */
+
+  int bits = edge_key_bits (nverts);
+  unsigned long long no_edge = (1ULL << (2 * bits)) - 1;
+  std::vector<int> V (n);
+  std::vector<unsigned long long> keys (n);
+  std::vector<char> proper (ntris);
+
+  parallel_for (nthreads, [&](int t) {
+    int first = (int) ((size_t) ntris * t / nthreads);
+    int last = (int) ((size_t) ntris * (t + 1) / nthreads);
+    for (int k = first; k < last; k++) {
+      Triangle *tri = poly->tlist[k];
+      V[3*k] = tri->verts[0]->index;
+      V[3*k+1] = tri->verts[1]->index;
+      V[3*k+2] = tri->verts[2]->index;
+      proper[k] = (V[3*k] != V[3*k+1] && V[3*k+1] != V[3*k+2] && V[3*k+2] != V[3*k]);
+      for (int c = 3*k; c < 3*k+3; c++)
+        keys[c] = proper[k] ? edge_key (V[CornerTable::next (c)], V[CornerTable::prev (c)], bits)
+                            : no_edge;
+    }
+  });
+
+  std::vector<int> order;
+  sort_edge_keys (keys, 2 * bits, order);
+
+  /* go through the runs of corners on each edge, each thread taking the
+     runs that start in its piece of the sorted corners */
+
+  std::vector<int> O (n, -1);
+  std::vector<char> duplicate (ntris, 0);
+  std::vector<EdgeTally> tallies (nthreads);
+
+  parallel_for (nthreads, [&](int t) {
+    int first = (int) ((size_t) n * t / nthreads);
+    int last = (int) ((size_t) n * (t + 1) / nthreads);
+    EdgeTally *tally = &tallies[t];
+    tally->nedges = 0;
+
+    for (int k = first; k < last; k++) {
+      if ((k > 0 && keys[k-1] == keys[k]) || keys[k] == no_edge)
+        continue;
+      int end = k + 1;
+      while (end < n && keys[end] == keys[k])
+        end++;
+
+      int a = order[k];
+      int ends[2] = {V[CornerTable::next (a)], V[CornerTable::prev (a)]};
+      tally->nedges++;
+
+      if (end - k == 1)
+        tally->boundary.push_back (a);
+      else if (end - k == 2) {
+        int b = order[k+1];
+        O[a] = b;
+        O[b] = a;
+        if (V[CornerTable::next (a)] == V[CornerTable::next (b)]) {
+          tally->flipped.push_back (ends[0]);
+          tally->flipped.push_back (ends[1]);
+        }
+      }
+      else {
+        tally->nonmanifold.push_back (ends[0]);
+        tally->nonmanifold.push_back (ends[1]);
+      }
+
+      /* a triangle repeats an earlier one if the corners across one of its
+         edges match; each triangle looks only across the edge its first
+         corner faces */
+      for (int j = k; j < end; j++) {
+        int c = order[j];
+        if (c % 3 != 0)
+          continue;
+        for (int m = k; m < end; m++)
+          if (order[m] / 3 < c / 3 && V[order[m]] == V[c])
+            duplicate[c / 3] = 1;
+      }
+    }
+  });
+
+  report->nedges = 0;
+  std::vector<int> boundary;
+  for (int t = 0; t < nthreads; t++) {
+    EdgeTally *tally = &tallies[t];
+    report->nedges += tally->nedges;
+    boundary.insert (boundary.end (), tally->boundary.begin (), tally->boundary.end ());
+    report->nonmanifold_edges.insert (report->nonmanifold_edges.end (),
+                                      tally->nonmanifold.begin (), tally->nonmanifold.end ());
+    report->flipped_edges.insert (report->flipped_edges.end (),
+                                  tally->flipped.begin (), tally->flipped.end ());
+  }
+  report->boundary_edges = (int) boundary.size ();
+
+  for (i = 0; i < ntris; i++) {
+    if (!proper[i])
+      report->degenerate_faces.push_back (i);
+    else if (duplicate[i])
+      report->duplicate_faces.push_back (i);
+  }
+
+  /* count the corners of each vertex, and pick one to walk its fan from,
+     on a boundary if it has one */
+
+  std::vector<int> count (nverts, 0);
+  std::vector<int> start (nverts, -1);
+  std::vector<char> start_open (nverts, 0);
+
+  for (int c = 0; c < n; c++) {
+    if (!proper[c / 3])
+      continue;
+    int v = V[c];
+    int open = (O[CornerTable::prev (c)] == -1 || O[CornerTable::next (c)] == -1);
+    count[v]++;
+    if (start[v] == -1 || (open && !start_open[v])) {
+      start[v] = c;
+      start_open[v] = open;
+    }
+  }
+
+  std::vector<char> several_fans (nverts, 0);
+  int vthreads = parallel_thread_count (nverts / MIN_CHECK_BLOCK);
+
+  parallel_for (vthreads, [&](int t) {
+    int first = (int) ((size_t) nverts * t / vthreads);
+    int last = (int) ((size_t) nverts * (t + 1) / vthreads);
+    for (int v = first; v < last; v++)
+      if (count[v] > 0 && fan_size (V, O, start[v], count[v]) != count[v])
+        several_fans[v] = 1;
+  });
+
+  for (i = 0; i < nverts; i++) {
+    if (count[i] == 0)
+      report->isolated_verts.push_back (i);
+    else if (several_fans[i])
+      report->nonmanifold_verts.push_back (i);
+  }
+
+  /* follow each loop of boundary edges around from one of its edges */
+
+  std::vector<char> on_boundary (n, 0);
+  std::vector<char> walked (n, 0);
+  for (size_t k = 0; k < boundary.size (); k++)
+    on_boundary[boundary[k]] = 1;
+
+  report->boundary_loops = 0;
+  for (size_t k = 0; k < boundary.size (); k++) {
+    int e = boundary[k];
+    if (walked[e])
+      continue;
+    report->boundary_loops++;
+
+    /* a loop broken by a non-manifold edge is walked both ways from here */
+    for (int side = 0; side < 2; side++) {
+      int c = boundary[k];
+      int w = V[side ? CornerTable::next (c) : CornerTable::prev (c)];
+      walked[c] = 0;
+      while (c != -1 && !walked[c]) {
+        walked[c] = 1;
+        c = next_boundary (V, O, on_boundary, c, &w);
+      }
+      if (c != -1)
+        break;
+    }
+  }
+
+  return (report->nonmanifold_edges.empty () && report->flipped_edges.empty () &&
+          report->nonmanifold_verts.empty () && report->isolated_verts.empty () &&
+          report->degenerate_faces.empty () && report->duplicate_faces.empty ());
+}
+
+
+/* print a count, and the first few of the elements it counts */
+static void print_examples(FILE *fp, char *what, std::vector<int> &list, int per_item)
+{
+  int nitems = (int) list.size () / per_item;
+
+  fprintf (fp, "  %s: %d", what, nitems);
+  for (int i = 0; i < nitems && i < REPORT_EXAMPLES; i++) {
+    fprintf (fp, (i == 0) ? " (" : ", ");
+    for (int j = 0; j < per_item; j++)
+      fprintf (fp, (j == 0) ? "%d" : "-%d", list[i * per_item + j]);
+  }
+  if (nitems > 0)
+    fprintf (fp, (nitems > REPORT_EXAMPLES) ? ", ...)" : ")");
+  fprintf (fp, "\n");
+}
+
+
+void print_mesh_report(FILE *fp, char *name, MeshReport *report)
+{
+  fprintf (fp, "%s: %d vertices, %d triangles, %d edges\n", name,
+           report->nverts, report->ntris, report->nedges);
+  fprintf (fp, "  boundary edges: %d in %d loops\n", report->boundary_edges,
+           report->boundary_loops);
+  print_examples (fp, "non-manifold edges", report->nonmanifold_edges, 2);
+  print_examples (fp, "edges with flipped triangles", report->flipped_edges, 2);
+  print_examples (fp, "non-manifold vertices", report->nonmanifold_verts, 1);
+  print_examples (fp, "isolated vertices", report->isolated_verts, 1);
+  print_examples (fp, "degenerate triangles", report->degenerate_faces, 1);
+  print_examples (fp, "duplicate triangles", report->duplicate_faces, 1);
+}
@@ -0,0 +1,47 @@
+/*
+
+Checking the topology of a mesh before it is initialized.
+
+The topology is built on the assumption that every edge is on one or two
+triangles that agree on its direction, and a mesh that breaks it can stop
+the program or crash it well into a run.  check_mesh() finds the ways a
+mesh falls short from its vertex and triangle lists alone, in linear time,
+so that a bad mesh can be turned away before anything is built.
+
+*/
+
+#ifndef __MESH_CHECK_H__
+#define __MESH_CHECK_H__
+
+#include <stdio.h>
+#include <vector>
+
+class Polyhedron;
+
+/* what check_mesh() finds; edges are given by the indices of their two ends */
+typedef struct MeshReport {
+  int nverts;
+  int ntris;
+  int nedges;                           /* distinct edges of proper triangles */
+  int boundary_edges;                   /* edges on one triangle */
+  int boundary_loops;                   /* loops the boundary edges make */
+  std::vector<int> nonmanifold_edges;   /* edges on more than two triangles, two ends each */
+  std::vector<int> flipped_edges;       /* edges whose two triangles go along them the same way */
+  std::vector<int> nonmanifold_verts;   /* vertices whose triangles form more than one fan */
+  std::vector<int> isolated_verts;      /* vertices on no proper triangle */
+  std::vector<int> degenerate_faces;    /* triangles with a repeated vertex */
+  std::vector<int> duplicate_faces;     /* triangles on the same vertices as an earlier one */
+} MeshReport;
+
+/*
+Check the topology of a polyhedron whose vertex and triangle lists are
+filled in, initialized or not.  Returns 1 if the mesh is a consistently
+oriented manifold, with or without boundary, with no degenerate, duplicate
+or isolated elements, and 0 if not.
+*/
+int check_mesh(Polyhedron *, MeshReport *);
+
+/* print a report, naming up to a few of the elements of each kind of problem */
+void print_mesh_report(FILE *, char *name, MeshReport *);
+
+#endif /* __MESH_CHECK_H__ */
@@ -0,0 +1,597 @@
+/*
+
+Reading and writing meshes as Wavefront OBJ and STL files.
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <charconv>
+#include <vector>
+
+#include "learnply.h"
+#include "mesh_formats.h"
+
+
+/* room for an OBJ vertex line: "v", three spaced doubles of up to 24
+   characters each, and the newline */
+#define OBJ_VERTEX_LINE  80
+
+/* number of triangles put in the buffer before a binary STL write */
+#define STL_WRITE_BATCH  4096
+
+/* sizes of the parts of a binary STL file */
+#define STL_HEADER_SIZE    80
+#define STL_TRIANGLE_SIZE  50
+
+/* rough bytes of text per vertex of an OBJ file (a "v" line and the two
+   "f" lines of a closed mesh) and per triangle of an ASCII STL file, on
+   the short side so that guesses from them run large */
+#define OBJ_BYTES_PER_VERTEX   64
+#define STL_BYTES_PER_TRIANGLE 200
+
+
+/******************************************************************************
+Return the format of a mesh file, going by the extension of its name.
+******************************************************************************/
+
+int mesh_format(char *name)
+{
+  char *dot = strrchr (name, '.');
+  char ext[4];
+  int i;
+
+  if (dot == NULL || strlen (dot) != 4)
+    return (MESH_FORMAT_PLY);
+
+  for (i = 0; i < 4; i++)
+    ext[i] = (char) tolower ((unsigned char) dot[i + 1]);
+
+  if (strcmp (ext, "obj") == 0)
+    return (MESH_FORMAT_OBJ);
+  if (strcmp (ext, "stl") == 0)
+    return (MESH_FORMAT_STL);
+  return (MESH_FORMAT_PLY);
+}
+
+
+/******************************************************************************
+Read the rest of an open file into memory.
+
+Entry:
+  fp - the open file
+
+Exit:
+  size - number of bytes read
+  returns the contents, followed by a null byte, to be freed with delete[]
+******************************************************************************/
+
+static char *read_whole_file(FILE *fp, size_t *size)
+{
+  size_t len = 0;
+  size_t max_len = 1 << 20;
+  char *buffer = new char[max_len + 1];
+
+  for (;;) {
+    len += fread (buffer + len, 1, max_len - len, fp);
+    if (len < max_len)
+      break;
+    char *bigger = new char[2 * max_len + 1];
+    memcpy (bigger, buffer, len);
+    delete[] buffer;
+    buffer = bigger;
+    max_len *= 2;
+  }
+
+  buffer[len] = '\0';
+  *size = len;
+  return (buffer);
+}
+
+
+/******************************************************************************
+Make an uninitialized polyhedron from vertex positions and triangles given
+by vertex index.  Triangles with a repeated vertex are left out.
+
+Entry:
+  pos  - x,y,z of each vertex
+  tris - three vertex indices for each triangle, all of them in range
+******************************************************************************/
+
+static Polyhedron *build_mesh(std::vector<double> &pos, std::vector<int> &tris)
+{
+  int i,j;
+  int nverts = (int) (pos.size () / 3);
+  int ntris = (int) (tris.size () / 3);
+  Polyhedron *poly = new Polyhedron;
+
+  delete[] poly->vlist;
+  delete[] poly->tlist;
+
+  poly->nverts = poly->max_verts = nverts;
+  poly->vlist = new Vertex *[nverts];
+  poly->vert_pool.reserve (nverts);
+
+  for (i = 0; i < nverts; i++) {
+    Vertex *v = poly->make_vertex (pos[3*i], pos[3*i+1], pos[3*i+2]);
+    v->other_props = NULL;
+    poly->vlist[i] = v;
+  }
+
+  poly->max_tris = ntris;
+  poly->tlist = new Triangle *[ntris];
+  poly->tri_pool.reserve (ntris);
+  poly->ntris = 0;
+
+  for (i = 0; i < ntris; i++) {
+    int *index = &tris[3*i];
+    if (index[0] == index[1] || index[1] == index[2] || index[2] == index[0])
+      continue;
+    Triangle *t = poly->tri_pool.make ();
+    t->nverts = 3;
+    t->other_props = NULL;
+    for (j = 0; j < 3; j++)
+      t->verts[j] = poly->vlist[index[j]];
+    poly->tlist[poly->ntris++] = t;
+  }
+
+  return (poly);
+}
+
+
+/******************************************************************************
+Skip to the start of the next line of a text buffer.
+******************************************************************************/
+
+static char *next_line(char *ptr, char *end)
+{
+  char *newline = (char *) memchr (ptr, '\n', end - ptr);
+  return (newline != NULL ? newline + 1 : end);
+}
+
+static char *skip_blanks(char *ptr, char *end)
+{
+  while (ptr < end && (*ptr == ' ' || *ptr == '\t'))
+    ptr++;
+  return (ptr);
+}
+
+
+/******************************************************************************
+Read an OBJ file into a new polyhedron.  The file is read into one buffer,
+and numbers are converted where they lie without being copied out as words.
+Only "v" and "f" lines are used; a face's vertex may be written as v, v/vt,
+v//vn or v/vt/vn, and negative indices count back from the latest vertex.
+
+Entry:
+  fp - the open file
+
+Exit:
+  returns the polyhedron, which still has to be initialized, or NULL (with
+  the problem reported on stderr) if the file is malformed
+******************************************************************************/
+
+Polyhedron *read_obj_mesh(FILE *fp)
+{
+  size_t size;
+  char *buffer = read_whole_file (fp, &size);
+  char *ptr = buffer;
+  char *end = buffer + size;
+  int line = 0;
+  int i;
+
+  std::vector<double> pos;
+  std::vector<int> tris;
+  std::vector<int> face;
+
+  while (ptr < end) {
+    line++;
+    ptr = skip_blanks (ptr, end);
+
+    if (end - ptr > 1 && ptr[0] == 'v' && (ptr[1] == ' ' || ptr[1] == '\t')) {
+      ptr += 2;
+      for (i = 0; i < 3; i++) {
+        ptr = skip_blanks (ptr, end);
+        char *start = ptr;
+        pos.push_back (ascii_to_double (&ptr, end));
+        if (ptr == start) {
+          fprintf (stderr, "OBJ line %d: vertex needs three coordinates\n", line);
+          delete[] buffer;
+          return (NULL);
+        }
+      }
+    }
+    else if (end - ptr > 1 && ptr[0] == 'f' && (ptr[1] == ' ' || ptr[1] == '\t')) {
+      int nverts = (int) (pos.size () / 3);
+      ptr += 2;
+      face.clear ();
+
+      for (;;) {
+        ptr = skip_blanks (ptr, end);
+        if (ptr == end || *ptr == '\n' || *ptr == '\r' || *ptr == '#')
+          break;
+
+        char *start = ptr;
+        long long number = ascii_to_integer (&ptr, end);
+        long long index = (number > 0) ? number - 1 : nverts + number;
+        if (ptr == start || number == 0 || index < 0 || index >= nverts) {
+          fprintf (stderr, "OBJ line %d: bad vertex index\n", line);
+          delete[] buffer;
+          return (NULL);
+        }
+        face.push_back ((int) index);
+
+        /* skip the texture and normal indices */
+        while (ptr < end && *ptr != ' ' && *ptr != '\t' && *ptr != '\n' && *ptr != '\r')
+          ptr++;
+      }
+
+      if (face.size () < 3) {
+        fprintf (stderr, "OBJ line %d: face needs at least three vertices\n", line);
+        delete[] buffer;
+        return (NULL);
+      }
+
+      /* split a polygon into a fan of triangles around its first vertex */
+      for (i = 2; i < (int) face.size (); i++) {
+        tris.push_back (face[0]);
+        tris.push_back (face[i-1]);
+        tris.push_back (face[i]);
+      }
+    }
+
+    ptr = next_line (ptr, end);
+  }
+
+  delete[] buffer;
+  return (build_mesh (pos, tris));
+}
+
+
+/******************************************************************************
+Hash table that welds the corners of an STL file into shared vertices.
+Corners are matched by the exact bits of their coordinates, with -0 taken
+to be 0.  Slots hold vertex numbers, or -1 when empty, and the table doubles
+when it becomes half full.
+******************************************************************************/
+
+typedef struct WeldTable {
+  std::vector<int> slots;
+  std::vector<float> pos;     /* x,y,z of each welded vertex */
+} WeldTable;
+
+static unsigned int weld_hash(const float *p)
+{
+  unsigned int bits[3];
+  unsigned int hash = 2166136261u;
+  int i;
+
+  memcpy (bits, p, sizeof (bits));
+  for (i = 0; i < 3; i++)
+    hash = (hash ^ bits[i]) * 16777619u;
+  return (hash ^ (hash >> 15));
+}
+
+static void grow_weld_table(WeldTable *table)
+{
+  int nverts = (int) (table->pos.size () / 3);
+  size_t nslots = table->slots.empty () ? 1024 : 2 * table->slots.size ();
+  size_t mask = nslots - 1;
+  int i;
+
+  table->slots.assign (nslots, -1);
+  for (i = 0; i < nverts; i++) {
+    size_t slot = weld_hash (&table->pos[3*i]) & mask;
+    while (table->slots[slot] != -1)
+      slot = (slot + 1) & mask;
+    table->slots[slot] = i;
+  }
+}
+
+static int weld_vertex(WeldTable *table, float x, float y, float z)
+{
+  float p[3] = {x + 0.0f, y + 0.0f, z + 0.0f};   /* turns -0 into 0 */
+  int nverts = (int) (table->pos.size () / 3);
+
+  if (2 * (size_t) (nverts + 1) > table->slots.size ())
+    grow_weld_table (table);
+
+  size_t mask = table->slots.size () - 1;
+  size_t slot = weld_hash (p) & mask;
+
+  while (table->slots[slot] != -1) {
+    float *q = &table->pos[3 * table->slots[slot]];
+    if (memcmp (p, q, sizeof (p)) == 0)
+      return (table->slots[slot]);
+    slot = (slot + 1) & mask;
+  }
+
+  table->slots[slot] = nverts;
+  table->pos.insert (table->pos.end (), p, p + 3);
+  return (nverts);
+}
+
+
+/******************************************************************************
+Get little-endian values out of a binary STL file.
+******************************************************************************/
+
+static unsigned int get_le_uint32(unsigned char *ptr)
+{
+  return ((unsigned int) ptr[0] | ((unsigned int) ptr[1] << 8) |
+          ((unsigned int) ptr[2] << 16) | ((unsigned int) ptr[3] << 24));
+}
+
+static float get_le_float32(unsigned char *ptr)
+{
+  unsigned int bits = get_le_uint32 (ptr);
+  float value;
+
+  memcpy (&value, &bits, sizeof (value));
+  return (value);
+}
+
+
+/******************************************************************************
+Guess the size of the mesh in an OBJ or STL file without reading it.  A
+binary STL file gives its triangle count in its header; otherwise the
+counts are guessed from the length of the file.  A closed mesh has half as
+many vertices as triangles.
+
+Entry:
+  fp     - the open file, which is left at its start
+  format - MESH_FORMAT_OBJ or MESH_FORMAT_STL
+
+Exit:
+  nverts, ntris - the guessed counts
+******************************************************************************/
+
+void guess_mesh_counts(FILE *fp, int format, size_t *nverts, size_t *ntris)
+{
+  unsigned char header[STL_HEADER_SIZE + 4];
+
+  fseek (fp, 0, SEEK_END);
+  size_t size = (size_t) ftell (fp);
+  rewind (fp);
+
+  if (format == MESH_FORMAT_STL) {
+    size_t count = 0;
+    if (fread (header, 1, sizeof (header), fp) == sizeof (header))
+      count = get_le_uint32 (header + STL_HEADER_SIZE);
+    rewind (fp);
+
+    if (size == STL_HEADER_SIZE + 4 + count * STL_TRIANGLE_SIZE)
+      *ntris = count;
+    else
+      *ntris = size / STL_BYTES_PER_TRIANGLE;
+    *nverts = *ntris / 2;
+  }
+  else {
+    *nverts = size / OBJ_BYTES_PER_VERTEX;
+    *ntris = 2 * *nverts;
+  }
+}
+
+
+/******************************************************************************
+Read a binary or ASCII STL file into a new polyhedron, welding the corners
+of its triangles into shared vertices.  A file is taken to be binary when
+its size agrees with the triangle count in its header, since ASCII files
+begin with "solid" but so do some binary ones.
+
+Entry:
+  fp - the open file
+
+Exit:
+  returns the polyhedron, which still has to be initialized, or NULL (with
+  the problem reported on stderr) if the file is malformed
+******************************************************************************/
+
+Polyhedron *read_stl_mesh(FILE *fp)
+{
+  size_t size;
+  char *buffer = read_whole_file (fp, &size);
+  unsigned char *bytes = (unsigned char *) buffer;
+  WeldTable table;
+  std::vector<int> tris;
+  int i,j;
+
+  size_t count = (size >= STL_HEADER_SIZE + 4) ? get_le_uint32 (bytes + STL_HEADER_SIZE) : 0;
+
+  if (size >= STL_HEADER_SIZE + 4 &&
+      size == STL_HEADER_SIZE + 4 + count * STL_TRIANGLE_SIZE) {
+
+    /* binary: a normal, three corners and an attribute count per triangle */
+    tris.reserve (3 * count);
+    for (i = 0; i < (int) count; i++) {
+      unsigned char *tri = bytes + STL_HEADER_SIZE + 4 + (size_t) i * STL_TRIANGLE_SIZE;
+      for (j = 0; j < 3; j++) {
+        unsigned char *corner = tri + 12 * (j + 1);
+        tris.push_back (weld_vertex (&table, get_le_float32 (corner),
+                                     get_le_float32 (corner + 4),
+                                     get_le_float32 (corner + 8)));
+      }
+    }
+  }
+  else if (size >= 5 && strncmp (buffer, "solid", 5) == 0) {
+
+    /* ASCII: only the "vertex" lines matter, three to a triangle */
+    char *ptr = buffer;
+    char *end = buffer + size;
+    int line = 0;
+
+    while (ptr < end) {
+      line++;
+      ptr = skip_blanks (ptr, end);
+      if (end - ptr > 6 && strncmp (ptr, "vertex", 6) == 0) {
+        float p[3];
+        ptr += 6;
+        for (j = 0; j < 3; j++) {
+          ptr = skip_blanks (ptr, end);
+          char *start = ptr;
+          p[j] = (float) ascii_to_double (&ptr, end);
+          if (ptr == start) {
+            fprintf (stderr, "STL line %d: vertex needs three coordinates\n", line);
+            delete[] buffer;
+            return (NULL);
+          }
+        }
+        tris.push_back (weld_vertex (&table, p[0], p[1], p[2]));
+      }
+      ptr = next_line (ptr, end);
+    }
+
+    if (tris.size () % 3 != 0) {
+      fprintf (stderr, "STL file has a triangle without three vertices\n");
+      delete[] buffer;
+      return (NULL);
+    }
+  }
+  else {
+    fprintf (stderr, "not an STL file\n");
+    delete[] buffer;
+    return (NULL);
+  }
+
+  delete[] buffer;
+
+  std::vector<double> pos (table.pos.begin (), table.pos.end ());
+  return (build_mesh (pos, tris));
+}
+
+
+/******************************************************************************
+Write a polyhedron as an OBJ file.
+
+Entry:
+  poly - polyhedron to write
+  name - name of the file to write
+
+Exit:
+  returns 1 if the file was written, 0 if not
+******************************************************************************/
+
+int write_obj_mesh(Polyhedron *poly, char *name)
+{
+  int i;
+  FILE *fp = fopen (name, "w");
+
+  if (fp == NULL)
+    return (0);
+  setvbuf (fp, NULL, _IOFBF, 1 << 16);
+
+  fprintf (fp, "# %d vertices, %d triangles\n", poly->nverts, poly->ntris);
+
+  /* each coordinate in the fewest digits that read back as the same double,
+     whatever the locale */
+  const double *coord[3] = {poly->vdata.x.data (), poly->vdata.y.data (),
+                            poly->vdata.z.data ()};
+  for (i = 0; i < poly->nverts; i++) {
+    char line[OBJ_VERTEX_LINE];
+    char *ptr = line;
+    *ptr++ = 'v';
+    for (int k = 0; k < 3; k++) {
+      *ptr++ = ' ';
+      ptr = std::to_chars (ptr, line + sizeof (line) - 1, coord[k][i]).ptr;
+    }
+    *ptr++ = '\n';
+    fwrite (line, 1, ptr - line, fp);
+  }
+
+  for (i = 0; i < poly->ntris; i++) {
+    Triangle *t = poly->tlist[i];
+    fprintf (fp, "f %d %d %d\n", t->verts[0]->index + 1,
+             t->verts[1]->index + 1, t->verts[2]->index + 1);
+  }
+
+  int ok = !ferror (fp);
+  if (fclose (fp) != 0)
+    ok = 0;
+  return (ok);
+}
+
+
+/******************************************************************************
+Put little-endian values into a binary STL file.
+******************************************************************************/
+
+static void put_le_uint32(unsigned char *ptr, unsigned int value)
+{
+  ptr[0] = (unsigned char) value;
+  ptr[1] = (unsigned char) (value >> 8);
+  ptr[2] = (unsigned char) (value >> 16);
+  ptr[3] = (unsigned char) (value >> 24);
+}
+
+static void put_le_float32(unsigned char *ptr, double value)
+{
+  float f = (float) value;
+  unsigned int bits;
+
+  memcpy (&bits, &f, sizeof (bits));
+  put_le_uint32 (ptr, bits);
+}
+
+
+/******************************************************************************
+Write a polyhedron as a binary STL file.  Each triangle's normal is worked
+out from its corners, so it needn't be up to date.
+
+Entry:
+  poly - polyhedron to write
+  name - name of the file to write
+
+Exit:
+  returns 1 if the file was written, 0 if not
+******************************************************************************/
+
+int write_stl_mesh(Polyhedron *poly, char *name)
+{
+  int i,j,k;
+  unsigned char header[STL_HEADER_SIZE + 4];
+  FILE *fp = fopen (name, "wb");
+
+  if (fp == NULL)
+    return (0);
+
+  memset (header, 0, sizeof (header));
+  strcpy ((char *) header, "binary STL written by learnply");
+  put_le_uint32 (header + STL_HEADER_SIZE, (unsigned int) poly->ntris);
+  fwrite (header, 1, sizeof (header), fp);
+
+  std::vector<unsigned char> batch ((size_t) STL_WRITE_BATCH * STL_TRIANGLE_SIZE);
+
+  for (i = 0; i < poly->ntris; i += STL_WRITE_BATCH) {
+    int n = (poly->ntris - i < STL_WRITE_BATCH) ? poly->ntris - i : STL_WRITE_BATCH;
+
+    for (j = 0; j < n; j++) {
+      Triangle *t = poly->tlist[i + j];
+      unsigned char *ptr = &batch[(size_t) j * STL_TRIANGLE_SIZE];
+      icVector3 normal = cross (t->verts[1]->pos () - t->verts[0]->pos (),
+                                t->verts[2]->pos () - t->verts[0]->pos ());
+      if (length (normal) > 0)
+        normalize (normal);
+
+      put_le_float32 (ptr, normal.x);
+      put_le_float32 (ptr + 4, normal.y);
+      put_le_float32 (ptr + 8, normal.z);
+      for (k = 0; k < 3; k++) {
+        icVector3 p = t->verts[k]->pos ();
+        put_le_float32 (ptr + 12 * (k + 1), p.x);
+        put_le_float32 (ptr + 12 * (k + 1) + 4, p.y);
+        put_le_float32 (ptr + 12 * (k + 1) + 8, p.z);
+      }
+      ptr[48] = ptr[49] = 0;
+    }
+
+    fwrite (&batch[0], STL_TRIANGLE_SIZE, n, fp);
+  }
+
+  int ok = !ferror (fp);
+  if (fclose (fp) != 0)
+    ok = 0;
+  return (ok);
+}
@@ -0,0 +1,48 @@
+/*
+
+Reading and writing meshes as Wavefront OBJ and STL files.
+
+Only vertex positions and triangles pass through these formats; other
+properties are not kept.  An OBJ file's polygons are split into fans of
+triangles, and its texture and normal indices are skipped.  STL files,
+binary or ASCII, store every triangle with its own copy of its corners, so
+corners at exactly the same position are welded into one vertex as the
+file is read.  Triangles that end up with a repeated vertex are dropped.
+
+*/
+
+#ifndef __MESH_FORMATS_H__
+#define __MESH_FORMATS_H__
+
+#include <stdio.h>
+
+class Polyhedron;
+
+/* formats that a mesh file can be in, told apart by its extension */
+#define MESH_FORMAT_PLY  0
+#define MESH_FORMAT_OBJ  1
+#define MESH_FORMAT_STL  2
+
+/* the format of a mesh file, from its name; anything unknown is PLY */
+int mesh_format(char *name);
+
+/*
+Read an OBJ or STL file into a new polyhedron, which is not initialized.
+The file is read whole and parsed in place.  Returns NULL, after saying
+what is wrong on stderr, if the file is malformed.
+*/
+Polyhedron *read_obj_mesh(FILE *);
+Polyhedron *read_stl_mesh(FILE *);
+
+/*
+Guess how many vertices and triangles an OBJ or STL file holds, without
+reading it: exactly for the triangles of a binary STL file, otherwise from
+the file's length.  The file is left at its start.
+*/
+void guess_mesh_counts(FILE *, int format, size_t *nverts, size_t *ntris);
+
+/* write a polyhedron as OBJ or as binary STL; returns 1 on success, 0 if not */
+int write_obj_mesh(Polyhedron *, char *name);
+int write_stl_mesh(Polyhedron *, char *name);
+
+#endif /* __MESH_FORMATS_H__ */
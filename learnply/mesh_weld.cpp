@@ -0,0 +1,212 @@
+/*
+
+Merging of coincident vertices as a mesh is loaded.
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+
+#include "learnply.h"
+#include "mesh_weld.h"
+#include "parallel.h"
+
+
+/* fewest vertices worth handing to a thread of their own */
+#define MIN_WELD_BLOCK  65536
+
+
+/******************************************************************************
+Grid of cells, each twice as wide as the weld distance.  Anything within the
+distance of a vertex lies in the vertex's own cell or, along each axis, in
+the neighbor on the side of the half of the cell the vertex is in, so only
+eight cells are looked in.
+
+The occupied cells are kept in an open-addressing hash table whose slots
+hold the lowest-numbered vertex of a cell, or -1 when empty; the rest of a
+cell's vertices follow in increasing order through "next".
+******************************************************************************/
+
+typedef struct WeldGrid {
+  std::vector<long long> cells;   /* x,y,z cell of each vertex */
+  std::vector<int> slots;
+  std::vector<int> next;
+  size_t mask;
+} WeldGrid;
+
+static size_t hash_cell(const long long *cell)
+{
+  unsigned long long hash = (unsigned long long) cell[0] * 0x9e3779b97f4a7c15ULL;
+  hash ^= (unsigned long long) cell[1] * 0xc2b2ae3d27d4eb4fULL;
+  hash ^= (unsigned long long) cell[2] * 0x165667b19e3779f9ULL;
+  return ((size_t) (hash ^ (hash >> 29)));
+}
+
+static int same_cell(const long long *a, const long long *b)
+{
+  return (a[0] == b[0] && a[1] == b[1] && a[2] == b[2]);
+}
+
+/* the lowest-numbered vertex in a cell, or -1 if the cell is empty */
+static int first_in_cell(WeldGrid *grid, const long long *cell)
+{
+  size_t slot = hash_cell (cell) & grid->mask;
+
+  while (grid->slots[slot] != -1) {
+    if (same_cell (&grid->cells[3 * (size_t) grid->slots[slot]], cell))
+      return (grid->slots[slot]);
+    slot = (slot + 1) & grid->mask;
+  }
+  return (-1);
+}
+
+
+/******************************************************************************
+Merge the vertices of a polyhedron that lie within a given distance of each
+other.  This is done before the polyhedron is initialized, while only its
+vertex and triangle lists exist.
+
+Every vertex goes to the lowest-numbered vertex within the distance of it,
+or stays if there is none, and then to wherever that vertex went, so a run
+of vertices each near the next ends up as one.  Finding the cells and the
+nearby vertices is done on several threads; the grid is filled and the
+lists are renumbered in single passes, so the whole takes linear time.
+
+Entry:
+  poly     - polyhedron whose vertex and triangle lists are filled in
+  distance - greatest distance between vertices that are merged
+
+Exit:
+  returns the number of vertices merged away
+******************************************************************************/
+
+int weld_vertices(Polyhedron *poly, double distance)
+{
+  int i,j;
+  int nverts = poly->nverts;
+  int ntris = poly->ntris;
+  Vertex **vlist = poly->vlist;
+  const double *x = poly->vdata.x.data ();
+  const double *y = poly->vdata.y.data ();
+  const double *z = poly->vdata.z.data ();
+  double min[3];
+  double dist2 = distance * distance;
+  double cell_size = 2 * distance;
+  WeldGrid grid;
+
+  if (nverts == 0 || !(distance > 0))
+    return (0);
+
+  int nthreads = parallel_thread_count (nverts / MIN_WELD_BLOCK);
+
+  /* the positions are in the vertex arrays in the order of the vertices */
+  min[0] = x[0];
+  min[1] = y[0];
+  min[2] = z[0];
+  for (i = 0; i < nverts; i++) {
+    if (x[i] < min[0]) min[0] = x[i];
+    if (y[i] < min[1]) min[1] = y[i];
+    if (z[i] < min[2]) min[2] = z[i];
+  }
+
+  /* find the cell of each vertex */
+
+  grid.cells.resize (3 * (size_t) nverts);
+
+  parallel_for (nthreads, [&](int t) {
+    int first = (int) ((size_t) nverts * t / nthreads);
+    int last = (int) ((size_t) nverts * (t + 1) / nthreads);
+    for (int k = first; k < last; k++) {
+      long long *cell = &grid.cells[3 * (size_t) k];
+      cell[0] = (long long) floor ((x[k] - min[0]) / cell_size);
+      cell[1] = (long long) floor ((y[k] - min[1]) / cell_size);
+      cell[2] = (long long) floor ((z[k] - min[2]) / cell_size);
+    }
+  });
+
+  /* put the vertices into the grid, last ones first so each cell's list
+     comes out in increasing order */
+
+  size_t nslots = 1024;
+  while (nslots < 2 * (size_t) nverts)
+    nslots *= 2;
+  grid.slots.assign (nslots, -1);
+  grid.next.assign (nverts, -1);
+  grid.mask = nslots - 1;
+
+  for (i = nverts - 1; i >= 0; i--) {
+    long long *cell = &grid.cells[3 * (size_t) i];
+    size_t slot = hash_cell (cell) & grid.mask;
+    while (grid.slots[slot] != -1 &&
+           !same_cell (&grid.cells[3 * (size_t) grid.slots[slot]], cell))
+      slot = (slot + 1) & grid.mask;
+    grid.next[i] = grid.slots[slot];
+    grid.slots[slot] = i;
+  }
+
+  /* find the lowest-numbered vertex near each vertex */
+
+  std::vector<int> rep (nverts);
+
+  parallel_for (nthreads, [&](int t) {
+    int first = (int) ((size_t) nverts * t / nthreads);
+    int last = (int) ((size_t) nverts * (t + 1) / nthreads);
+    for (int k = first; k < last; k++) {
+      long long *cell = &grid.cells[3 * (size_t) k];
+      int best = k;
+
+      /* the neighbors to look in are toward the nearer side of the cell */
+      int side[3];
+      side[0] = ((x[k] - min[0]) - cell[0] * cell_size < distance) ? -1 : 1;
+      side[1] = ((y[k] - min[1]) - cell[1] * cell_size < distance) ? -1 : 1;
+      side[2] = ((z[k] - min[2]) - cell[2] * cell_size < distance) ? -1 : 1;
+
+      for (int dx = 0; dx <= 1; dx++)
+        for (int dy = 0; dy <= 1; dy++)
+          for (int dz = 0; dz <= 1; dz++) {
+            long long near_cell[3] = {cell[0] + dx * side[0], cell[1] + dy * side[1],
+                                      cell[2] + dz * side[2]};
+            for (int m = first_in_cell (&grid, near_cell); m != -1 && m < best; m = grid.next[m]) {
+              double gap[3] = {x[m] - x[k], y[m] - y[k], z[m] - z[k]};
+              if (gap[0]*gap[0] + gap[1]*gap[1] + gap[2]*gap[2] <= dist2) {
+                best = m;
+                break;
+              }
+            }
+          }
+      rep[k] = best;
+    }
+  });
+
+  /* a vertex's choice comes before it, so one pass in order follows the runs */
+
+  for (i = 0; i < nverts; i++)
+    rep[i] = rep[rep[i]];
+
+  /* point the triangles at the vertices that are kept, and drop the ones
+     that lose a corner; what is dropped stays in the polyhedron's pools */
+
+  int new_ntris = 0;
+  for (i = 0; i < ntris; i++) {
+    Triangle *t = poly->tlist[i];
+    for (j = 0; j < 3; j++)
+      t->verts[j] = vlist[rep[t->verts[j]->index]];
+    if (t->verts[0] != t->verts[1] && t->verts[1] != t->verts[2] &&
+        t->verts[2] != t->verts[0])
+      poly->tlist[new_ntris++] = t;
+  }
+  poly->ntris = new_ntris;
+
+  /* keep the vertices that weren't merged, in their order */
+
+  int new_nverts = 0;
+  for (i = 0; i < nverts; i++)
+    if (rep[i] == i)
+      vlist[new_nverts++] = vlist[i];
+  poly->nverts = new_nverts;
+  poly->reorder_vertices (vlist, new_nverts);
+
+  return (nverts - new_nverts);
+}
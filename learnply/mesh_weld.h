@@ -0,0 +1,31 @@
+/*
+
+Merging of coincident vertices as a mesh is loaded.
+
+Scanned meshes often hold several copies of a vertex at (nearly) the same
+place.  Since the topology is built from vertex pointers alone, the copies
+split the surface apart along seams that have no opposite corners.
+
+*/
+
+#ifndef __MESH_WELD_H__
+#define __MESH_WELD_H__
+
+class Polyhedron;
+
+/* distance within which load_polyhedron() merges vertices, or 0 for no merging */
+inline double &weld_distance()
+{
+  static double distance = 0;
+  return distance;
+}
+
+/*
+Merge the vertices of an uninitialized polyhedron that lie within "distance"
+of each other, pointing its triangles at the vertices that are kept and
+dropping triangles that lose a corner.  Returns the number of vertices
+that were merged away.
+*/
+int weld_vertices(Polyhedron *, double distance);
+
+#endif /* __MESH_WELD_H__ */
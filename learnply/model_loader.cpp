@@ -0,0 +1,407 @@
+/*
+
+Loading of the viewer's models on background threads, within a memory budget
+
+*/
+
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "learnply.h"
+#include "compressed_mesh.h"
+#include "mesh_cache.h"
+#include "mesh_formats.h"
+#include "model_loader.h"
+#include "parallel.h"
+
+
+/* what is in a model's slot */
+#define MODEL_UNLOADED  0   /* nothing */
+#define MODEL_QUEUED    1   /* nothing yet; a worker will load it */
+#define MODEL_LOADING   2   /* nothing yet; a worker is loading it */
+#define MODEL_LOADED    3   /* the model */
+#define MODEL_FAILED    4   /* nothing; its file can't be read or its mesh has problems */
+
+static std::vector<char *> model_paths;
+static std::vector<Polyhedron *> *model_slots;
+static std::vector<int> model_state;
+static std::vector<size_t> pending_memory;        /* estimates for queued and loading models */
+static std::vector<unsigned long> last_selected;  /* when each model was last selected */
+static unsigned long select_clock;
+
+static std::vector<std::thread> load_threads;
+static std::deque<int> load_queue;      /* models for the workers, the first one next */
+static bool closing_loads;
+static std::mutex load_mutex;           /* guards the slots, states and queue */
+static std::condition_variable load_wanted;
+static std::condition_variable load_done;
+
+static void trim_models(int, size_t);
+
+
+/******************************************************************************
+Estimate the memory taken by a model from its counts.  Every triangle has
+three corners, and puts three entries in the vertex to triangle and vertex
+to corner lists, so these are counted per triangle.  Each vertex also has
+a position, normal and color in the polyhedron's vertex arrays.
+
+Entry:
+  nverts, ntris, nedges - size of the mesh
+  vert_other_size       - size of a vertex's other_props
+  face_other_size       - size of a triangle's other_props
+******************************************************************************/
+
+size_t mesh_memory(
+  size_t nverts,
+  size_t ntris,
+  size_t nedges,
+  size_t vert_other_size,
+  size_t face_other_size
+)
+{
+  size_t bytes = sizeof (Polyhedron);
+
+  bytes += nverts * (sizeof (Vertex *) + sizeof (Vertex));
+  bytes += nverts * 9 * sizeof (double);                           /* vdata */
+  bytes += ntris * (sizeof (Triangle *) + sizeof (Triangle));
+  bytes += nedges * (sizeof (Edge *) + sizeof (Edge) + 2 * sizeof (Triangle *));
+  bytes += 3 * ntris * (sizeof (Corner *) + sizeof (Corner));       /* clist */
+  bytes += 3 * ntris * (sizeof (Triangle *) + sizeof (Corner *));  /* per vertex lists */
+
+  bytes += nverts * vert_other_size;
+  bytes += ntris * face_other_size;
+
+  return (bytes);
+}
+
+
+/******************************************************************************
+Estimate the memory taken by a loaded model.
+******************************************************************************/
+
+size_t model_memory(Polyhedron *poly)
+{
+  return (mesh_memory (poly->nverts, poly->ntris, poly->nedges,
+                       poly->vert_other != NULL ? poly->vert_other->size : 0,
+                       poly->face_other != NULL ? poly->face_other->size : 0));
+}
+
+
+/******************************************************************************
+Estimate the memory a model file will take once it is loaded, from its
+header alone.  A PLY file or a compressed mesh declares its counts, and a
+binary STL file its triangle count; the size of an OBJ or ASCII STL mesh is
+guessed from the length of the file (see guess_mesh_counts()).  A closed
+mesh has 3/2 as many edges as triangles.
+
+Entry:
+  name - name of the model file
+
+Exit:
+  returns the estimate, or 0 if the file can't be probed
+******************************************************************************/
+
+size_t estimate_model_memory(char *name)
+{
+  PlyOtherProp *vert_other, *face_other;
+  size_t nverts, ntris;
+
+  FILE *fp = fopen (name, "rb");
+  if (fp == NULL)
+    return (0);
+
+  /* these formats have positions and triangles only */
+  if (is_compressed_mesh (fp)) {
+    int ok = probe_compressed_mesh (fp, &nverts, &ntris);
+    fclose (fp);
+    return (ok ? mesh_memory (nverts, ntris, (3 * ntris + 1) / 2, 0, 0) : 0);
+  }
+  else if (mesh_format (name) != MESH_FORMAT_PLY) {
+    guess_mesh_counts (fp, mesh_format (name), &nverts, &ntris);
+    fclose (fp);
+    return (mesh_memory (nverts, ntris, (3 * ntris + 1) / 2, 0, 0));
+  }
+  fclose (fp);
+
+  PlyFile *ply = probe_ply (name);
+  if (ply == NULL)
+    return (0);
+
+  nverts = get_element_count_ply (ply, "vertex");
+  ntris = get_element_count_ply (ply, "face");
+  describe_other_props (ply, &vert_other, &face_other);
+
+  size_t bytes = mesh_memory (nverts, ntris, (3 * ntris + 1) / 2,
+                              vert_other != NULL ? vert_other->size : 0,
+                              face_other != NULL ? face_other->size : 0);
+
+  free_other_properties_ply (vert_other);
+  free_other_properties_ply (face_other);
+  free_ply (ply);
+  return (bytes);
+}
+
+
+/******************************************************************************
+Drop a loaded model.  The caller holds load_mutex.
+******************************************************************************/
+
+static void unload_model(int index)
+{
+  Polyhedron *poly = (*model_slots)[index];
+
+  poly->finalize ();
+  delete poly;
+  (*model_slots)[index] = NULL;
+  model_state[index] = MODEL_UNLOADED;
+}
+
+
+/******************************************************************************
+Body of a worker thread: load the models in the queue, the first one
+first, until close_model_list() lets the workers go.
+******************************************************************************/
+
+static void load_models()
+{
+  std::unique_lock<std::mutex> lock (load_mutex);
+
+  while (true) {
+    load_wanted.wait (lock, [] { return closing_loads || !load_queue.empty (); });
+    if (closing_loads)
+      break;
+
+    int index = load_queue.front ();
+    load_queue.pop_front ();
+    model_state[index] = MODEL_LOADING;
+    lock.unlock ();
+
+    Polyhedron *poly = load_polyhedron (model_paths[index]);
+    if (poly != NULL) {
+      poly->calc_bounding_sphere ();
+      poly->calc_face_normals_and_area ();
+      poly->average_normals ();
+    }
+
+    lock.lock ();
+    (*model_slots)[index] = poly;
+    model_state[index] = (poly != NULL) ? MODEL_LOADED : MODEL_FAILED;
+    pending_memory[index] = 0;
+    load_done.notify_all ();
+  }
+}
+
+
+/******************************************************************************
+Take over a list of models without reading any of them, and start the
+worker threads that will.  There are enough workers for the selected model
+and its two neighbors to be read at once.
+
+Entry:
+  paths - names of the PLY files
+  polys - gets one empty slot for each model
+******************************************************************************/
+
+void open_model_list(std::vector<char *> &paths, std::vector<Polyhedron *> &polys)
+{
+  int i;
+  int nthreads = parallel_thread_count (paths.size () < 3 ? (int) paths.size () : 3);
+
+  model_paths = paths;
+  model_slots = &polys;
+  polys.assign (paths.size (), (Polyhedron *) NULL);
+  model_state.assign (paths.size (), MODEL_UNLOADED);
+  pending_memory.assign (paths.size (), 0);
+  last_selected.assign (paths.size (), 0);
+  select_clock = 0;
+
+  closing_loads = false;
+  for (i = 0; i < nthreads && !paths.empty (); i++)
+    load_threads.push_back (std::thread (load_models));
+}
+
+
+/******************************************************************************
+Queue a model for the workers if it is in memory only as long as the
+budget allows.  Models that are loaded, queued or failed are left alone, and
+so are those that would only fit by dropping another.  The file is probed
+without holding load_mutex, so that the workers can go on meanwhile.
+
+Entry:
+  index - position of the model in the list given to open_model_list()
+******************************************************************************/
+
+static void prefetch_model(int index)
+{
+  std::vector<Polyhedron *> &polys = *model_slots;
+  size_t budget = model_memory_budget ();
+  std::unique_lock<std::mutex> lock (load_mutex);
+
+  if (model_state[index] != MODEL_UNLOADED)
+    return;
+
+  lock.unlock ();
+  size_t bytes = estimate_model_memory (model_paths[index]);
+  lock.lock ();
+
+  if (model_state[index] != MODEL_UNLOADED)
+    return;
+
+  if (budget != 0) {
+    size_t total = bytes;
+    for (int i = 0; i < (int) polys.size (); i++)
+      total += (polys[i] != NULL) ? model_memory (polys[i]) : pending_memory[i];
+    if (total > budget)
+      return;
+  }
+
+  pending_memory[index] = bytes;
+  model_state[index] = MODEL_QUEUED;
+  load_queue.push_back (index);
+  load_wanted.notify_one ();
+}
+
+
+/******************************************************************************
+Select a model, waiting for a worker to load it if need be, and drop the
+least recently selected others while the loaded models take more than the
+memory budget.  The models on either side of it are then queued to be
+loaded in the background, if model_prefetch() is set.
+
+Entry:
+  index - position of the model in the list given to open_model_list()
+
+Exit:
+  returns the model, or NULL if its file can't be read or its mesh has
+  problems (see load_polyhedron())
+******************************************************************************/
+
+Polyhedron *select_model(int index)
+{
+  std::vector<Polyhedron *> &polys = *model_slots;
+  size_t budget = model_memory_budget ();
+  int n = (int) polys.size ();
+  size_t bytes = 0;
+  std::unique_lock<std::mutex> lock (load_mutex);
+
+  /* read the header without holding up the workers */
+  if (model_state[index] == MODEL_UNLOADED) {
+    lock.unlock ();
+    bytes = estimate_model_memory (model_paths[index]);
+    lock.lock ();
+  }
+
+  if (model_state[index] == MODEL_UNLOADED) {
+
+    /* make room before a model is loaded, as far as its header tells */
+    if (budget != 0)
+      trim_models (index, bytes);
+
+    pending_memory[index] = bytes;
+    model_state[index] = MODEL_QUEUED;
+    load_queue.push_front (index);
+    load_wanted.notify_one ();
+  }
+  else if (model_state[index] == MODEL_QUEUED) {
+
+    /* go ahead of the models that are only wanted in case */
+    for (size_t k = 0; k < load_queue.size (); k++)
+      if (load_queue[k] == index) {
+        load_queue.erase (load_queue.begin () + k);
+        break;
+      }
+    load_queue.push_front (index);
+  }
+
+  load_done.wait (lock, [index] {
+    return model_state[index] == MODEL_LOADED || model_state[index] == MODEL_FAILED;
+  });
+
+  if (model_state[index] == MODEL_FAILED)
+    return (NULL);
+
+  last_selected[index] = ++select_clock;
+
+  if (budget != 0)
+    trim_models (index, 0);
+
+  /* only this thread drops models, so the slot keeps its model */
+  Polyhedron *poly = polys[index];
+  lock.unlock ();
+
+  if (model_prefetch () && n > 1) {
+    prefetch_model ((index + 1) % n);
+    prefetch_model ((index + n - 1) % n);
+  }
+
+  return (poly);
+}
+
+
+/******************************************************************************
+Drop the least recently selected models until the loaded models, together
+with those on their way and memory that is about to be used, fit in the
+budget.  Models that are still being read are not dropped.  The caller
+holds load_mutex.
+
+Entry:
+  keep  - model that is never dropped
+  extra - memory about to be used
+******************************************************************************/
+
+static void trim_models(int keep, size_t extra)
+{
+  std::vector<Polyhedron *> &polys = *model_slots;
+  size_t budget = model_memory_budget ();
+  size_t total = extra;
+  int i;
+
+  for (i = 0; i < (int) polys.size (); i++)
+    total += (polys[i] != NULL) ? model_memory (polys[i]) : pending_memory[i];
+
+  while (total > budget) {
+
+    /* find the least recently selected model other than this one */
+    int oldest = -1;
+    for (i = 0; i < (int) polys.size (); i++)
+      if (polys[i] != NULL && i != keep &&
+          (oldest == -1 || last_selected[i] < last_selected[oldest]))
+        oldest = i;
+
+    /* the selected model stays, even if it is over the budget on its own */
+    if (oldest == -1)
+      break;
+
+    fprintf (stderr, "unloading %s\n", model_paths[oldest]);
+    total -= model_memory (polys[oldest]);
+    unload_model (oldest);
+  }
+}
+
+
+/******************************************************************************
+Let go of the worker threads, once the models they are reading are done,
+and drop every loaded model.
+******************************************************************************/
+
+void close_model_list()
+{
+  {
+    std::lock_guard<std::mutex> lock (load_mutex);
+    closing_loads = true;
+    load_queue.clear ();
+  }
+  load_wanted.notify_all ();
+
+  for (size_t i = 0; i < load_threads.size (); i++)
+    load_threads[i].join ();
+  load_threads.clear ();
+
+  for (int i = 0; i < (int) model_slots->size (); i++)
+    if ((*model_slots)[i] != NULL)
+      unload_model (i);
+}
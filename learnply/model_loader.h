@@ -0,0 +1,67 @@
+/*
+
+Loading of the viewer's models on background threads, within a memory budget
+
+*/
+
+#ifndef __MODEL_LOADER_H__
+#define __MODEL_LOADER_H__
+
+#include <stddef.h>
+#include <vector>
+
+class Polyhedron;
+
+/* default limit on the memory held by loaded models, in megabytes */
+const int DEFAULT_MODEL_BUDGET_MB = 2048;
+
+/* upper limit on the memory held by loaded models, in bytes, or 0 for no limit */
+inline size_t &model_memory_budget()
+{
+  static size_t budget = (size_t) DEFAULT_MODEL_BUDGET_MB << 20;
+  return budget;
+}
+
+/* whether select_model() starts loading the models on either side of the selected one */
+inline bool &model_prefetch()
+{
+  static bool prefetch = true;
+  return prefetch;
+}
+
+/*
+Take over a list of PLY files, and start the worker threads that read them.
+Nothing is read yet: "polys" is resized to one NULL slot per file, and a
+slot holds its model only while it is loaded.  The vector must not be
+resized or written to until close_model_list().
+*/
+void open_model_list(std::vector<char *> &paths, std::vector<Polyhedron *> &polys);
+
+/*
+Return model "index", waiting for a worker thread to read and initialize
+it (see load_polyhedron()) if it isn't loaded yet.  Room is made for a
+model before it is read, using estimate_model_memory(), and the least
+recently selected other models are then dropped until the loaded ones fit
+in model_memory_budget().  Selecting the current model again after it has
+grown (by subdivision, say) makes room for it in the same way.  The models
+on either side of it are then read in the background, if model_prefetch()
+is set and they fit in the budget without dropping anything.  Returns NULL
+if the model's file can't be read or its mesh has problems, which it is
+only read once to find out.
+*/
+Polyhedron *select_model(int index);
+
+/* estimate of the memory taken by a model */
+size_t model_memory(Polyhedron *);
+
+/*
+Estimate of the memory a model file will take once loaded, read from its
+header alone; for OBJ and ASCII STL files it is a guess from the file's
+length.  Returns 0 if the file can't be probed.
+*/
+size_t estimate_model_memory(char *name);
+
+/* wait for the worker threads to finish what they are reading, and drop every loaded model */
+void close_model_list();
+
+#endif /* __MODEL_LOADER_H__ */
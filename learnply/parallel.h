@@ -0,0 +1,53 @@
+/*
+
+Small helpers for running independent pieces of work on several threads
+
+*/
+
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include <thread>
+#include <vector>
+
+
+/* upper limit on the number of threads to use, or 0 to use every hardware thread */
+inline int &parallel_thread_limit()
+{
+  static int limit = 0;
+  return limit;
+}
+
+/* number of threads worth using for the given number of independent tasks */
+inline int parallel_thread_count(int max_tasks)
+{
+  int n = parallel_thread_limit();
+
+  if (n <= 0)
+    n = (int) std::thread::hardware_concurrency();
+  if (n > max_tasks)
+    n = max_tasks;
+  if (n < 1)
+    n = 1;
+
+  return n;
+}
+
+/*
+Call work(task) once for each task in [0, ntasks), each on its own thread.
+Task 0 runs on the calling thread, and all of them are finished on return.
+*/
+template <class Work>
+void parallel_for(int ntasks, Work work)
+{
+  std::vector<std::thread> threads;
+
+  for (int task = 1; task < ntasks; task++)
+    threads.push_back(std::thread(work, task));
+  if (ntasks > 0)
+    work(0);
+  for (size_t i = 0; i < threads.size(); i++)
+    threads[i].join();
+}
+
+#endif /* __PARALLEL_H__ */
@@ -38,6 +38,17 @@ WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <charconv>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
 
 #if UNIX
 #include <ply.h>
@@ -45,6 +56,8 @@ WARRANTY OF MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE.
 #include "ply.h"
 #endif
 
+#include "parallel.h"
+
 
 #if !UNIX
 #define drand48 rand
@@ -73,6 +86,22 @@ int ply_type_size[] = {
 #define OTHER_PROP       0
 #define NAMED_PROP       1
 
+/* fewest ascii elements worth handing to a thread of their own */
+#define MIN_ASCII_BLOCK  16384
+
+/* size of the staging buffer for writing runs of binary elements */
+#define WRITE_BUFFER_SIZE  (1 << 22)
+
+/* fewest and most ascii elements a thread formats at a time when writing */
+#define MIN_ASCII_WRITE  4096
+#define MAX_ASCII_WRITE  65536
+
+/* most characters an ascii number takes, with the space after it */
+#define MAX_ASCII_ITEM  32
+
+/* size of the blocks of a file's arena */
+#define ARENA_BLOCK_SIZE  (1 << 20)
+
 /* returns 1 if strings are equal, 0 if not */
 int equal_strings(char *, char *);
 
@@ -112,14 +141,40 @@ double get_item_value(char *, int);
 
 /* get binary or ascii item and store it according to ptr and type */
 void get_ascii_item(char *, int, int *, unsigned int *, double *);
-void get_binary_item(FILE *, int, int *, unsigned int *, double *);
+void get_binary_item(PlyFile *, int, int *, unsigned int *, double *);
+
+/* read raw bytes of a binary body, from the mapped view if there is one */
+void read_binary_bytes(PlyFile *, void *, int);
 
 /* get a bunch of elements from a file */
 void ascii_get_element(PlyFile *, char *);
 void binary_get_element(PlyFile *, char *);
 
+/* get an element straight out of a memory-mapped ascii body */
+void mapped_ascii_get_element(PlyFile *, char *);
+
+/* decode a run of fixed-layout binary elements out of the mapped view */
+int binary_get_block(PlyFile *, char *, int, int);
+
+/* parse a run of mapped ascii elements, one line each, on several threads */
+int ascii_get_block(PlyFile *, char *, int, int);
+
+/* encode binary elements, one at a time or a run through a large staging
+   buffer */
+static void binary_put_element(PlyFile *, char *);
+void binary_put_block(PlyFile *, char *, int, int);
+void ascii_put_block(PlyFile *, char *, int, int);
+void get_mapped_ascii_item(PlyFile *, int, int *, unsigned int *, double *);
+char *get_mapped_ascii_word(PlyFile *, int *);
+
 /* memory allocation */
-static char *my_alloc(int, int, char *);
+static char *my_alloc(size_t, int, char *);
+
+/* header of a file being read */
+static PlyFile *read_header(FILE *);
+
+/* room for an element's lists, strings and other_props */
+char *element_alloc(PlyFile *, size_t);
 
 
 /*************/
@@ -165,6 +220,9 @@ PlyFile *ply_write(
   plyfile->version = 1.0;
   plyfile->fp = fp;
   plyfile->other_elems = NULL;
+  plyfile->map_base = NULL;
+  plyfile->use_arena = 0;
+  plyfile->arena = NULL;
 
   /* tuck aside the names of the elements */
 
@@ -544,58 +602,40 @@ void put_element_ply(PlyFile *plyfile, void *elem_ptr)
   }
   else {
 
-    /* write a binary file */
+    /* write a binary file, in its byte order, as put_element_block_ply()
+       does */
+    binary_put_element (plyfile, (char *) elem_ptr);
+  }
+}
 
-    /* write out each property of the element */
-    for (j = 0; j < elem->nprops; j++) {
-      prop = elem->props[j];
-      if (elem->store_prop[j] == OTHER_PROP)
-        elem_data = *other_ptr;
-      else
-        elem_data = (char *) elem_ptr;
-      if (prop->is_list == PLY_LIST) {   /* list */
-        item = elem_data + prop->count_offset;
-        item_size = ply_type_size[prop->count_internal];
-        get_stored_item ((void *) item, prop->count_internal,
-                         &int_val, &uint_val, &double_val);
-        write_binary_item (fp, int_val, uint_val, double_val,
-                           prop->count_external);
-        list_count = uint_val;
-        item_ptr = (char **) (elem_data + prop->offset);
-        item = item_ptr[0];
-        item_size = ply_type_size[prop->internal_type];
-        for (k = 0; k < list_count; k++) {
-          get_stored_item ((void *) item, prop->internal_type,
-                           &int_val, &uint_val, &double_val);
-          write_binary_item (fp, int_val, uint_val, double_val,
-                             prop->external_type);
-          item += item_size;
-        }
-      }
-      else if (prop->is_list == PLY_STRING) {   /* string */
-	int len;
-	char **str;
-        item = elem_data + prop->offset;
-	str = (char **) item;
 
-	/* write the length */
-	len = strlen(*str) + 1;
-	fwrite (&len, sizeof(int), 1, fp);
+/******************************************************************************
+Write a run of elements to the file from an array of the user's structures.
+This has the same effect as calling put_element_ply() once for each of them,
+but elements of a binary file are gathered into a large buffer and written
+out a few megabytes at a time, and those of an ascii file are formatted on
+several threads.
 
-	/* write the string, including the null character */
-	fwrite (*str, len, 1, fp);
-      }
-      else {                   /* scalar */
-        item = elem_data + prop->offset;
-        item_size = ply_type_size[prop->internal_type];
-        get_stored_item ((void *) item, prop->internal_type,
-                         &int_val, &uint_val, &double_val);
-        write_binary_item (fp, int_val, uint_val, double_val,
-                           prop->external_type);
-      }
-    }
+Entry:
+  plyfile    - file identifier
+  elem_array - array of at least "count" of the user's element structures
+  elem_size  - size in bytes of one of the user's structures
+  count      - number of elements to write
+******************************************************************************/
 
-  }
+void put_element_block_ply(
+  PlyFile *plyfile,
+  void *elem_array,
+  int elem_size,
+  int count
+)
+{
+  char *elem_data = (char *) elem_array;
+
+  if (plyfile->file_type != PLY_ASCII)
+    binary_put_block (plyfile, elem_data, elem_size, count);
+  else
+    ascii_put_block (plyfile, elem_data, elem_size, count);
 }
 
 
@@ -622,13 +662,50 @@ Exit:
 ******************************************************************************/
 
 PlyFile *ply_read(FILE *fp, int *nelems, char ***elem_names)
+{
+  int i;
+  PlyFile *plyfile;
+  char **elist;
+
+  plyfile = read_header (fp);
+  if (plyfile == NULL)
+    return (NULL);
+
+  /* set return values about the elements */
+
+  elist = (char **) myalloc (sizeof (char *) * plyfile->num_elem_types);
+  for (i = 0; i < plyfile->num_elem_types; i++)
+    elist[i] = strdup (plyfile->elems[i]->name);
+
+  *elem_names = elist;
+  *nelems = plyfile->num_elem_types;
+
+  /* read the body straight out of memory when the file can be mapped */
+  map_body_ply (plyfile);
+
+  /* return a pointer to the file's information */
+
+  return (plyfile);
+}
+
+
+/******************************************************************************
+Read the header of a PLY file, leaving the file just past it.
+
+Entry:
+  fp - the given file pointer
+
+Exit:
+  returns a pointer to a PlyFile describing the file, or NULL if error
+******************************************************************************/
+
+static PlyFile *read_header(FILE *fp)
 {
   int i,j;
   PlyFile *plyfile;
   int nwords;
   char **words;
   int found_format = 0;
-  char **elist;
   PlyElement *elem;
   char *orig_line;
 
@@ -647,6 +724,9 @@ PlyFile *ply_read(FILE *fp, int *nelems, char ***elem_names)
   plyfile->fp = fp;
   plyfile->other_elems = NULL;
   plyfile->rule_list = NULL;
+  plyfile->map_base = NULL;
+  plyfile->use_arena = 0;
+  plyfile->arena = NULL;
 
   /* read and parse the file's header */
 
@@ -700,17 +780,6 @@ PlyFile *ply_read(FILE *fp, int *nelems, char ***elem_names)
     elem->other_offset = NO_OTHER_PROPS; /* no "other" props by default */
   }
 
-  /* set return values about the elements */
-
-  elist = (char **) myalloc (sizeof (char *) * plyfile->num_elem_types);
-  for (i = 0; i < plyfile->num_elem_types; i++)
-    elist[i] = strdup (plyfile->elems[i]->name);
-
-  *elem_names = elist;
-  *nelems = plyfile->num_elem_types;
-
-  /* return a pointer to the file's information */
-
   return (plyfile);
 }
 
@@ -1037,6 +1106,14 @@ void setup_other_props(PlyFile *plyfile, PlyElement *elem)
 
   }
 
+  /* keep the list and string pointers aligned when structures are laid
+     out one after another */
+  for (i = 0; i < elem->nprops; i++)
+    if (!elem->store_prop[i] && elem->props[i]->is_list != PLY_SCALAR) {
+      size = (size + sizeof (void *) - 1) / sizeof (void *) * sizeof (void *);
+      break;
+    }
+
   /* save the size for the other_props structure */
   elem->other_size = size;
 }
@@ -1176,6 +1253,7 @@ PlyOtherElems *get_other_element_ply (PlyFile *plyfile)
   int elem_count;
   PlyOtherElems *other_elems;
   OtherElem *other;
+  int use_arena;
 
   elem = plyfile->which_elem;
   elem_name = elem->name;
@@ -1213,12 +1291,16 @@ PlyOtherElems *get_other_element_ply (PlyFile *plyfile)
   other->other_props = ply_get_other_properties (plyfile, elem_name,
                          offsetof(OtherData,other_props));
 
-  /* grab all these elements */
+  /* grab all these elements, with their own memory rather than the */
+  /* arena's, since they are kept for writing out again */
+  use_arena = plyfile->use_arena;
+  plyfile->use_arena = 0;
   for (i = 0; i < other->elem_count; i++) {
     /* grab and element from the file */
     other->other_data[i] = (OtherData *) malloc (sizeof (OtherData));
     ply_get_element (plyfile, (void *) other->other_data[i]);
   }
+  plyfile->use_arena = use_arena;
 
   /* return pointer to the other elements data */
   return (other_elems);
@@ -1255,6 +1337,30 @@ void put_other_elements_ply (PlyFile *plyfile)
 }
 
 
+/******************************************************************************
+Free up storage used by a description of other_props.
+
+Entry:
+  other - description to free up, or NULL
+******************************************************************************/
+
+void free_other_properties_ply(PlyOtherProp *other)
+{
+  int i;
+
+  if (other == NULL)
+    return;
+
+  for (i = 0; i < other->nprops; i++) {
+    free (other->props[i]->name);
+    free (other->props[i]);
+  }
+  free (other->props);
+  free (other->name);
+  free (other);
+}
+
+
 /******************************************************************************
 Free up storage used by an "other" elements data structure.
 
@@ -1284,6 +1390,7 @@ Entry:
 
 void ply_close(PlyFile *plyfile)
 {
+  unmap_body_ply (plyfile);
   fclose (plyfile->fp);
 
   /* free up memory associated with the PLY file */
@@ -1444,6 +1551,12 @@ void ascii_get_element(PlyFile *plyfile, char *elem_ptr)
   char *other_data;
   int other_flag;
 
+  /* a mapped body is tokenized in place instead of line by line */
+  if (plyfile->map_base != NULL) {
+    mapped_ascii_get_element (plyfile, elem_ptr);
+    return;
+  }
+
   /* the kind of element we're reading currently */
   elem = plyfile->which_elem;
 
@@ -1453,7 +1566,7 @@ void ascii_get_element(PlyFile *plyfile, char *elem_ptr)
     char **ptr;
     other_flag = 1;
     /* make room for other_props */
-    other_data = (char *) myalloc (elem->other_size);
+    other_data = element_alloc (plyfile, elem->other_size);
     /* store pointer in user's structure to the other_props */
     ptr = (char **) (elem_ptr + elem->other_offset);
     *ptr = other_data;
@@ -1503,7 +1616,7 @@ void ascii_get_element(PlyFile *plyfile, char *elem_ptr)
       }
       else {
         if (store_it) {
-          item_ptr = (char *) myalloc (sizeof (char) * item_size * list_count);
+          item_ptr = element_alloc (plyfile, (size_t) item_size * list_count);
           item = item_ptr;
           *store_array = item_ptr;
         }
@@ -1525,7 +1638,8 @@ void ascii_get_element(PlyFile *plyfile, char *elem_ptr)
       if (store_it) {
 	char *str;
 	char **str_ptr;
-	str = strdup (words[which_word++]);
+	str = element_alloc (plyfile, strlen (words[which_word]) + 1);
+	strcpy (str, words[which_word++]);
         item = elem_data + prop->offset;
 	str_ptr = (char **) item;
 	*str_ptr = str;
@@ -1550,21 +1664,21 @@ void ascii_get_element(PlyFile *plyfile, char *elem_ptr)
 
 
 /******************************************************************************
-Read an element from a binary file.
+Read an element from an ascii file whose body has been memory-mapped.  The
+words are parsed where they lie in the mapped view, so unlike the stdio path
+no line is copied and no word list is allocated for each element.
 
 Entry:
   plyfile  - file identifier
-  elem_ptr - pointer to an element
+  elem_ptr - pointer to element
 ******************************************************************************/
 
-void binary_get_element(PlyFile *plyfile, char *elem_ptr)
+void mapped_ascii_get_element(PlyFile *plyfile, char *elem_ptr)
 {
-  int i,j,k;
+  int j,k;
   PlyElement *elem;
   PlyProperty *prop;
-  FILE *fp = plyfile->fp;
-  char *elem_data;
-  char *item;
+  char *elem_data,*item;
   char *item_ptr;
   int item_size;
   int int_val;
@@ -1575,6 +1689,7 @@ void binary_get_element(PlyFile *plyfile, char *elem_ptr)
   char **store_array;
   char *other_data;
   int other_flag;
+  char *end = plyfile->map_base + plyfile->map_size;
 
   /* the kind of element we're reading currently */
   elem = plyfile->which_elem;
@@ -1585,7 +1700,7 @@ void binary_get_element(PlyFile *plyfile, char *elem_ptr)
     char **ptr;
     other_flag = 1;
     /* make room for other_props */
-    other_data = (char *) myalloc (elem->other_size);
+    other_data = element_alloc (plyfile, elem->other_size);
     /* store pointer in user's structure to the other_props */
     ptr = (char **) (elem_ptr + elem->other_offset);
     *ptr = other_data;
@@ -1593,8 +1708,6 @@ void binary_get_element(PlyFile *plyfile, char *elem_ptr)
   else
     other_flag = 0;
 
-  /* read in a number of elements */
-
   for (j = 0; j < elem->nprops; j++) {
 
     prop = elem->props[j];
@@ -1606,11 +1719,11 @@ void binary_get_element(PlyFile *plyfile, char *elem_ptr)
     else
       elem_data = other_data;
 
-    if (prop->is_list == PLY_LIST) {          /* list */
+    if (prop->is_list == PLY_LIST) {       /* a list */
 
       /* get and store the number of items in the list */
-      get_binary_item (fp, prop->count_external,
-                      &int_val, &uint_val, &double_val);
+      get_mapped_ascii_item (plyfile, prop->count_external,
+                             &int_val, &uint_val, &double_val);
       if (store_it) {
         item = elem_data + prop->count_offset;
         store_item(item, prop->count_internal, int_val, uint_val, double_val);
@@ -1620,21 +1733,22 @@ void binary_get_element(PlyFile *plyfile, char *elem_ptr)
       list_count = int_val;
       item_size = ply_type_size[prop->internal_type];
       store_array = (char **) (elem_data + prop->offset);
+
       if (list_count == 0) {
         if (store_it)
           *store_array = NULL;
       }
       else {
         if (store_it) {
-          item_ptr = (char *) myalloc (sizeof (char) * item_size * list_count);
+          item_ptr = element_alloc (plyfile, (size_t) item_size * list_count);
           item = item_ptr;
           *store_array = item_ptr;
         }
 
         /* read items and store them into the array */
         for (k = 0; k < list_count; k++) {
-          get_binary_item (fp, prop->external_type,
-                          &int_val, &uint_val, &double_val);
+          get_mapped_ascii_item (plyfile, prop->external_type,
+                                 &int_val, &uint_val, &double_val);
           if (store_it) {
             store_item (item, prop->internal_type,
                         int_val, uint_val, double_val);
@@ -1644,22 +1758,23 @@ void binary_get_element(PlyFile *plyfile, char *elem_ptr)
       }
 
     }
-    else if (prop->is_list == PLY_STRING) {     /* string */
+    else if (prop->is_list == PLY_STRING) {   /* a string */
       int len;
-      char *str;
-      fread (&len, sizeof(int), 1, fp);
-      str = (char *) myalloc (len);
-      fread (str, len, 1, fp);
+      char *word = get_mapped_ascii_word (plyfile, &len);
       if (store_it) {
+	char *str;
 	char **str_ptr;
+	str = element_alloc (plyfile, len + 1);
+	memcpy (str, word, len);
+	str[len] = '\0';
         item = elem_data + prop->offset;
 	str_ptr = (char **) item;
 	*str_ptr = str;
       }
     }
-    else {                                      /* scalar */
-      get_binary_item (fp, prop->external_type,
-                      &int_val, &uint_val, &double_val);
+    else {                     /* a scalar */
+      get_mapped_ascii_item (plyfile, prop->external_type,
+                             &int_val, &uint_val, &double_val);
       if (store_it) {
         item = elem_data + prop->offset;
         store_item (item, prop->internal_type, int_val, uint_val, double_val);
@@ -1667,133 +1782,404 @@ void binary_get_element(PlyFile *plyfile, char *elem_ptr)
     }
 
   }
-}
-
-
-/******************************************************************************
-Write to a file the word that represents a PLY data type.
-
-Entry:
-  fp   - file pointer
-  code - code for type
-******************************************************************************/
-
-void write_scalar_type (FILE *fp, int code)
-{
-  /* make sure this is a valid code */
-
-  if (code <= StartType || code >= EndType) {
-    fprintf (stderr, "write_scalar_type: bad data code = %d\n", code);
-    exit (-1);
-  }
-
-  /* write the code to a file */
 
-  fprintf (fp, "%s", type_names[code]);
+  /* skip anything else on the element's line, as get_words() would */
+  while (plyfile->map_ptr < end && *plyfile->map_ptr != '\n')
+    plyfile->map_ptr++;
+  if (plyfile->map_ptr < end)
+    plyfile->map_ptr++;
 }
 
 
 /******************************************************************************
-Get a text line from a file and break it up into words.
+Read a run of elements from a memory-mapped ascii body on several threads.
 
-IMPORTANT: The calling routine should call "free" on the returned pointer once
-finished with it.
+As with ascii_get_element(), each element is expected on a line of its own.
+The lines from the current position on are counted a piece at a time in
+parallel, which gives the position of the line that starts each thread's
+share of the run, and then every thread parses its share with its own read
+position in the mapped view.
 
 Entry:
-  fp - file to read from
+  plyfile    - file identifier
+  elem_array - array of the user's element structures
+  elem_size  - size of one of the user's structures
+  count      - number of elements to read
 
 Exit:
-  nwords    - number of words returned
-  orig_line - the original line of characters
-  returns a list of words from the line, or NULL if end-of-file
+  returns 1 if the run was read, or 0 if it is too short to be worth
+  splitting up or isn't laid out one element per line (in which case the
+  read position is where it was, and the run is to be read one element at
+  a time)
 ******************************************************************************/
 
-char **get_words(FILE *fp, int *nwords, char **orig_line)
+int ascii_get_block(
+  PlyFile *plyfile,
+  char *elem_array,
+  int elem_size,
+  int count
+)
 {
-#define BIG_STRING 4096
   int i,j;
-  static char str[BIG_STRING];
-  static char str_copy[BIG_STRING];
-  char **words;
-  int max_words = 10;
-  int num_words = 0;
-  char *ptr,*ptr2;
-  char *result;
-
-  words = (char **) myalloc (sizeof (char *) * max_words);
+  int nthreads = parallel_thread_count (count / MIN_ASCII_BLOCK);
+  char *body = plyfile->map_ptr;
+  char *end = plyfile->map_base + plyfile->map_size;
+  size_t piece_size;
+  size_t *newlines;
+  char **start;
+  char **stop;
+  PlyArenaBlock **arenas;
+  size_t lines_before;
+  size_t line;
+
+  if (nthreads < 2)
+    return (0);
 
-  /* read in a line */
-  result = fgets (str, BIG_STRING, fp);
-  if (result == NULL) {
-    *nwords = 0;
-    *orig_line = NULL;
-    return (NULL);
-  }
+  /* count the line ends in each piece of the rest of the body */
+
+  piece_size = (end - body + nthreads - 1) / nthreads;
+  newlines = (size_t *) myalloc (sizeof (size_t) * nthreads);
+
+  parallel_for (nthreads, [&](int t) {
+    char *ptr = body + piece_size * t;
+    char *piece_end = ptr + piece_size;
+    size_t n = 0;
+    if (ptr > end)
+      ptr = end;
+    if (piece_end > end)
+      piece_end = end;
+    while ((ptr = (char *) memchr (ptr, '\n', piece_end - ptr)) != NULL) {
+      n++;
+      ptr++;
+    }
+    newlines[t] = n;
+  });
 
-  /* convert line-feed and tabs into spaces */
-  /* (this guarentees that there will be a space before the */
-  /*  null character at the end of the string) */
+  /* find where each thread's share of the run begins */
 
-  str[BIG_STRING-2] = ' ';
-  str[BIG_STRING-1] = '\0';
+  start = (char **) myalloc (sizeof (char *) * (nthreads + 1));
+  stop = (char **) myalloc (sizeof (char *) * nthreads);
+  start[0] = body;
 
-  for (ptr = str, ptr2 = str_copy; *ptr != '\0'; ptr++, ptr2++) {
-    *ptr2 = *ptr;
-    if (*ptr == '\t') {
-      *ptr = ' ';
-      *ptr2 = ' ';
-    }
-    else if (*ptr == '\n') {
-      *ptr = ' ';
-      *ptr2 = '\0';
-      break;
-    }
-  }
+  lines_before = 0;
+  j = 0;
+  for (i = 1; i < nthreads; i++) {
 
-  /* find the words in the line */
+    /* the share starts just past this many line ends */
+    line = (size_t) count * i / nthreads;
 
-  ptr = str;
-  while (*ptr != '\0') {
+    while (j < nthreads && lines_before + newlines[j] < line)
+      lines_before += newlines[j++];
 
-    /* jump over leading spaces */
-    while (*ptr == ' ')
-      ptr++;
+    /* fewer lines than elements: leave the run to be read one at a time */
+    if (j == nthreads) {
+      free (newlines);
+      free (start);
+      free (stop);
+      return (0);
+    }
 
-    /* break if we reach the end */
-    if (*ptr == '\0')
-      break;
+    char *ptr = body + piece_size * j;
+    for (size_t n = lines_before; n < line; n++)
+      ptr = (char *) memchr (ptr, '\n', end - ptr) + 1;
+    start[i] = ptr;
+  }
 
-    /* allocate more room for words if necessary */
-    if (num_words >= max_words) {
-      max_words += 10;
-      words = (char **) realloc (words, sizeof (char *) * max_words);
+  /* parse the shares, each with a copy of the file's read state */
+
+  arenas = (PlyArenaBlock **) myalloc (sizeof (PlyArenaBlock *) * nthreads);
+
+  parallel_for (nthreads, [&](int t) {
+    PlyFile reader = *plyfile;
+    int first = (int) ((size_t) count * t / nthreads);
+    int last = (int) ((size_t) count * (t + 1) / nthreads);
+    reader.map_ptr = start[t];
+    reader.arena = NULL;
+    for (int k = first; k < last; k++)
+      mapped_ascii_get_element (&reader, elem_array + (size_t) k * elem_size);
+    stop[t] = reader.map_ptr;
+    arenas[t] = reader.arena;
+  });
+
+  /* the file's arena takes over the blocks each thread filled */
+
+  for (i = 0; i < nthreads; i++) {
+    PlyArenaBlock *block = arenas[i];
+    while (block != NULL) {
+      PlyArenaBlock *next = block->next;
+      block->next = plyfile->arena;
+      plyfile->arena = block;
+      block = next;
     }
+  }
 
-    if (*ptr == '\"') {  /* a quote indidicates that we have a string */
+  /* a share that didn't end where the next one began means an element
+     was spread over several lines (or there were blank lines), so the
+     shares started in the wrong places; the run is read again from its
+     start, one element at a time */
 
-      /* skip over leading quote */
-      ptr++;
+  int lined_up = 1;
+  for (i = 1; i < nthreads; i++)
+    if (stop[i-1] != start[i])
+      lined_up = 0;
 
-      /* save pointer to beginning of word */
-      words[num_words++] = ptr;
+  plyfile->map_ptr = lined_up ? stop[nthreads-1] : body;
 
-      /* find trailing quote or end of line */
-      while (*ptr != '\"' && *ptr != '\0')
-        ptr++;
+  free (newlines);
+  free (start);
+  free (stop);
+  free (arenas);
+  return (lined_up);
+}
 
-      /* replace quote with a null character to mark the end of the word */
-      /* if we are not already at the end of the line */
-      if (*ptr != '\0')
-	*ptr++ = '\0';
-    }
-    else {               /* non-string */
 
-      /* save pointer to beginning of word */
-      words[num_words++] = ptr;
+/******************************************************************************
+Read an element from a binary file.
 
-      /* jump over non-spaces */
-      while (*ptr != ' ')
-	ptr++;
+Entry:
+  plyfile  - file identifier
+  elem_ptr - pointer to an element
+******************************************************************************/
+
+void binary_get_element(PlyFile *plyfile, char *elem_ptr)
+{
+  int i,j,k;
+  PlyElement *elem;
+  PlyProperty *prop;
+  char *elem_data;
+  char *item;
+  char *item_ptr;
+  int item_size;
+  int int_val;
+  unsigned int uint_val;
+  double double_val;
+  int list_count;
+  int store_it;
+  char **store_array;
+  char *other_data;
+  int other_flag;
+
+  /* the kind of element we're reading currently */
+  elem = plyfile->which_elem;
+
+  /* do we need to setup for other_props? */
+
+  if (elem->other_offset != NO_OTHER_PROPS) {
+    char **ptr;
+    other_flag = 1;
+    /* make room for other_props */
+    other_data = element_alloc (plyfile, elem->other_size);
+    /* store pointer in user's structure to the other_props */
+    ptr = (char **) (elem_ptr + elem->other_offset);
+    *ptr = other_data;
+  }
+  else
+    other_flag = 0;
+
+  /* read in a number of elements */
+
+  for (j = 0; j < elem->nprops; j++) {
+
+    prop = elem->props[j];
+    store_it = (elem->store_prop[j] | other_flag);
+
+    /* store either in the user's structure or in other_props */
+    if (elem->store_prop[j])
+      elem_data = elem_ptr;
+    else
+      elem_data = other_data;
+
+    if (prop->is_list == PLY_LIST) {          /* list */
+
+      /* get and store the number of items in the list */
+      get_binary_item (plyfile, prop->count_external,
+                      &int_val, &uint_val, &double_val);
+      if (store_it) {
+        item = elem_data + prop->count_offset;
+        store_item(item, prop->count_internal, int_val, uint_val, double_val);
+      }
+
+      /* allocate space for an array of items and store a ptr to the array */
+      list_count = int_val;
+      item_size = ply_type_size[prop->internal_type];
+      store_array = (char **) (elem_data + prop->offset);
+      if (list_count == 0) {
+        if (store_it)
+          *store_array = NULL;
+      }
+      else {
+        if (store_it) {
+          item_ptr = element_alloc (plyfile, (size_t) item_size * list_count);
+          item = item_ptr;
+          *store_array = item_ptr;
+        }
+
+        /* read items and store them into the array */
+        for (k = 0; k < list_count; k++) {
+          get_binary_item (plyfile, prop->external_type,
+                          &int_val, &uint_val, &double_val);
+          if (store_it) {
+            store_item (item, prop->internal_type,
+                        int_val, uint_val, double_val);
+            item += item_size;
+          }
+        }
+      }
+
+    }
+    else if (prop->is_list == PLY_STRING) {     /* string */
+      int len;
+      unsigned int ulen;
+      double dlen;
+      char *str;
+      get_binary_item (plyfile, Int32, &len, &ulen, &dlen);
+      str = element_alloc (plyfile, len);
+      read_binary_bytes (plyfile, str, len);
+      if (store_it) {
+	char **str_ptr;
+        item = elem_data + prop->offset;
+	str_ptr = (char **) item;
+	*str_ptr = str;
+      }
+    }
+    else {                                      /* scalar */
+      get_binary_item (plyfile, prop->external_type,
+                      &int_val, &uint_val, &double_val);
+      if (store_it) {
+        item = elem_data + prop->offset;
+        store_item (item, prop->internal_type, int_val, uint_val, double_val);
+      }
+    }
+
+  }
+}
+
+
+/******************************************************************************
+Write to a file the word that represents a PLY data type.
+
+Entry:
+  fp   - file pointer
+  code - code for type
+******************************************************************************/
+
+void write_scalar_type (FILE *fp, int code)
+{
+  /* make sure this is a valid code */
+
+  if (code <= StartType || code >= EndType) {
+    fprintf (stderr, "write_scalar_type: bad data code = %d\n", code);
+    exit (-1);
+  }
+
+  /* write the code to a file */
+
+  fprintf (fp, "%s", type_names[code]);
+}
+
+
+/******************************************************************************
+Get a text line from a file and break it up into words.
+
+IMPORTANT: The calling routine should call "free" on the returned pointer once
+finished with it.
+
+Entry:
+  fp - file to read from
+
+Exit:
+  nwords    - number of words returned
+  orig_line - the original line of characters
+  returns a list of words from the line, or NULL if end-of-file
+******************************************************************************/
+
+char **get_words(FILE *fp, int *nwords, char **orig_line)
+{
+#define BIG_STRING 4096
+  int i,j;
+  /* one line per thread, so that several files can be read at once */
+  static thread_local char str[BIG_STRING];
+  static thread_local char str_copy[BIG_STRING];
+  char **words;
+  int max_words = 10;
+  int num_words = 0;
+  char *ptr,*ptr2;
+  char *result;
+
+  words = (char **) myalloc (sizeof (char *) * max_words);
+
+  /* read in a line */
+  result = fgets (str, BIG_STRING, fp);
+  if (result == NULL) {
+    *nwords = 0;
+    *orig_line = NULL;
+    return (NULL);
+  }
+
+  /* convert line-feed and tabs into spaces */
+  /* (this guarentees that there will be a space before the */
+  /*  null character at the end of the string) */
+
+  str[BIG_STRING-2] = ' ';
+  str[BIG_STRING-1] = '\0';
+
+  for (ptr = str, ptr2 = str_copy; *ptr != '\0'; ptr++, ptr2++) {
+    *ptr2 = *ptr;
+    if (*ptr == '\t') {
+      *ptr = ' ';
+      *ptr2 = ' ';
+    }
+    else if (*ptr == '\n') {
+      *ptr = ' ';
+      *ptr2 = '\0';
+      break;
+    }
+  }
+
+  /* find the words in the line */
+
+  ptr = str;
+  while (*ptr != '\0') {
+
+    /* jump over leading spaces */
+    while (*ptr == ' ')
+      ptr++;
+
+    /* break if we reach the end */
+    if (*ptr == '\0')
+      break;
+
+    /* allocate more room for words if necessary */
+    if (num_words >= max_words) {
+      max_words += 10;
+      words = (char **) realloc (words, sizeof (char *) * max_words);
+    }
+
+    if (*ptr == '\"') {  /* a quote indidicates that we have a string */
+
+      /* skip over leading quote */
+      ptr++;
+
+      /* save pointer to beginning of word */
+      words[num_words++] = ptr;
+
+      /* find trailing quote or end of line */
+      while (*ptr != '\"' && *ptr != '\0')
+        ptr++;
+
+      /* replace quote with a null character to mark the end of the word */
+      /* if we are not already at the end of the line */
+      if (*ptr != '\0')
+	*ptr++ = '\0';
+    }
+    else {               /* non-string */
+
+      /* save pointer to beginning of word */
+      words[num_words++] = ptr;
+
+      /* jump over non-spaces */
+      while (*ptr != ' ')
+	ptr++;
 
       /* place a null character here to mark the end of the word */
       *ptr++ = '\0';
@@ -1937,64 +2323,103 @@ void write_binary_item(
 
 
 /******************************************************************************
-Write out an item to a file as ascii characters.
+Format an item as ascii characters, followed by a space.  Floating point
+values are given in the fewest digits that read back as the same value, of
+the precision of the file's type, and integers by std::to_chars(), so the
+text doesn't depend on the locale.
 
 Entry:
-  fp         - file to write to
+  ptr        - where to put the text, with room for MAX_ASCII_ITEM characters
   int_val    - integer version of item
   uint_val   - unsigned integer version of item
   double_val - double-precision float version of item
   type       - data type to write out
+
+Exit:
+  returns the position just past the space
 ******************************************************************************/
 
-void write_ascii_item(
-  FILE *fp,
+static char *format_ascii_item(
+  char *ptr,
   int int_val,
   unsigned int uint_val,
   double double_val,
   int type
 )
 {
+  char *end = ptr + MAX_ASCII_ITEM - 1;
+
   switch (type) {
     case Int8:
     case Int16:
     case Int32:
-      fprintf (fp, "%d ", int_val);
+      ptr = std::to_chars (ptr, end, int_val).ptr;
       break;
     case Uint8:
     case Uint16:
     case Uint32:
-      fprintf (fp, "%u ", uint_val);
+      ptr = std::to_chars (ptr, end, uint_val).ptr;
       break;
     case Float32:
+      ptr = std::to_chars (ptr, end, (float) double_val).ptr;
+      break;
     case Float64:
-      fprintf (fp, "%g ", double_val);
+      ptr = std::to_chars (ptr, end, double_val).ptr;
       break;
     default:
       fprintf (stderr, "write_ascii_item: bad type = %d\n", type);
       exit (-1);
   }
+
+  *ptr++ = ' ';
+  return (ptr);
 }
 
 
 /******************************************************************************
-Get the value of an item that is in memory, and place the result
-into an integer, an unsigned integer and a double.
+Write out an item to a file as ascii characters.
 
 Entry:
-  ptr  - pointer to the item
-  type - data type supposedly in the item
-
-Exit:
-  int_val    - integer value
-  uint_val   - unsigned integer value
-  double_val - double-precision floating point value
+  fp         - file to write to
+  int_val    - integer version of item
+  uint_val   - unsigned integer version of item
+  double_val - double-precision float version of item
+  type       - data type to write out
 ******************************************************************************/
 
-void get_stored_item(
-  void *ptr,
-  int type,
-  int *int_val,
+void write_ascii_item(
+  FILE *fp,
+  int int_val,
+  unsigned int uint_val,
+  double double_val,
+  int type
+)
+{
+  char text[MAX_ASCII_ITEM];
+  char *end = format_ascii_item (text, int_val, uint_val, double_val, type);
+
+  fwrite (text, 1, end - text, fp);
+}
+
+
+/******************************************************************************
+Get the value of an item that is in memory, and place the result
+into an integer, an unsigned integer and a double.
+
+Entry:
+  ptr  - pointer to the item
+  type - data type supposedly in the item
+
+Exit:
+  int_val    - integer value
+  uint_val   - unsigned integer value
+  double_val - double-precision floating point value
+******************************************************************************/
+
+void get_stored_item(
+  void *ptr,
+  int type,
+  int *int_val,
   unsigned int *uint_val,
   double *double_val
 )
@@ -2048,11 +2473,742 @@ void get_stored_item(
 
 
 /******************************************************************************
-Get the value of an item from a binary file, and place the result
+Return the binary file type whose byte order matches this machine's.
+******************************************************************************/
+
+static int native_binary_type()
+{
+  int test = 1;
+
+  if (*((char *) &test) == 1)
+    return (PLY_BINARY_LE);
+  else
+    return (PLY_BINARY_BE);
+}
+
+
+/******************************************************************************
+Copy an item of a given size, reversing the order of its bytes.
+
+Entry:
+  src  - item to copy
+  size - size of the item in bytes
+
+Exit:
+  dst - byte-swapped copy of the item
+******************************************************************************/
+
+static void swap_bytes(char *dst, char *src, int size)
+{
+  int i;
+
+  for (i = 0; i < size; i++)
+    dst[i] = src[size - 1 - i];
+}
+
+
+/******************************************************************************
+Read raw bytes from the body of a binary file, out of the memory-mapped view
+when there is one and from the file otherwise.
+
+Entry:
+  plyfile - file identifier
+  nbytes  - number of bytes to read
+
+Exit:
+  ptr - the bytes that were read
+******************************************************************************/
+
+void read_binary_bytes(PlyFile *plyfile, void *ptr, int nbytes)
+{
+  if (plyfile->map_base != NULL) {
+    if (plyfile->map_ptr + nbytes > plyfile->map_base + plyfile->map_size) {
+      fprintf (stderr, "ply_get_element: unexpected end of file\n");
+      exit (-1);
+    }
+    memcpy (ptr, plyfile->map_ptr, nbytes);
+    plyfile->map_ptr += nbytes;
+  }
+  else
+    fread (ptr, nbytes, 1, plyfile->fp);
+}
+
+
+/******************************************************************************
+Get the value of an item from a binary file, and place the result
+into an integer, an unsigned integer and a double.  Items are byte-swapped
+when the file was written on a machine with the other byte order.
+
+Entry:
+  plyfile - file to get item from
+  type    - data type supposedly in the word
+
+Exit:
+  int_val    - integer value
+  uint_val   - unsigned integer value
+  double_val - double-precision floating point value
+******************************************************************************/
+
+void get_binary_item(
+  PlyFile *plyfile,
+  int type,
+  int *int_val,
+  unsigned int *uint_val,
+  double *double_val
+)
+{
+  char c[8];
+  char swapped[8];
+  void *ptr;
+  int size;
+
+  if (type <= StartType || type >= EndType) {
+    fprintf (stderr, "get_binary_item: bad type = %d\n", type);
+    exit (-1);
+  }
+
+  size = ply_type_size[type];
+  read_binary_bytes (plyfile, c, size);
+
+  if (plyfile->file_type != native_binary_type ()) {
+    swap_bytes (swapped, c, size);
+    ptr = (void *) swapped;
+  }
+  else
+    ptr = (void *) c;
+
+  get_stored_item (ptr, type, int_val, uint_val, double_val);
+}
+
+
+/******************************************************************************
+Convert a column of binary items, such as the x coordinate of every vertex
+in a run of fixed-layout elements, from one data type and stride to
+another.  The common case of a column whose type is the same in the file
+and in memory is a plain strided copy (with the bytes reversed if need be),
+which the compiler can unroll and vectorize; any other pair of types goes
+through get_stored_item() and store_item().
+
+Entry:
+  src        - first item of the column in the file
+  src_stride - bytes from one item of the column to the next in the file
+  src_type   - data type in the file
+  dst_stride - bytes from one item of the column to the next in memory
+  dst_type   - data type in memory
+  count      - number of items in the column
+  swap       - whether the file's byte order differs from this machine's
+
+Exit:
+  dst - converted column
+******************************************************************************/
+
+static void decode_column(
+  char *src,
+  size_t src_stride,
+  int src_type,
+  char *dst,
+  size_t dst_stride,
+  int dst_type,
+  int count,
+  int swap
+)
+{
+  int i;
+  int size = ply_type_size[src_type];
+  char tmp[8];
+  int int_val;
+  unsigned int uint_val;
+  double double_val;
+
+  if (src_type == dst_type && !swap) {
+    switch (size) {
+      case 1:
+        for (i = 0; i < count; i++)
+          dst[i * dst_stride] = src[i * src_stride];
+        break;
+      case 2:
+        for (i = 0; i < count; i++)
+          memcpy (dst + i * dst_stride, src + i * src_stride, 2);
+        break;
+      case 4:
+        for (i = 0; i < count; i++)
+          memcpy (dst + i * dst_stride, src + i * src_stride, 4);
+        break;
+      case 8:
+        for (i = 0; i < count; i++)
+          memcpy (dst + i * dst_stride, src + i * src_stride, 8);
+        break;
+    }
+    return;
+  }
+
+  if (src_type == dst_type) {
+    for (i = 0; i < count; i++)
+      swap_bytes (dst + i * dst_stride, src + i * src_stride, size);
+    return;
+  }
+
+  for (i = 0; i < count; i++) {
+    if (swap)
+      swap_bytes (tmp, src + i * src_stride, size);
+    else
+      memcpy (tmp, src + i * src_stride, size);
+    get_stored_item ((void *) tmp, src_type, &int_val, &uint_val, &double_val);
+    store_item (dst + i * dst_stride, dst_type, int_val, uint_val, double_val);
+  }
+}
+
+
+/******************************************************************************
+Read a run of elements from a memory-mapped binary body when every element
+in the run is laid out the same way in the file: only scalar properties and
+lists, with each list as long in every element as it is in the first.  The
+properties are then decoded a column at a time, and the list items and the
+"other" properties of the whole run go into one allocation each.
+
+Entry:
+  plyfile    - file identifier
+  elem_array - array of the user's element structures
+  elem_size  - size of one of the user's structures
+  count      - number of elements to read
+
+Exit:
+  returns 1 if the run was read, or 0 if it doesn't have a fixed layout (in
+  which case nothing has been read)
+******************************************************************************/
+
+int binary_get_block(
+  PlyFile *plyfile,
+  char *elem_array,
+  int elem_size,
+  int count
+)
+{
+  int i,j,k;
+  PlyElement *elem = plyfile->which_elem;
+  PlyProperty *prop;
+  char *base = plyfile->map_ptr;
+  char *end = plyfile->map_base + plyfile->map_size;
+  int swap = (plyfile->file_type != native_binary_type ());
+  size_t record_size = 0;
+  size_t *file_offset;
+  int *list_length;
+  int length;
+  int fixed = 1;
+  char *other_block = NULL;
+  int other_flag;
+
+  if (count <= 0)
+    return (1);
+
+  /* work out the layout of the first element in the file */
+
+  file_offset = (size_t *) myalloc (sizeof (size_t) * elem->nprops);
+  list_length = (int *) myalloc (sizeof (int) * elem->nprops);
+
+  for (j = 0; j < elem->nprops && fixed; j++) {
+    prop = elem->props[j];
+    file_offset[j] = record_size;
+    if (prop->is_list == PLY_STRING)
+      fixed = 0;
+    else if (prop->is_list == PLY_LIST) {
+      if (base + record_size + ply_type_size[prop->count_external] > end) {
+        fixed = 0;
+        break;
+      }
+      decode_column (base + record_size, 0, prop->count_external,
+                     (char *) &length, 0, Int32, 1, swap);
+      if (length < 0)
+        fixed = 0;
+      list_length[j] = length;
+      record_size += ply_type_size[prop->count_external] +
+                     (size_t) length * ply_type_size[prop->external_type];
+    }
+    else
+      record_size += ply_type_size[prop->external_type];
+  }
+
+  /* the run must fit in the file, and every list must match the first */
+
+  if (fixed && (record_size == 0 || (size_t) (end - base) / record_size < (size_t) count))
+    fixed = 0;
+
+  for (j = 0; j < elem->nprops && fixed; j++) {
+    prop = elem->props[j];
+    if (prop->is_list != PLY_LIST)
+      continue;
+    for (i = 0; i < count; i++) {
+      decode_column (base + i * record_size + file_offset[j], 0,
+                     prop->count_external, (char *) &length, 0, Int32, 1, swap);
+      if (length != list_length[j]) {
+        fixed = 0;
+        break;
+      }
+    }
+  }
+
+  if (!fixed) {
+    free (file_offset);
+    free (list_length);
+    return (0);
+  }
+
+  /* make room for the other_props of the whole run */
+
+  if (elem->other_offset != NO_OTHER_PROPS) {
+    other_flag = 1;
+    other_block = element_alloc (plyfile, (size_t) elem->other_size * count);
+    for (i = 0; i < count; i++)
+      *((char **) (elem_array + (size_t) i * elem_size + elem->other_offset)) =
+        other_block + (size_t) i * elem->other_size;
+  }
+  else
+    other_flag = 0;
+
+  /* decode each property of the run as a column */
+
+  for (j = 0; j < elem->nprops; j++) {
+
+    char *dst;
+    size_t dst_stride;
+    char *src = base + file_offset[j];
+
+    prop = elem->props[j];
+
+    if (elem->store_prop[j]) {
+      dst = elem_array;
+      dst_stride = elem_size;
+    }
+    else if (other_flag) {
+      dst = other_block;
+      dst_stride = elem->other_size;
+    }
+    else
+      continue;
+
+    if (prop->is_list == PLY_LIST) {
+      int count_size = ply_type_size[prop->count_external];
+      int item_size = ply_type_size[prop->internal_type];
+      int file_item_size = ply_type_size[prop->external_type];
+      char *items;
+
+      length = list_length[j];
+      decode_column (src, record_size, prop->count_external,
+                     dst + prop->count_offset, dst_stride,
+                     prop->count_internal, count, swap);
+
+      if (length == 0) {
+        for (i = 0; i < count; i++)
+          *((char **) (dst + i * dst_stride + prop->offset)) = NULL;
+        continue;
+      }
+
+      items = element_alloc (plyfile, (size_t) item_size * length * count);
+      for (i = 0; i < count; i++)
+        *((char **) (dst + i * dst_stride + prop->offset)) =
+          items + (size_t) i * length * item_size;
+
+      for (k = 0; k < length; k++)
+        decode_column (src + count_size + k * file_item_size, record_size,
+                       prop->external_type, items + k * item_size,
+                       (size_t) length * item_size, prop->internal_type,
+                       count, swap);
+    }
+    else
+      decode_column (src, record_size, prop->external_type,
+                     dst + prop->offset, dst_stride, prop->internal_type,
+                     count, swap);
+  }
+
+  plyfile->map_ptr = base + record_size * count;
+
+  free (file_offset);
+  free (list_length);
+  return (1);
+}
+
+
+/******************************************************************************
+Convert an item from the program's data type to the file's, reversing the
+order of its bytes if the file's byte order differs from this machine's.
+
+Entry:
+  src      - item in memory
+  src_type - data type in memory
+  dst_type - data type in the file
+  swap     - whether to reverse the bytes
+
+Exit:
+  dst - item as it appears in the file
+  returns the number of bytes placed in dst
+******************************************************************************/
+
+static int encode_item(char *dst, char *src, int src_type, int dst_type, int swap)
+{
+  int size = ply_type_size[dst_type];
+  char tmp[8];
+  int int_val;
+  unsigned int uint_val;
+  double double_val;
+
+  if (src_type == dst_type)
+    memcpy (tmp, src, size);
+  else {
+    get_stored_item ((void *) src, src_type, &int_val, &uint_val, &double_val);
+    store_item (tmp, dst_type, int_val, uint_val, double_val);
+  }
+
+  if (swap)
+    swap_bytes (dst, tmp, size);
+  else
+    memcpy (dst, tmp, size);
+
+  return (size);
+}
+
+
+/******************************************************************************
+Find out how many bytes an element takes in a binary file.
+
+Entry:
+  elem     - description of the element
+  elem_ptr - the user's structure for the element
+******************************************************************************/
+
+static size_t binary_element_size(PlyElement *elem, char *elem_ptr)
+{
+  int j;
+  PlyProperty *prop;
+  char *elem_data;
+  int int_val;
+  unsigned int uint_val;
+  double double_val;
+  size_t nbytes = 0;
+
+  for (j = 0; j < elem->nprops; j++) {
+    prop = elem->props[j];
+    if (elem->store_prop[j] == OTHER_PROP)
+      elem_data = *((char **) (elem_ptr + elem->other_offset));
+    else
+      elem_data = elem_ptr;
+    if (prop->is_list == PLY_LIST) {
+      get_stored_item ((void *) (elem_data + prop->count_offset),
+                       prop->count_internal, &int_val, &uint_val, &double_val);
+      nbytes += ply_type_size[prop->count_external] +
+                (size_t) uint_val * ply_type_size[prop->external_type];
+    }
+    else if (prop->is_list == PLY_STRING)
+      nbytes += sizeof (int) + strlen (*((char **) (elem_data + prop->offset))) + 1;
+    else
+      nbytes += ply_type_size[prop->external_type];
+  }
+
+  return (nbytes);
+}
+
+
+/******************************************************************************
+Encode an element as it goes in a binary file, into as many bytes as
+binary_element_size() gives.
+
+Entry:
+  elem     - description of the element
+  elem_ptr - the user's structure for the element
+  dst      - where to put the bytes
+  swap     - whether to reverse the bytes of each item
+
+Exit:
+  returns the position just past the last byte written
+******************************************************************************/
+
+static char *encode_element(PlyElement *elem, char *elem_ptr, char *dst, int swap)
+{
+  int j,k;
+  PlyProperty *prop;
+  char *elem_data;
+  char *item;
+  int int_val;
+  unsigned int uint_val;
+  double double_val;
+  int list_count;
+  int len;
+
+  for (j = 0; j < elem->nprops; j++) {
+    prop = elem->props[j];
+    if (elem->store_prop[j] == OTHER_PROP)
+      elem_data = *((char **) (elem_ptr + elem->other_offset));
+    else
+      elem_data = elem_ptr;
+
+    if (prop->is_list == PLY_LIST) {
+      int item_size = ply_type_size[prop->internal_type];
+      get_stored_item ((void *) (elem_data + prop->count_offset),
+                       prop->count_internal, &int_val, &uint_val, &double_val);
+      list_count = uint_val;
+      dst += encode_item (dst, elem_data + prop->count_offset,
+                          prop->count_internal, prop->count_external, swap);
+      item = *((char **) (elem_data + prop->offset));
+      for (k = 0; k < list_count; k++) {
+        dst += encode_item (dst, item, prop->internal_type,
+                            prop->external_type, swap);
+        item += item_size;
+      }
+    }
+    else if (prop->is_list == PLY_STRING) {
+      char *str = *((char **) (elem_data + prop->offset));
+      len = strlen (str) + 1;
+      dst += encode_item (dst, (char *) &len, Int32, Int32, swap);
+      memcpy (dst, str, len);
+      dst += len;
+    }
+    else
+      dst += encode_item (dst, elem_data + prop->offset,
+                          prop->internal_type, prop->external_type, swap);
+  }
+
+  return (dst);
+}
+
+
+/******************************************************************************
+Write a single element to a binary file, in the byte order named by the
+file's type.
+
+Entry:
+  plyfile  - file identifier
+  elem_ptr - the user's structure for the element
+******************************************************************************/
+
+static void binary_put_element(PlyFile *plyfile, char *elem_ptr)
+{
+  PlyElement *elem = plyfile->which_elem;
+  int swap = (plyfile->file_type != native_binary_type ());
+  size_t nbytes = binary_element_size (elem, elem_ptr);
+  char small[256];
+  char *buffer = (nbytes > sizeof (small)) ? (char *) myalloc (nbytes) : small;
+
+  encode_element (elem, elem_ptr, buffer, swap);
+  fwrite (buffer, 1, nbytes, plyfile->fp);
+
+  if (buffer != small)
+    free (buffer);
+}
+
+
+/******************************************************************************
+Write a run of elements to a binary file.  The elements are encoded into a
+large staging buffer that goes to the file with a single fwrite() each time
+it fills up, and the items are written in the byte order named by the
+file's type.
+
+Entry:
+  plyfile    - file identifier
+  elem_array - array of the user's element structures
+  elem_size  - size of one of the user's structures
+  count      - number of elements to write
+******************************************************************************/
+
+void binary_put_block(
+  PlyFile *plyfile,
+  char *elem_array,
+  int elem_size,
+  int count
+)
+{
+  int i;
+  FILE *fp = plyfile->fp;
+  PlyElement *elem = plyfile->which_elem;
+  int swap = (plyfile->file_type != native_binary_type ());
+  char *buffer = (char *) myalloc (WRITE_BUFFER_SIZE);
+  char *ptr = buffer;
+  char *elem_ptr;
+  size_t nbytes;
+
+  for (i = 0; i < count; i++) {
+
+    elem_ptr = elem_array + (size_t) i * elem_size;
+    nbytes = binary_element_size (elem, elem_ptr);
+
+    if (nbytes > (size_t) (buffer + WRITE_BUFFER_SIZE - ptr)) {
+      fwrite (buffer, 1, ptr - buffer, fp);
+      ptr = buffer;
+    }
+
+    /* an element too big for the buffer is written on its own */
+    if (nbytes > WRITE_BUFFER_SIZE)
+      binary_put_element (plyfile, elem_ptr);
+    else
+      ptr = encode_element (elem, elem_ptr, ptr, swap);
+  }
+
+  fwrite (buffer, 1, ptr - buffer, fp);
+  free (buffer);
+}
+
+
+/******************************************************************************
+Text that a thread is building up for an ascii file.
+******************************************************************************/
+
+typedef struct PlyText {
+  char *data;
+  size_t used;
+  size_t size;
+} PlyText;
+
+/* make room for n more characters, returning where they go */
+static char *reserve_text(PlyText *text, size_t n)
+{
+  if (text->used + n > text->size) {
+    text->size = 2 * text->size + n;
+    text->data = (char *) realloc (text->data, text->size);
+    if (text->data == NULL) {
+      fprintf (stderr, "Memory allocation bombed on line %d in %s\n",
+               __LINE__, __FILE__);
+      exit (-1);
+    }
+  }
+  return (text->data + text->used);
+}
+
+
+/******************************************************************************
+Format an element as a line of an ascii file, just as put_element_ply()
+writes it.
+
+Entry:
+  elem     - description of the element
+  elem_ptr - the user's structure
+  text     - text to add the line to
+******************************************************************************/
+
+static void format_ascii_element(PlyElement *elem, char *elem_ptr, PlyText *text)
+{
+  int j,k;
+  PlyProperty *prop;
+  char *elem_data;
+  char *item;
+  char *ptr;
+  int int_val;
+  unsigned int uint_val;
+  double double_val;
+  int list_count;
+
+  for (j = 0; j < elem->nprops; j++) {
+    prop = elem->props[j];
+    if (elem->store_prop[j] == OTHER_PROP)
+      elem_data = *((char **) (elem_ptr + elem->other_offset));
+    else
+      elem_data = elem_ptr;
+
+    if (prop->is_list == PLY_LIST) {
+      int item_size = ply_type_size[prop->internal_type];
+      get_stored_item ((void *) (elem_data + prop->count_offset),
+                       prop->count_internal, &int_val, &uint_val, &double_val);
+      list_count = uint_val;
+      ptr = reserve_text (text, (size_t) MAX_ASCII_ITEM * (list_count + 1));
+      ptr = format_ascii_item (ptr, int_val, uint_val, double_val,
+                               prop->count_external);
+      item = *((char **) (elem_data + prop->offset));
+      for (k = 0; k < list_count; k++) {
+        get_stored_item ((void *) item, prop->internal_type,
+                         &int_val, &uint_val, &double_val);
+        ptr = format_ascii_item (ptr, int_val, uint_val, double_val,
+                                 prop->external_type);
+        item += item_size;
+      }
+    }
+    else if (prop->is_list == PLY_STRING) {
+      char *str = *((char **) (elem_data + prop->offset));
+      size_t len = strlen (str);
+      ptr = reserve_text (text, len + 2);
+      *ptr++ = '"';
+      memcpy (ptr, str, len);
+      ptr += len;
+      *ptr++ = '"';
+    }
+    else {
+      ptr = reserve_text (text, MAX_ASCII_ITEM);
+      get_stored_item ((void *) (elem_data + prop->offset),
+                       prop->internal_type, &int_val, &uint_val, &double_val);
+      ptr = format_ascii_item (ptr, int_val, uint_val, double_val,
+                               prop->external_type);
+    }
+
+    text->used = ptr - text->data;
+  }
+
+  ptr = reserve_text (text, 1);
+  *ptr = '\n';
+  text->used++;
+}
+
+
+/******************************************************************************
+Write a run of elements to an ascii file.  The run is cut into consecutive
+shares, one for each thread, and every thread formats its share into text of
+its own; the texts are then written out in order.  Each element's text
+depends on nothing but the element, so the file is the same for any number
+of threads.
+
+Entry:
+  plyfile    - file identifier
+  elem_array - array of the user's element structures
+  elem_size  - size of one of the user's structures
+  count      - number of elements to write
+******************************************************************************/
+
+void ascii_put_block(
+  PlyFile *plyfile,
+  char *elem_array,
+  int elem_size,
+  int count
+)
+{
+  int i;
+  int first;
+  PlyElement *elem = plyfile->which_elem;
+  int nthreads = parallel_thread_count (count / MIN_ASCII_WRITE);
+  int share = (count + nthreads - 1) / nthreads;
+  PlyText *texts;
+
+  if (share > MAX_ASCII_WRITE)
+    share = MAX_ASCII_WRITE;
+
+  texts = (PlyText *) myalloc (sizeof (PlyText) * nthreads);
+  for (i = 0; i < nthreads; i++) {
+    texts[i].data = NULL;
+    texts[i].used = texts[i].size = 0;
+  }
+
+  for (first = 0; first < count; first += share * nthreads) {
+
+    parallel_for (nthreads, [&](int t) {
+      size_t start = (size_t) first + (size_t) share * t;
+      size_t stop = start + share;
+      if (stop > (size_t) count)
+        stop = count;
+      texts[t].used = 0;
+      for (size_t k = start; k < stop; k++)
+        format_ascii_element (elem, elem_array + k * elem_size, &texts[t]);
+    });
+
+    for (i = 0; i < nthreads; i++)
+      fwrite (texts[i].data, 1, texts[i].used, plyfile->fp);
+  }
+
+  for (i = 0; i < nthreads; i++)
+    free (texts[i].data);
+  free (texts);
+}
+
+
+/******************************************************************************
+Extract the value of an item from an ascii word, and place the result
 into an integer, an unsigned integer and a double.
 
 Entry:
-  fp   - file to get item from
+  word - word to extract value from
   type - data type supposedly in the word
 
 Exit:
@@ -2061,82 +3217,233 @@ Exit:
   double_val - double-precision floating point value
 ******************************************************************************/
 
-void get_binary_item(
-  FILE *fp,
+void get_ascii_item(
+  char *word,
   int type,
   int *int_val,
   unsigned int *uint_val,
   double *double_val
 )
 {
-  char c[8];
-  void *ptr;
-
-  ptr = (void *) c;
-
   switch (type) {
     case Int8:
-      fread (ptr, 1, 1, fp);
-      *int_val = *((char *) ptr);
-      *uint_val = *int_val;
-      *double_val = *int_val;
-      break;
     case Uint8:
-      fread (ptr, 1, 1, fp);
-      *uint_val = *((unsigned char *) ptr);
-      *int_val = *uint_val;
-      *double_val = *uint_val;
-      break;
     case Int16:
-      fread (ptr, 2, 1, fp);
-      *int_val = *((short int *) ptr);
-      *uint_val = *int_val;
-      *double_val = *int_val;
-      break;
     case Uint16:
-      fread (ptr, 2, 1, fp);
-      *uint_val = *((unsigned short int *) ptr);
-      *int_val = *uint_val;
-      *double_val = *uint_val;
-      break;
     case Int32:
-      fread (ptr, 4, 1, fp);
-      *int_val = *((int *) ptr);
+      *int_val = atoi (word);
       *uint_val = *int_val;
       *double_val = *int_val;
       break;
+
     case Uint32:
-      fread (ptr, 4, 1, fp);
-      *uint_val = *((unsigned int *) ptr);
+      *uint_val = strtoul (word, (char **) NULL, 10);
       *int_val = *uint_val;
       *double_val = *uint_val;
       break;
+
     case Float32:
-      fread (ptr, 4, 1, fp);
-      *double_val = *((float *) ptr);
-      *int_val = *double_val;
-      *uint_val = *double_val;
-      break;
     case Float64:
-      fread (ptr, 8, 1, fp);
-      *double_val = *((double *) ptr);
-      *int_val = *double_val;
-      *uint_val = *double_val;
+      *double_val = atof (word);
+      *int_val = (int) *double_val;
+      *uint_val = (unsigned int) *double_val;
       break;
+
     default:
-      fprintf (stderr, "get_binary_item: bad type = %d\n", type);
+      fprintf (stderr, "get_ascii_item: bad type = %d\n", type);
       exit (-1);
   }
 }
 
 
 /******************************************************************************
-Extract the value of an item from an ascii word, and place the result
-into an integer, an unsigned integer and a double.
+Convert the digits at a position in a memory-mapped body into a double.
+
+This takes the place of atof() for mapped bodies.  The C library routines
+need a null-terminated word and honor the current locale's decimal point,
+whereas PLY always uses '.'.  Up to 19 significant digits are gathered into
+an integer; when that integer and the power of ten are both exactly
+representable the product is correctly rounded.  Otherwise the word is
+handed to std::from_chars(), which is slower but also correctly rounded, so
+a double written in its shortest form reads back as the same double.
+
+The words "inf", "infinity" and "nan", in any case and with an optional
+sign, are taken as atof() takes them.
 
 Entry:
-  word - word to extract value from
-  type - data type supposedly in the word
+  cursor - position of the first character of the word
+  end    - end of the mapped view
+
+Exit:
+  cursor - position just past the last character used
+  returns the value, or zero if the word does not start with a number
+******************************************************************************/
+
+/* if the characters at a position spell a word, in any case, step past it */
+static int match_word(char **cursor, char *end, const char *word)
+{
+  char *ptr = *cursor;
+
+  for (; *word != '\0'; word++, ptr++)
+    if (ptr == end || (*ptr | 0x20) != *word)
+      return (0);
+
+  *cursor = ptr;
+  return (1);
+}
+
+static const double pow10_table[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+double ascii_to_double(char **cursor, char *end)
+{
+  char *ptr = *cursor;
+  int negative = 0;
+  unsigned long long mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  double value;
+
+  if (ptr < end && (*ptr == '-' || *ptr == '+')) {
+    negative = (*ptr == '-');
+    ptr++;
+  }
+  char *start = ptr;
+
+  if (match_word (&ptr, end, "infinity") || match_word (&ptr, end, "inf")) {
+    *cursor = ptr;
+    return (negative ? -HUGE_VAL : HUGE_VAL);
+  }
+  if (match_word (&ptr, end, "nan")) {
+    *cursor = ptr;
+    return (negative ? -NAN : NAN);
+  }
+
+  /* integer part; digits past the 19th only scale the value */
+  for (; ptr < end && *ptr >= '0' && *ptr <= '9'; ptr++) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*ptr - '0');
+      if (mantissa != 0)
+        digits++;
+    }
+    else
+      exponent++;
+  }
+
+  /* fractional part */
+  if (ptr < end && *ptr == '.') {
+    for (ptr++; ptr < end && *ptr >= '0' && *ptr <= '9'; ptr++) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*ptr - '0');
+        if (mantissa != 0)
+          digits++;
+        exponent--;
+      }
+    }
+  }
+
+  /* exponent */
+  if (ptr < end && (*ptr == 'e' || *ptr == 'E')) {
+    int exp_negative = 0;
+    int exp_value = 0;
+    ptr++;
+    if (ptr < end && (*ptr == '-' || *ptr == '+')) {
+      exp_negative = (*ptr == '-');
+      ptr++;
+    }
+    for (; ptr < end && *ptr >= '0' && *ptr <= '9'; ptr++)
+      if (exp_value < 10000)
+        exp_value = exp_value * 10 + (*ptr - '0');
+    exponent += exp_negative ? -exp_value : exp_value;
+  }
+
+  *cursor = ptr;
+
+  value = (double) mantissa;
+  if (mantissa == 0)
+    value = 0.0;
+  else if (mantissa <= (1ULL << 53) && exponent >= 0 && exponent <= 22)
+    value *= pow10_table[exponent];
+  else if (mantissa <= (1ULL << 53) && exponent < 0 && exponent >= -22)
+    value /= pow10_table[-exponent];
+  else if (std::from_chars (start, ptr, value).ec != std::errc ())
+    value = (double) mantissa * pow (10.0, (double) exponent);
+
+  return (negative ? -value : value);
+}
+
+
+/******************************************************************************
+Convert the digits at a position in a memory-mapped body into an integer.
+Like atoi() and strtoul(), this stops at the first character that is not a
+digit, so "3.0" reads as 3.
+
+Entry:
+  cursor - position of the first character of the word
+  end    - end of the mapped view
+
+Exit:
+  cursor - position just past the last digit
+  returns the value as a (possibly negative) 64-bit integer
+******************************************************************************/
+
+long long ascii_to_integer(char **cursor, char *end)
+{
+  char *ptr = *cursor;
+  int negative = 0;
+  long long value = 0;
+
+  if (ptr < end && (*ptr == '-' || *ptr == '+')) {
+    negative = (*ptr == '-');
+    ptr++;
+  }
+
+  for (; ptr < end && *ptr >= '0' && *ptr <= '9'; ptr++)
+    value = value * 10 + (*ptr - '0');
+
+  *cursor = ptr;
+  return (negative ? -value : value);
+}
+
+
+/******************************************************************************
+Skip over the spaces, tabs and line breaks in front of the next word of a
+memory-mapped body.
+
+Entry:
+  plyfile - file identifier
+
+Exit:
+  returns the start of the next word, exiting if there are no more words
+******************************************************************************/
+
+static char *skip_mapped_space(PlyFile *plyfile)
+{
+  char *ptr = plyfile->map_ptr;
+  char *end = plyfile->map_base + plyfile->map_size;
+
+  while (ptr < end && (*ptr == ' ' || *ptr == '\t' || *ptr == '\r' || *ptr == '\n'))
+    ptr++;
+
+  if (ptr == end) {
+    fprintf (stderr, "ply_get_element: unexpected end of file\n");
+    exit (-1);
+  }
+
+  plyfile->map_ptr = ptr;
+  return (ptr);
+}
+
+
+/******************************************************************************
+Extract the value of the next word of a memory-mapped body, and place the
+result into an integer, an unsigned integer and a double.
+
+Entry:
+  plyfile - file identifier
+  type    - data type supposedly in the word
 
 Exit:
   int_val    - integer value
@@ -2144,42 +3451,89 @@ Exit:
   double_val - double-precision floating point value
 ******************************************************************************/
 
-void get_ascii_item(
-  char *word,
+void get_mapped_ascii_item(
+  PlyFile *plyfile,
   int type,
   int *int_val,
   unsigned int *uint_val,
   double *double_val
 )
 {
+  char *ptr = skip_mapped_space (plyfile);
+  char *end = plyfile->map_base + plyfile->map_size;
+
   switch (type) {
     case Int8:
     case Uint8:
     case Int16:
     case Uint16:
     case Int32:
-      *int_val = atoi (word);
+      *int_val = (int) ascii_to_integer (&ptr, end);
       *uint_val = *int_val;
       *double_val = *int_val;
       break;
 
     case Uint32:
-      *uint_val = strtoul (word, (char **) NULL, 10);
+      *uint_val = (unsigned int) ascii_to_integer (&ptr, end);
       *int_val = *uint_val;
       *double_val = *uint_val;
       break;
 
     case Float32:
     case Float64:
-      *double_val = atof (word);
+      *double_val = ascii_to_double (&ptr, end);
       *int_val = (int) *double_val;
       *uint_val = (unsigned int) *double_val;
       break;
 
     default:
-      fprintf (stderr, "get_ascii_item: bad type = %d\n", type);
+      fprintf (stderr, "get_mapped_ascii_item: bad type = %d\n", type);
       exit (-1);
   }
+
+  /* step over whatever is left of the word */
+  while (ptr < end && *ptr != ' ' && *ptr != '\t' && *ptr != '\r' && *ptr != '\n')
+    ptr++;
+
+  plyfile->map_ptr = ptr;
+}
+
+
+/******************************************************************************
+Find the next word of a memory-mapped body.  As in get_words(), a word that
+starts with a quote runs up to the closing quote or the end of the line.
+
+Entry:
+  plyfile - file identifier
+
+Exit:
+  len - number of characters in the word
+  returns a pointer to the (unterminated) word inside the mapped view
+******************************************************************************/
+
+char *get_mapped_ascii_word(PlyFile *plyfile, int *len)
+{
+  char *ptr = skip_mapped_space (plyfile);
+  char *end = plyfile->map_base + plyfile->map_size;
+  char *word;
+
+  if (*ptr == '\"') {
+    word = ++ptr;
+    while (ptr < end && *ptr != '\"' && *ptr != '\n')
+      ptr++;
+    *len = (int) (ptr - word);
+    if (ptr < end && *ptr == '\"')
+      ptr++;
+  }
+  else {
+    word = ptr;
+    while (ptr < end && *ptr != ' ' && *ptr != '\t' && *ptr != '\r' && *ptr != '\n')
+      ptr++;
+    *len = (int) (ptr - word);
+  }
+
+  plyfile->map_ptr = ptr;
+  return (word);
 }
 
 
@@ -2408,44 +3762,233 @@ void add_obj_info (PlyFile *plyfile, char *line)
 }
 
 
-/******************************************************************************
-Copy a property.
-******************************************************************************/
+/******************************************************************************
+Copy a property.
+******************************************************************************/
+
+void copy_property(PlyProperty *dest, PlyProperty *src)
+{
+  dest->name = strdup (src->name);
+  dest->external_type = src->external_type;
+  dest->internal_type = src->internal_type;
+  dest->offset = src->offset;
+
+  dest->is_list = src->is_list;
+  dest->count_external = src->count_external;
+  dest->count_internal = src->count_internal;
+  dest->count_offset = src->count_offset;
+}
+
+
+/******************************************************************************
+Allocate some memory.
+
+Entry:
+  size  - amount of memory requested (in bytes)
+  lnum  - line number from which memory was requested
+  fname - file name from which memory was requested
+******************************************************************************/
+
+static char *my_alloc(size_t size, int lnum, char *fname)
+{
+  char *ptr;
+
+  ptr = (char *) malloc (size);
+
+  if (ptr == 0) {
+    fprintf(stderr, "Memory allocation bombed on line %d in %s\n", lnum, fname);
+  }
+
+  return (ptr);
+}
+
+
+/******************************************************************************
+Get room for the lists, strings or other_props of an element that is being
+read.  These come from the file's arena when it is in use, and are
+otherwise allocated one by one for the caller to free.
+
+Entry:
+  plyfile - file identifier
+  size    - amount of memory requested (in bytes)
+
+Exit:
+  returns the memory
+******************************************************************************/
+
+char *element_alloc(PlyFile *plyfile, size_t size)
+{
+  PlyArenaBlock *block = plyfile->arena;
+  char *ptr;
+
+  if (!plyfile->use_arena)
+    return ((char *) myalloc (size));
+
+  /* keep everything aligned well enough for a double */
+  size = (size + 15) & ~((size_t) 15);
+
+  if (block == NULL || block->size - block->used < size) {
+    size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+    size_t header_size = (sizeof (PlyArenaBlock) + 15) & ~((size_t) 15);
+    block = (PlyArenaBlock *) malloc (header_size + block_size);
+    if (block == NULL) {
+      fprintf (stderr, "Memory allocation bombed in element_alloc()\n");
+      exit (-1);
+    }
+    block->next = plyfile->arena;
+    block->size = header_size + block_size;
+    block->used = header_size;
+    plyfile->arena = block;
+  }
+
+  ptr = (char *) block + block->used;
+  block->used += size;
+  return (ptr);
+}
+
+
+/******************************************************************************
+Have the lists, strings and other_props of the elements read from a file
+from now on carved out of an arena that belongs to the file, instead of
+being allocated one at a time.  The arena is released all at once by
+free_arena_ply() (or free_ply()), so the caller copies out whatever it
+needs to keep and does not free any of it.  Elements read by
+get_other_element_ply() are kept out of the arena.
+
+Entry:
+  plyfile - file identifier
+******************************************************************************/
+
+void use_arena_ply(PlyFile *plyfile)
+{
+  plyfile->use_arena = 1;
+}
+
+
+/******************************************************************************
+Release the arena of a file, and with it the lists, strings and other_props
+of every element read while it was in use.
+
+Entry:
+  plyfile - file identifier
+******************************************************************************/
+
+void free_arena_ply(PlyFile *plyfile)
+{
+  PlyArenaBlock *block = plyfile->arena;
+
+  while (block != NULL) {
+    PlyArenaBlock *next = block->next;
+    free (block);
+    block = next;
+  }
+
+  plyfile->arena = NULL;
+}
+
+
+/******************************************************************************
+Find the room needed to copy the lists and strings of a run of "other"
+properties, such as those read while the file's arena is in use, which go
+away with the arena.
+
+Entry:
+  other - description of the other_props
+  block - other_props of "count" elements, one after another
+  count - number of elements
+
+Exit:
+  returns the number of bytes copy_other_lists_ply() needs
+******************************************************************************/
+
+size_t other_lists_size_ply(PlyOtherProp *other, char *block, int count)
+{
+  int i,k;
+  PlyProperty *prop;
+  char *data;
+  int int_val;
+  unsigned int uint_val;
+  double double_val;
+  size_t size = 0;
+
+  for (i = 0; i < other->nprops; i++) {
+
+    prop = other->props[i];
+    if (prop->is_list == PLY_SCALAR)
+      continue;
 
-void copy_property(PlyProperty *dest, PlyProperty *src)
-{
-  dest->name = strdup (src->name);
-  dest->external_type = src->external_type;
-  dest->internal_type = src->internal_type;
-  dest->offset = src->offset;
+    for (k = 0; k < count; k++) {
+      data = block + (size_t) k * other->size;
+      if (*(char **) (data + prop->offset) == NULL)
+        continue;
+      if (prop->is_list == PLY_LIST) {
+        get_stored_item ((void *) (data + prop->count_offset),
+                         prop->count_internal, &int_val, &uint_val, &double_val);
+        size += (size_t) ply_type_size[prop->internal_type] * uint_val;
+      }
+      else
+        size += strlen (*(char **) (data + prop->offset)) + 1;
 
-  dest->is_list = src->is_list;
-  dest->count_external = src->count_external;
-  dest->count_internal = src->count_internal;
-  dest->count_offset = src->count_offset;
+      /* each one starts where a double could */
+      size = (size + 7) & ~((size_t) 7);
+    }
+  }
+
+  return (size);
 }
 
 
 /******************************************************************************
-Allocate some memory.
+Copy the lists and strings of a run of "other" properties into storage of
+the caller's, and point the properties at the copies.
 
 Entry:
-  size  - amount of memory requested (in bytes)
-  lnum  - line number from which memory was requested
-  fname - file name from which memory was requested
+  other   - description of the other_props
+  block   - other_props of "count" elements, one after another
+  count   - number of elements
+  storage - other_lists_size_ply() bytes, kept as long as the block is
 ******************************************************************************/
 
-static char *my_alloc(int size, int lnum, char *fname)
+void copy_other_lists_ply(
+  PlyOtherProp *other,
+  char *block,
+  int count,
+  char *storage
+)
 {
-  char *ptr;
+  int i,k;
+  PlyProperty *prop;
+  char *data;
+  char *items;
+  size_t size;
+  int int_val;
+  unsigned int uint_val;
+  double double_val;
 
-  ptr = (char *) malloc (size);
+  for (i = 0; i < other->nprops; i++) {
 
-  if (ptr == 0) {
-    fprintf(stderr, "Memory allocation bombed on line %d in %s\n", lnum, fname);
-  }
+    prop = other->props[i];
+    if (prop->is_list == PLY_SCALAR)
+      continue;
 
-  return (ptr);
+    for (k = 0; k < count; k++) {
+      data = block + (size_t) k * other->size;
+      items = *(char **) (data + prop->offset);
+      if (items == NULL)
+        continue;
+      if (prop->is_list == PLY_LIST) {
+        get_stored_item ((void *) (data + prop->count_offset),
+                         prop->count_internal, &int_val, &uint_val, &double_val);
+        size = (size_t) ply_type_size[prop->internal_type] * uint_val;
+      }
+      else
+        size = strlen (items) + 1;
+
+      memcpy (storage, items, size);
+      *(char **) (data + prop->offset) = storage;
+      storage += (size + 7) & ~((size_t) 7);
+    }
+  }
 }
 
 
@@ -2476,10 +4019,68 @@ PlyFile *read_ply(FILE *fp)
 
   ply = ply_read (fp, &num_elems, &elem_names);
 
+  /* the names are also in the elements, so this list isn't kept */
+  if (ply != NULL) {
+    for (int i = 0; i < num_elems; i++)
+      free (elem_names[i]);
+    free (elem_names);
+  }
+
+  return (ply);
+}
+
+
+/******************************************************************************
+Find out what a PLY file holds without reading its body.  Only the header
+is read, so this costs the same for a file of any size.  The elements, their
+counts and their properties, the file type and the comments of the result
+are those of the file; it can't be read from, and is closed with free_ply().
+
+Entry:
+  filename - name of the file to probe
+
+Exit:
+  returns a description of the file, or NULL if it can't be opened or
+  isn't a PLY file
+******************************************************************************/
+
+PlyFile *probe_ply(char *filename)
+{
+  FILE *fp;
+  PlyFile *ply;
+
+  fp = fopen (filename, "rb");
+  if (fp == NULL)
+    return (NULL);
+
+  ply = read_header (fp);
+  fclose (fp);
+
+  if (ply != NULL)
+    ply->fp = NULL;
   return (ply);
 }
 
 
+/******************************************************************************
+Return how many elements of a given type a PLY file declares.
+
+Entry:
+  ply       - file that was read or probed
+  elem_name - name of the element
+
+Exit:
+  returns the count, or 0 if the file has no such element
+******************************************************************************/
+
+int get_element_count_ply(PlyFile *ply, char *elem_name)
+{
+  PlyElement *elem = find_element (ply, elem_name);
+
+  return (elem != NULL ? elem->num : 0);
+}
+
+
 /******************************************************************************
 Given a file pointer, get ready to write PLY data to the file.
 
@@ -2625,6 +4226,7 @@ Entry:
 
 void close_ply(PlyFile *plyfile)
 {
+  unmap_body_ply (plyfile);
   fclose (plyfile->fp);
 }
 
@@ -2639,10 +4241,131 @@ Entry:
 void free_ply(PlyFile *plyfile)
 {
   /* free up memory associated with the PLY file */
+  free_arena_ply (plyfile);
   free (plyfile);
 }
 
 
+/******************************************************************************
+Map a whole PLY file into memory so that its body can be read without going
+through stdio.  The header has already been read by get_words(), so the start
+of the body is found by looking for the "end_header" line in the mapped view.
+Nothing changes if the file cannot be mapped (a pipe, say, or a file too big
+for the address space), and the body is then read from the FILE as before.
+
+Entry:
+  plyfile - file identifier
+
+Exit:
+  returns 1 if the body is mapped, 0 if not
+******************************************************************************/
+
+int map_body_ply(PlyFile *plyfile)
+{
+  char *base;
+  char *ptr;
+  char *end;
+  size_t size;
+  void *handle = NULL;
+
+  if (plyfile->fp == NULL)
+    return (0);
+
+#ifdef _WIN32
+  {
+    HANDLE file = (HANDLE) _get_osfhandle (_fileno (plyfile->fp));
+    HANDLE mapping;
+    LARGE_INTEGER file_size;
+
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx (file, &file_size))
+      return (0);
+    if (file_size.QuadPart <= 0 ||
+        (unsigned long long) file_size.QuadPart > (size_t) -1)
+      return (0);
+
+    mapping = CreateFileMapping (file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+      return (0);
+
+    base = (char *) MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0);
+    if (base == NULL) {
+      CloseHandle (mapping);
+      return (0);
+    }
+
+    size = (size_t) file_size.QuadPart;
+    handle = (void *) mapping;
+  }
+#else
+  {
+    struct stat st;
+    int fd = fileno (plyfile->fp);
+
+    if (fstat (fd, &st) != 0 || !S_ISREG (st.st_mode) || st.st_size <= 0)
+      return (0);
+
+    base = (char *) mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base == (char *) MAP_FAILED)
+      return (0);
+
+    size = st.st_size;
+    madvise (base, size, MADV_SEQUENTIAL);
+  }
+#endif
+
+  plyfile->map_base = base;
+  plyfile->map_size = size;
+  plyfile->map_handle = handle;
+
+  /* find the line that starts with "end_header" */
+
+  end = base + size;
+  for (ptr = base; ptr + 10 <= end; ptr++)
+    if ((ptr == base || ptr[-1] == '\n') && memcmp (ptr, "end_header", 10) == 0)
+      break;
+
+  if (ptr + 10 > end) {
+    unmap_body_ply (plyfile);
+    return (0);
+  }
+
+  /* the body starts on the line after it */
+
+  while (ptr < end && *ptr != '\n')
+    ptr++;
+  if (ptr < end)
+    ptr++;
+
+  plyfile->map_ptr = ptr;
+  return (1);
+}
+
+
+/******************************************************************************
+Release the memory-mapped view of a PLY file, if there is one.
+
+Entry:
+  plyfile - file identifier
+******************************************************************************/
+
+void unmap_body_ply(PlyFile *plyfile)
+{
+  if (plyfile->map_base == NULL)
+    return;
+
+#ifdef _WIN32
+  UnmapViewOfFile (plyfile->map_base);
+  CloseHandle ((HANDLE) plyfile->map_handle);
+#else
+  munmap (plyfile->map_base, plyfile->map_size);
+#endif
+
+  plyfile->map_base = NULL;
+  plyfile->map_size = 0;
+  plyfile->map_ptr = NULL;
+}
+
+
 /******************************************************************************
 Specify the index of the next element to be read in from a PLY file.
 
@@ -2694,6 +4417,48 @@ void get_element_ply (PlyFile *plyfile, void *elem_ptr)
 }
 
 
+/******************************************************************************
+Read a run of elements from the file into an array of the user's structures.
+This has the same effect as calling get_element_ply() once for each of them,
+but when a binary body is memory-mapped and every element of the run has the
+same layout in the file (as vertices of float32 properties and triangles
+with a uint8/int32 index list always do), the run is read in bulk: each
+property is decoded for the whole run at once, and all of the run's list
+items (and "other" properties) are placed in a single allocation.  A long
+run from a memory-mapped ascii body is split on line boundaries and parsed
+on several threads.
+
+Entry:
+  plyfile    - file identifier
+  elem_array - array of at least "count" of the user's element structures
+  elem_size  - size in bytes of one of the user's structures
+  count      - number of elements to read
+******************************************************************************/
+
+void get_element_block_ply (
+  PlyFile *plyfile,
+  void *elem_array,
+  int elem_size,
+  int count
+)
+{
+  int i;
+  char *elem_data = (char *) elem_array;
+
+  if (plyfile->map_base != NULL) {
+    if (plyfile->file_type == PLY_ASCII) {
+      if (ascii_get_block (plyfile, elem_data, elem_size, count))
+        return;
+    }
+    else if (binary_get_block (plyfile, elem_data, elem_size, count))
+      return;
+  }
+
+  for (i = 0; i < count; i++)
+    get_element_ply (plyfile, (void *) (elem_data + (size_t) i * elem_size));
+}
+
+
 /******************************************************************************
 Specify one of several properties of the current element that is to be
 read from a file.  This should be called (usually multiple times) before a
@@ -3019,6 +4784,27 @@ PlyPropRules *init_rule_ply (PlyFile *ply, char *elem_name)
 }
 
 
+/******************************************************************************
+Free up storage used by the rules for an element.
+
+Entry:
+  rules - rules to free up, or NULL
+******************************************************************************/
+
+void free_rule_ply (PlyPropRules *rules)
+{
+  if (rules == NULL)
+    return;
+
+  free (rules->rule_list);
+  if (rules->max_props > 0) {
+    free (rules->props);
+    free (rules->weights);
+  }
+  free (rules);
+}
+
+
 /******************************************************************************
 Modify a property propagation rule.
 
@@ -3104,6 +4890,79 @@ void weight_props_ply (PlyFile *ply, float weight, void *other_props)
 }
 
 
+/******************************************************************************
+Combine the values of one property according to a propagation rule.
+
+Entry:
+  rule        - type of rule (AVERAGE_RULE, MINIMUM_RULE, etc.)
+  vals        - the values to combine
+  weights     - weights of the values
+  n           - number of values
+  random_pick - which value RANDOM_RULE is to choose
+
+Exit:
+  returns the combined value
+******************************************************************************/
+
+static double combine_values(
+  int rule,
+  double *vals,
+  float *weights,
+  int n,
+  int random_pick
+)
+{
+  int j;
+  double double_val;
+
+  switch (rule) {
+    case AVERAGE_RULE: {
+      double sum = 0;
+      double weight_sum = 0;
+      for (j = 0; j < n; j++) {
+        sum += vals[j] * weights[j];
+        weight_sum += weights[j];
+      }
+      double_val = sum / weight_sum;
+      break;
+    }
+    case MINIMUM_RULE: {
+      double_val = vals[0];
+      for (j = 1; j < n; j++)
+        if (double_val > vals[j])
+          double_val = vals[j];
+      break;
+    }
+    case MAXIMUM_RULE: {
+      double_val = vals[0];
+      for (j = 1; j < n; j++)
+        if (double_val < vals[j])
+          double_val = vals[j];
+      break;
+    }
+    case RANDOM_RULE: {
+      double_val = vals[random_pick];
+      break;
+    }
+    case SAME_RULE: {
+      double_val = vals[0];
+      for (j = 1; j < n; j++)
+        if (double_val != vals[j]) {
+          fprintf (stderr,
+    "get_new_props_ply: Error combining properties that should be the same.\n");
+          exit (-1);
+        }
+      break;
+    }
+    default:
+      fprintf (stderr, "get_new_props_ply: Bad rule = %d\n", rule);
+      exit (-1);
+  }
+
+  return (double_val);
+}
+
+
 /******************************************************************************
 Return a pointer to a new set of properties that have been created using
 a specified set of property combination rules and a given collection of
@@ -3116,8 +4975,8 @@ Exit:
 void *get_new_props_ply(PlyFile *ply)
 {
   int i,j;
-  static double *vals;
-  static int max_vals = 0;
+  static thread_local double *vals;
+  static thread_local int max_vals = 0;
   PlyPropRules *rules = ply->current_rules;
   PlyElement *elem = rules->elem;
   PlyProperty *prop;
@@ -3175,51 +5034,8 @@ void *get_new_props_ply(PlyFile *ply)
     }
 
     /* calculate the combined value */
-
-    switch (rules->rule_list[i]) {
-      case AVERAGE_RULE: {
-	double sum = 0;
-	double weight_sum = 0;
-	for (j = 0; j < rules->nprops; j++) {
-	  sum += vals[j] * rules->weights[j];
-	  weight_sum += rules->weights[j];
-	}
-	double_val = sum / weight_sum;
-        break;
-      }
-      case MINIMUM_RULE: {
-	double_val = vals[0];
-	for (j = 1; j < rules->nprops; j++)
-	  if (double_val > vals[j])
-	    double_val = vals[j];
-        break;
-      }
-      case MAXIMUM_RULE: {
-	double_val = vals[0];
-	for (j = 1; j < rules->nprops; j++)
-	  if (double_val < vals[j])
-	    double_val = vals[j];
-        break;
-      }
-      case RANDOM_RULE: {
-	double_val = vals[random_pick];
-        break;
-      }
-      case SAME_RULE: {
-	double_val = vals[0];
-	for (j = 1; j < rules->nprops; j++)
-	  if (double_val != vals[j]) {
-	    fprintf (stderr,
-    "get_new_props_ply: Error combining properties that should be the same.\n");
-            exit (-1);
-	  }
-        break;
-      }
-      default:
-        fprintf (stderr, "get_new_props_ply: Bad rule = %d\n",
-	         rules->rule_list[i]);
-	exit (-1);
-    }
+    double_val = combine_values (rules->rule_list[i], vals, rules->weights,
+                                 rules->nprops, random_pick);
 
     /* store the combined value */
 
@@ -3233,6 +5049,102 @@ void *get_new_props_ply(PlyFile *ply)
 }
 
 
+/******************************************************************************
+Create many new sets of properties at once, each one combined from the same
+number of sets of "other" properties by the rules given to start_props_ply().
+The weights are those passed to weight_props_ply() since then, one for each
+set that goes into a new one; the pointers passed along with them are not
+used.  This gives the same values as calling get_new_props_ply() for each new
+set, but the work is done one property at a time over a run of new sets, and
+the results go into the caller's array rather than separate allocations.
+
+Lists and strings are not combined: a new set points at those of its first
+source, and copy_other_lists_ply() can give it copies of its own.
+
+Entry:
+  ply       - PLY object whose current rules are to be used
+  sources   - "other" properties to combine, nsources of them for each new
+              set, where nsources is the number of weights given
+  count     - number of new sets of properties to create
+  new_props - room for "count" sets of the element's other_size bytes
+******************************************************************************/
+
+void get_new_props_block_ply(
+  PlyFile *ply,
+  void **sources,
+  int count,
+  char *new_props
+)
+{
+  int i,j,k;
+  PlyPropRules *rules = ply->current_rules;
+  PlyElement *elem = rules->elem;
+  int nsources = rules->nprops;
+  int other_size = elem->other_size;
+  PlyProperty *prop;
+  const int run = 1024;
+  double *vals;
+  int first,n;
+  int int_val;
+  unsigned int uint_val;
+  double double_val;
+  char *ptr;
+
+  if (other_size == 0 || count == 0 || nsources == 0)
+    return;
+
+  /* values of one property for a run of new sets, sources side by side */
+  vals = (double *) myalloc (sizeof (double) * run * nsources);
+
+  for (i = 0; i < elem->nprops; i++) {
+
+    /* don't bother with properties we've been asked to store explicitly */
+    if (elem->store_prop[i])
+      continue;
+
+    prop = elem->props[i];
+
+    /* lists and strings are carried over from the first source */
+    if (prop->is_list != PLY_SCALAR) {
+      for (k = 0; k < count; k++) {
+        char *src = (char *) sources[(size_t) k * nsources];
+        ptr = new_props + (size_t) k * other_size;
+        *(char **) (ptr + prop->offset) = *(char **) (src + prop->offset);
+        if (prop->is_list == PLY_LIST)
+          memcpy (ptr + prop->count_offset, src + prop->count_offset,
+                  ply_type_size[prop->count_external]);
+      }
+      continue;
+    }
+
+    for (first = 0; first < count; first += run) {
+      n = (count - first < run) ? count - first : run;
+
+      /* collect together the values of the whole run */
+      for (k = 0; k < n * nsources; k++) {
+        ptr = (char *) sources[(size_t) first * nsources + k] + prop->offset;
+        get_stored_item ((void *) ptr, prop->external_type,
+                         &int_val, &uint_val, &double_val);
+        vals[k] = double_val;
+      }
+
+      /* combine and store them */
+      for (k = 0; k < n; k++) {
+        j = (rules->rule_list[i] == RANDOM_RULE) ? rand() % nsources : 0;
+        double_val = combine_values (rules->rule_list[i], vals + k * nsources,
+                                     rules->weights, nsources, j);
+        int_val = (int) double_val;
+        uint_val = (unsigned int) double_val;
+        ptr = new_props + (size_t) (first + k) * other_size + prop->offset;
+        store_item (ptr, prop->external_type, int_val, uint_val, double_val);
+      }
+    }
+  }
+
+  free (vals);
+}
+
+
 /******************************************************************************
 Set the list of user-specified property combination rules.
 ******************************************************************************/
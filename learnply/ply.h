@@ -64,6 +64,8 @@ extern "C" {
 #define  PLY_LIST    1
 #define  PLY_STRING  2
 
+extern char *type_names[];      /* names of the scalar types, by type */
+
 
 typedef struct PlyProperty {    /* description of a property */
 
@@ -136,6 +138,12 @@ typedef struct PlyRuleList {
   struct PlyRuleList *next;    /* pointer for linked list of rules */
 } PlyRuleList;
 
+typedef struct PlyArenaBlock {  /* block of memory that element data is carved out of */
+  struct PlyArenaBlock *next;   /* block that was filled before this one */
+  size_t size;                  /* size of the block, this header included */
+  size_t used;                  /* bytes of the block in use */
+} PlyArenaBlock;
+
 typedef struct PlyFile {        /* description of PLY file */
   FILE *fp;                     /* file pointer */
   int file_type;                /* ascii or binary */
@@ -150,6 +158,12 @@ typedef struct PlyFile {        /* description of PLY file */
   PlyOtherElems *other_elems;   /* "other" elements from a PLY file */
   PlyPropRules *current_rules;  /* current propagation rules */
   PlyRuleList *rule_list;       /* rule list from user */
+  char *map_base;               /* memory-mapped view of the file, or NULL */
+  size_t map_size;              /* size in bytes of the mapped view */
+  char *map_ptr;                /* read position of the body in the view */
+  void *map_handle;             /* platform handle that owns the mapping */
+  int use_arena;                /* carve element data out of the arena? */
+  PlyArenaBlock *arena;         /* blocks holding lists and other_props read so far */
 } PlyFile;
 
 /* memory allocation */
@@ -179,12 +193,15 @@ extern void ply_get_element(PlyFile *, void *);
 PlyOtherElems *get_other_element_ply (PlyFile *);
 
 PlyFile *read_ply(FILE *);
+PlyFile *probe_ply(char *);
+int get_element_count_ply(PlyFile *, char *);
 PlyFile *write_ply(FILE *, int, char **, int);
 extern PlyFile *open_for_writing_ply(char *, int, char **, int);
 void close_ply(PlyFile *);
 void free_ply(PlyFile *);
 
 void get_info_ply(PlyFile *, float *, int *);
+void free_other_properties_ply(PlyOtherProp *);
 void free_other_elements_ply (PlyOtherElems *);
 
 void append_comment_ply(PlyFile *, char *);
@@ -197,6 +214,7 @@ char **get_obj_info_ply(PlyFile *, int *);
 char **get_element_list_ply(PlyFile *, int *);
 void setup_property_ply(PlyFile *, PlyProperty *);
 void get_element_ply (PlyFile *, void *);
+void get_element_block_ply (PlyFile *, void *, int, int);
 char *setup_element_read_ply (PlyFile *, int, int *);
 PlyOtherProp *get_other_properties_ply(PlyFile *, int);
 
@@ -212,17 +230,32 @@ void element_layout_ply(PlyFile *, char *, int, int, PlyProperty *);
 void header_complete_ply(PlyFile *);
 void put_element_setup_ply(PlyFile *, char *);
 void put_element_ply(PlyFile *, void *);
+void put_element_block_ply(PlyFile *, void *, int, int);
 void put_other_elements_ply(PlyFile *);
 
+/* convert the number at a position in a buffer, leaving the position past it */
+double ascii_to_double(char **, char *);
+long long ascii_to_integer(char **, char *);
+
 PlyPropRules *init_rule_ply (PlyFile *, char *);
+void free_rule_ply (PlyPropRules *);
 void modify_rule_ply (PlyPropRules *, char *, int);
 void start_props_ply (PlyFile *, PlyPropRules *);
 void weight_props_ply (PlyFile *, float, void *);
 void *get_new_props_ply(PlyFile *);
+void get_new_props_block_ply(PlyFile *, void **, int, char *);
 void set_prop_rules_ply (PlyFile *, PlyRuleList *);
 PlyRuleList *append_prop_rule (PlyRuleList *, char *, char *);
 int matches_rule_name (char *);
 
+int map_body_ply(PlyFile *);
+void unmap_body_ply(PlyFile *);
+
+void use_arena_ply(PlyFile *);
+void free_arena_ply(PlyFile *);
+size_t other_lists_size_ply(PlyOtherProp *, char *, int);
+void copy_other_lists_ply(PlyOtherProp *, char *, int, char *);
+
 int equal_strings(char *, char *);
 char *recreate_command_line (int, char *argv[]);
 
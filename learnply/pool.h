@@ -0,0 +1,122 @@
+/*
+
+Pools that the elements of a mesh are made in
+
+A Pool<T> makes objects one after another in large blocks, so that making
+one costs little more than bumping a count, and releases all of them at
+once, a block at a time.  An object can't be given back on its own; one
+that is no longer wanted stays in its block until the pool is cleared.
+Objects never move once they are made.
+
+*/
+
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <stddef.h>
+#include <new>
+#include <utility>
+#include <vector>
+#include <type_traits>
+
+
+/* smallest and largest number of objects in a block that a pool picks itself */
+#define MIN_POOL_BLOCK  256
+#define MAX_POOL_BLOCK  65536
+
+template <class T>
+class Pool {
+  struct Block {
+    T *items;
+    size_t used;
+    size_t size;
+  };
+
+  std::vector<Block> blocks;
+  size_t next_size;   /* size of the next block, unless more is asked for */
+  size_t count;       /* objects made since the pool was last cleared */
+
+public:
+  Pool() : next_size(MIN_POOL_BLOCK), count(0) {}
+  ~Pool() { clear(); }
+
+  Pool(const Pool &) = delete;
+  Pool &operator=(const Pool &) = delete;
+
+  /* make one object from the given constructor arguments */
+  template <class... Args>
+  T *make(Args &&... args)
+  {
+    T *item = room(1);
+    new (item) T(std::forward<Args>(args)...);
+    count++;
+    return item;
+  }
+
+  /* make n value-initialized objects in a row */
+  T *alloc(size_t n)
+  {
+    T *items = room(n);
+    for (size_t i = 0; i < n; i++)
+      new (items + i) T();
+    count += n;
+    return items;
+  }
+
+  /* make sure the next n objects go in one block, made just big enough
+     for them if a new one is needed */
+  void reserve(size_t n)
+  {
+    if (blocks.empty() || blocks.back().used + n > blocks.back().size)
+      add_block(n);
+  }
+
+  /* destroy every object and free the blocks */
+  void clear()
+  {
+    for (size_t k = 0; k < blocks.size(); k++) {
+      if (!std::is_trivially_destructible<T>::value)
+        for (size_t i = 0; i < blocks[k].used; i++)
+          blocks[k].items[i].~T();
+      ::operator delete(blocks[k].items);
+    }
+    blocks.clear();
+    next_size = MIN_POOL_BLOCK;
+    count = 0;
+  }
+
+  void swap(Pool &other)
+  {
+    blocks.swap(other.blocks);
+    std::swap(next_size, other.next_size);
+    std::swap(count, other.count);
+  }
+
+  size_t size() const { return count; }
+
+private:
+  /* room for n objects in a row, in the last block or a new one */
+  T *room(size_t n)
+  {
+    if (blocks.empty() || blocks.back().used + n > blocks.back().size) {
+      add_block(n > next_size ? n : next_size);
+      if (next_size < MAX_POOL_BLOCK)
+        next_size *= 2;
+    }
+    Block &block = blocks.back();
+    T *items = block.items + block.used;
+    block.used += n;
+    return items;
+  }
+
+  void add_block(size_t n)
+  {
+    Block block;
+    block.items = (T *) ::operator new(n * sizeof(T));
+    block.used = 0;
+    block.size = n;
+    blocks.push_back(block);
+  }
+};
+
+#endif /* __POOL_H__ */
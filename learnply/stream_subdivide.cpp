@@ -0,0 +1,618 @@
+/*
+
+Out-of-core regular subdivision of PLY files.
+
+Each level of subdivision makes two passes over the faces of its input.
+The first pass records every edge in a table keyed by its two vertex
+indices, which numbers the edge midpoints once all the edges are known.
+The second pass reads the faces again and writes four triangles for each
+of them, looking the midpoints up in the table.  Levels past the first
+read the output of the level before from a temporary file.
+
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <limits.h>
+#include <vector>
+#include "ply.h"
+#include "stream_subdivide.h"
+
+
+/* positions are held as doubles, and written as the input's are */
+typedef struct StreamVertex {
+  double x,y,z;
+} StreamVertex;
+
+/* float32 positions are read as floats, so that ascii files written with
+   more digits than a float holds give the same vertices as binary ones */
+typedef struct StreamVertex32 {
+  float x,y,z;
+} StreamVertex32;
+
+typedef struct StreamFace {
+  unsigned char nverts;
+  int *verts;
+} StreamFace;
+
+static PlyProperty stream_vert_props[] = {
+  {"x", Float32, Float64, offsetof(StreamVertex,x), 0, 0, 0, 0},
+  {"y", Float32, Float64, offsetof(StreamVertex,y), 0, 0, 0, 0},
+  {"z", Float32, Float64, offsetof(StreamVertex,z), 0, 0, 0, 0},
+};
+
+static PlyProperty stream_vert32_props[] = {
+  {"x", Float32, Float32, offsetof(StreamVertex32,x), 0, 0, 0, 0},
+  {"y", Float32, Float32, offsetof(StreamVertex32,y), 0, 0, 0, 0},
+  {"z", Float32, Float32, offsetof(StreamVertex32,z), 0, 0, 0, 0},
+};
+
+static PlyProperty stream_face_props[] = {
+  {"vertex_indices", Int32, Int32, offsetof(StreamFace,verts),
+   1, Uint8, Uint8, offsetof(StreamFace,nverts)},
+};
+
+
+/* key of an unused slot in an EdgeMidpointTable */
+static const unsigned long long NO_EDGE = ~0ULL;
+
+
+/******************************************************************************
+Table of the edges of a mesh, keyed by the indices of their two vertices
+(smaller index first), with open addressing and linear probing.  Each slot
+holds a 64-bit key and the index of the edge's midpoint vertex.
+******************************************************************************/
+
+class EdgeMidpointTable {
+public:
+  EdgeMidpointTable() { nedges = 0; resize(1024); }
+
+  static unsigned long long key(int v0, int v1) {
+    if (v0 > v1) { int t = v0; v0 = v1; v1 = t; }
+    return ((unsigned long long) (unsigned int) v0 << 32) | (unsigned int) v1;
+  }
+
+  /* record an edge, if it isn't in the table yet */
+  void insert(int v0, int v1) {
+    if (2 * (nedges + 1) > keys.size())
+      resize(2 * keys.size());
+    size_t slot = find(key(v0, v1));
+    if (keys[slot] == NO_EDGE) {
+      keys[slot] = key(v0, v1);
+      nedges++;
+    }
+  }
+
+  /* give the edges consecutive midpoint indices, starting at "first" */
+  void number_midpoints(int first) {
+    for (size_t i = 0; i < keys.size(); i++)
+      if (keys[i] != NO_EDGE)
+        midpoints[i] = first++;
+  }
+
+  /* midpoint index of an edge that is in the table */
+  int midpoint(int v0, int v1) { return midpoints[find(key(v0, v1))]; }
+
+  size_t nslots() { return keys.size(); }
+  unsigned long long slot_key(size_t i) { return keys[i]; }
+
+  size_t nedges;
+
+private:
+  std::vector<unsigned long long> keys;
+  std::vector<int> midpoints;
+
+  size_t find(unsigned long long k) {
+    size_t mask = keys.size() - 1;
+    size_t slot = (size_t) ((k * 0x9E3779B97F4A7C15ULL) >> 20) & mask;
+    while (keys[slot] != NO_EDGE && keys[slot] != k)
+      slot = (slot + 1) & mask;
+    return slot;
+  }
+
+  void resize(size_t n) {
+    std::vector<unsigned long long> old;
+    old.swap(keys);
+    keys.assign(n, NO_EDGE);
+    midpoints.assign(n, -1);
+    for (size_t i = 0; i < old.size(); i++)
+      if (old[i] != NO_EDGE)
+        keys[find(old[i])] = old[i];
+  }
+};
+
+
+/******************************************************************************
+Open a PLY file and find its vertex and face elements.
+
+Entry:
+  name - name of the file
+
+Exit:
+  nverts     - number of vertices
+  nfaces     - number of faces
+  coord_type - Float64 if the vertex positions are doubles, else Float32
+  returns the file, or NULL if it can't be read
+******************************************************************************/
+
+static PlyFile *open_stream_input(char *name, int *nverts, int *nfaces,
+                                  int *coord_type)
+{
+  FILE *fp = fopen (name, "rb");
+  PlyFile *ply;
+  PlyElement *elem;
+  int i,j;
+
+  if (fp == NULL) {
+    fprintf (stderr, "Can't open '%s'.\n", name);
+    return (NULL);
+  }
+
+  ply = read_ply (fp);
+  if (ply == NULL) {
+    fprintf (stderr, "'%s' is not a PLY file.\n", name);
+    fclose (fp);
+    return (NULL);
+  }
+
+  use_arena_ply (ply);
+
+  *nverts = *nfaces = -1;
+  *coord_type = Float32;
+  for (i = 0; i < ply->num_elem_types; i++) {
+    elem = ply->elems[i];
+    if (equal_strings ("vertex", elem->name)) {
+      *nverts = elem->num;
+      for (j = 0; j < elem->nprops; j++)
+        if (equal_strings ("x", elem->props[j]->name) &&
+            elem->props[j]->external_type == Float64)
+          *coord_type = Float64;
+    }
+    else if (equal_strings ("face", elem->name))
+      *nfaces = elem->num;
+  }
+
+  if (*nverts < 0 || *nfaces < 0) {
+    fprintf (stderr, "'%s' has no vertex or face elements.\n", name);
+    close_ply (ply);
+    free_ply (ply);
+    return (NULL);
+  }
+
+  return (ply);
+}
+
+
+/******************************************************************************
+Tell whether a PLY file has anything that the streamed subdivision leaves
+out: vertex properties besides x, y and z, face properties besides
+vertex_indices, or elements other than vertices and faces.
+
+Entry:
+  ply - file opened by open_stream_input()
+******************************************************************************/
+
+static int has_other_properties(PlyFile *ply)
+{
+  int i,j;
+
+  for (i = 0; i < ply->num_elem_types; i++) {
+    PlyElement *elem = ply->elems[i];
+    for (j = 0; j < elem->nprops; j++) {
+      char *name = elem->props[j]->name;
+      if (equal_strings ("vertex", elem->name) &&
+          (equal_strings ("x", name) || equal_strings ("y", name) ||
+           equal_strings ("z", name)))
+        continue;
+      if (equal_strings ("face", elem->name) &&
+          equal_strings ("vertex_indices", name))
+        continue;
+      return (1);
+    }
+  }
+
+  return (0);
+}
+
+
+/******************************************************************************
+Read the vertices of a PLY file, either into a table or (when "verts" is
+NULL) just to get past them, and then step over any elements up to the faces.
+
+Entry:
+  ply        - file opened by open_stream_input()
+  nverts     - number of vertices
+  coord_type - type of the positions, from open_stream_input()
+
+Exit:
+  verts - the vertex positions, unless NULL
+  returns the number of faces, or -1 if the vertices don't come before them
+******************************************************************************/
+
+static int read_stream_vertices(PlyFile *ply, StreamVertex *verts, int nverts,
+                                int coord_type)
+{
+  int i,j,k;
+  int elem_count;
+  char *elem_name;
+  int seen_verts = 0;
+  std::vector<StreamVertex> scratch;
+  std::vector<StreamVertex32> scratch32;
+
+  for (i = 0; i < ply->num_elem_types; i++) {
+
+    elem_name = setup_element_read_ply (ply, i, &elem_count);
+
+    if (equal_strings ("vertex", elem_name)) {
+      if (coord_type == Float32) {
+        for (j = 0; j < 3; j++)
+          setup_property_ply (ply, &stream_vert32_props[j]);
+        scratch32.resize (STREAM_BATCH_FACES);
+        for (j = 0; j < nverts; j += STREAM_BATCH_FACES) {
+          int n = nverts - j < STREAM_BATCH_FACES ? nverts - j : STREAM_BATCH_FACES;
+          get_element_block_ply (ply, (void *) &scratch32[0], sizeof (StreamVertex32), n);
+          for (k = 0; verts != NULL && k < n; k++) {
+            verts[j+k].x = scratch32[k].x;
+            verts[j+k].y = scratch32[k].y;
+            verts[j+k].z = scratch32[k].z;
+          }
+        }
+      }
+      else {
+        for (j = 0; j < 3; j++)
+          setup_property_ply (ply, &stream_vert_props[j]);
+        if (verts != NULL)
+          get_element_block_ply (ply, (void *) verts, sizeof (StreamVertex), nverts);
+        else {
+          scratch.resize (STREAM_BATCH_FACES);
+          for (j = 0; j < nverts; j += STREAM_BATCH_FACES) {
+            int n = nverts - j < STREAM_BATCH_FACES ? nverts - j : STREAM_BATCH_FACES;
+            get_element_block_ply (ply, (void *) &scratch[0], sizeof (StreamVertex), n);
+          }
+        }
+      }
+      seen_verts = 1;
+    }
+    else if (equal_strings ("face", elem_name)) {
+      if (!seen_verts) {
+        fprintf (stderr, "Faces come before vertices in PLY file.\n");
+        return (-1);
+      }
+      setup_property_ply (ply, &stream_face_props[0]);
+      return (elem_count);
+    }
+    else
+      get_other_element_ply (ply);
+  }
+
+  return (-1);
+}
+
+
+/******************************************************************************
+Read the next batch of triangles.  Their index lists come from the file's
+arena, which is emptied again once they have been copied out.
+
+Entry:
+  ply   - file positioned in its face elements
+  faces - room for "count" faces
+  count - number of faces to read
+
+Exit:
+  tris - three vertex indices per face
+  returns 0 if all the faces are triangles, -1 if not or if the file ends
+  before they do
+******************************************************************************/
+
+static int read_stream_triangles(PlyFile *ply, StreamFace *faces, int *tris, int count)
+{
+  int i;
+  int result = 0;
+
+  get_element_block_ply (ply, (void *) faces, sizeof (StreamFace), count);
+
+  /* a mapped body stops at its end on its own, but a stream just comes up
+     short */
+  if (ply->map_base == NULL && (feof (ply->fp) || ferror (ply->fp))) {
+    fprintf (stderr, "PLY file ends in the middle of its faces.\n");
+    free_arena_ply (ply);
+    return (-1);
+  }
+
+  for (i = 0; i < count; i++) {
+    StreamFace &face = faces[i];
+    if (face.nverts != 3) {
+      fprintf (stderr, "Face has %d vertices (should be three).\n", face.nverts);
+      result = -1;
+      break;
+    }
+    tris[3*i]   = face.verts[0];
+    tris[3*i+1] = face.verts[1];
+    tris[3*i+2] = face.verts[2];
+  }
+
+  free_arena_ply (ply);
+  return (result);
+}
+
+
+/******************************************************************************
+Tell whether a triangle uses the same vertex more than once.  Such triangles
+are dropped, as they are when a Polyhedron is read in.
+******************************************************************************/
+
+static int degenerate(int *t)
+{
+  return (t[0] == t[1] || t[1] == t[2] || t[2] == t[0]);
+}
+
+
+/******************************************************************************
+Subdivide the mesh in one PLY file into another, once.
+
+Entry:
+  in_name     - name of the file to read
+  out_name    - name of the file to write
+  batch_faces - number of faces to hold in memory at once
+
+Exit:
+  returns 0 on success, -1 on failure
+******************************************************************************/
+
+static int stream_subdivide_level(char *in_name, char *out_name, int batch_faces)
+{
+  int i,j;
+  int nverts, nfaces;
+  int coord_type;
+  int ntris = 0;
+  PlyFile *in_ply;
+  PlyFile *out_ply;
+  FILE *out_fp;
+  std::vector<StreamVertex> verts;
+  std::vector<int> tris (3 * batch_faces);
+  std::vector<StreamFace> in_faces (batch_faces);
+  EdgeMidpointTable edges;
+  char *elem_names[] = {"vertex", "face"};
+  char comment[] = "subdivided by learnply";
+
+  /*** first pass: read the vertices and find all the edges ***/
+
+  in_ply = open_stream_input (in_name, &nverts, &nfaces, &coord_type);
+  if (in_ply == NULL)
+    return (-1);
+
+  if (has_other_properties (in_ply))
+    fprintf (stderr, "note: only the positions and faces of '%s' are subdivided; "
+             "its other properties are left out.\n", in_name);
+
+  verts.resize (nverts > 0 ? nverts : 1);
+  if (read_stream_vertices (in_ply, &verts[0], nverts, coord_type) != nfaces) {
+    close_ply (in_ply);
+    free_ply (in_ply);
+    return (-1);
+  }
+
+  for (i = 0; i < nfaces; i += batch_faces) {
+    int n = nfaces - i < batch_faces ? nfaces - i : batch_faces;
+    if (read_stream_triangles (in_ply, &in_faces[0], &tris[0], n) < 0) {
+      close_ply (in_ply);
+      free_ply (in_ply);
+      return (-1);
+    }
+    for (j = 0; j < n; j++) {
+      int *t = &tris[3*j];
+      if (t[0] < 0 || t[1] < 0 || t[2] < 0 ||
+          t[0] >= nverts || t[1] >= nverts || t[2] >= nverts) {
+        fprintf (stderr, "Face refers to a vertex that doesn't exist.\n");
+        close_ply (in_ply);
+        free_ply (in_ply);
+        return (-1);
+      }
+      if (degenerate (t))
+        continue;
+      ntris++;
+      edges.insert (t[0], t[1]);
+      edges.insert (t[1], t[2]);
+      edges.insert (t[2], t[0]);
+    }
+  }
+
+  if ((double) nverts + edges.nedges > INT_MAX || 4.0 * ntris > INT_MAX) {
+    fprintf (stderr, "Subdivided mesh is too large for a PLY file.\n");
+    close_ply (in_ply);
+    free_ply (in_ply);
+    return (-1);
+  }
+
+  edges.number_midpoints (nverts);
+
+  /*** write the header and all the vertices ***/
+
+  out_fp = fopen (out_name, "wb");
+  if (out_fp == NULL) {
+    fprintf (stderr, "Can't write '%s'.\n", out_name);
+    close_ply (in_ply);
+    free_ply (in_ply);
+    return (-1);
+  }
+
+  out_ply = write_ply (out_fp, 2, elem_names, PLY_BINARY_LE);
+  describe_element_ply (out_ply, "vertex", nverts + (int) edges.nedges);
+  for (j = 0; j < 3; j++) {
+    PlyProperty prop = stream_vert_props[j];
+    prop.external_type = coord_type;
+    describe_property_ply (out_ply, &prop);
+  }
+  describe_element_ply (out_ply, "face", 4 * ntris);
+  describe_property_ply (out_ply, &stream_face_props[0]);
+  copy_comments_ply (out_ply, in_ply);
+  append_comment_ply (out_ply, comment);
+  copy_obj_info_ply (out_ply, in_ply);
+  header_complete_ply (out_ply);
+
+  close_ply (in_ply);
+  free_ply (in_ply);
+
+  put_element_setup_ply (out_ply, "vertex");
+  put_element_block_ply (out_ply, (void *) &verts[0], sizeof (StreamVertex), nverts);
+
+  /* midpoints go out in the order they were numbered */
+  std::vector<StreamVertex> mids;
+  mids.reserve (batch_faces);
+  for (size_t s = 0; s < edges.nslots (); s++) {
+    unsigned long long k = edges.slot_key (s);
+    if (k == NO_EDGE)
+      continue;
+    StreamVertex &v0 = verts[(int) (k >> 32)];
+    StreamVertex &v1 = verts[(int) (k & 0xffffffff)];
+    StreamVertex mid;
+    mid.x = (v0.x + v1.x) / 2.0;
+    mid.y = (v0.y + v1.y) / 2.0;
+    mid.z = (v0.z + v1.z) / 2.0;
+    mids.push_back (mid);
+    if ((int) mids.size () == batch_faces) {
+      put_element_block_ply (out_ply, (void *) &mids[0], sizeof (StreamVertex), (int) mids.size ());
+      mids.clear ();
+    }
+  }
+  if (!mids.empty ())
+    put_element_block_ply (out_ply, (void *) &mids[0], sizeof (StreamVertex), (int) mids.size ());
+
+  std::vector<StreamVertex> ().swap (verts);
+  std::vector<StreamVertex> ().swap (mids);
+
+  /*** second pass: read the faces again and write four for each ***/
+
+  in_ply = open_stream_input (in_name, &nverts, &nfaces, &coord_type);
+  if (in_ply == NULL || read_stream_vertices (in_ply, NULL, nverts, coord_type) != nfaces) {
+    if (in_ply != NULL) {
+      close_ply (in_ply);
+      free_ply (in_ply);
+    }
+    close_ply (out_ply);
+    free_ply (out_ply);
+    remove (out_name);
+    return (-1);
+  }
+
+  put_element_setup_ply (out_ply, "face");
+
+  std::vector<int> new_tris (12 * batch_faces);
+  std::vector<StreamFace> faces (4 * batch_faces);
+  for (j = 0; j < 4 * batch_faces; j++) {
+    faces[j].nverts = 3;
+    faces[j].verts = &new_tris[3*j];
+  }
+
+  for (i = 0; i < nfaces; i += batch_faces) {
+    int n = nfaces - i < batch_faces ? nfaces - i : batch_faces;
+    int nout = 0;
+    int result = read_stream_triangles (in_ply, &in_faces[0], &tris[0], n);
+
+    for (j = 0; j < n && result == 0; j++) {
+      int *t = &tris[3*j];
+      if (t[0] < 0 || t[1] < 0 || t[2] < 0 ||
+          t[0] >= nverts || t[1] >= nverts || t[2] >= nverts) {
+        fprintf (stderr, "Face refers to a vertex that doesn't exist.\n");
+        result = -1;
+        break;
+      }
+      if (degenerate (t))
+        continue;
+      int m0 = edges.midpoint (t[0], t[1]);
+      int m1 = edges.midpoint (t[1], t[2]);
+      int m2 = edges.midpoint (t[2], t[0]);
+      if (m0 < 0 || m1 < 0 || m2 < 0) {
+        fprintf (stderr, "Faces changed between the two passes.\n");
+        result = -1;
+        break;
+      }
+      int *out = &new_tris[12 * nout++];
+
+      /* same four triangles, in the same order, as subdivideRegular() */
+      out[0] = t[0];  out[1]  = m0;    out[2]  = m2;
+      out[3] = m0;    out[4]  = m1;    out[5]  = m2;
+      out[6] = m0;    out[7]  = t[1];  out[8]  = m1;
+      out[9] = m2;    out[10] = m1;    out[11] = t[2];
+    }
+
+    if (result < 0) {
+      close_ply (in_ply);
+      free_ply (in_ply);
+      close_ply (out_ply);
+      free_ply (out_ply);
+      remove (out_name);
+      return (-1);
+    }
+
+    put_element_block_ply (out_ply, (void *) &faces[0], sizeof (StreamFace), 4 * nout);
+  }
+
+  close_ply (in_ply);
+  free_ply (in_ply);
+  close_ply (out_ply);
+  free_ply (out_ply);
+
+  return (0);
+}
+
+
+/******************************************************************************
+Subdivide the mesh in a PLY file "levels" times.  Each level but the last
+writes its result to a temporary file next to the output, which is removed
+once the following level has read it.
+
+Entry:
+  in_name     - name of the file to read
+  out_name    - name of the file to write
+  levels      - number of times to subdivide
+  batch_faces - number of faces to hold in memory at once
+
+Exit:
+  returns 0 on success, -1 on failure
+******************************************************************************/
+
+int stream_subdivide_regular(char *in_name, char *out_name, int levels,
+                             int batch_faces)
+{
+  int level;
+  int result = 0;
+  char *names[2];
+  char *src = in_name;
+
+  if (levels < 1) {
+    fprintf (stderr, "Number of subdivision levels must be at least one.\n");
+    return (-1);
+  }
+  if (batch_faces < 1)
+    batch_faces = STREAM_BATCH_FACES;
+
+  names[0] = new char[strlen (out_name) + 16];
+  names[1] = new char[strlen (out_name) + 16];
+
+  for (level = 1; level <= levels && result == 0; level++) {
+    char *dst;
+
+    if (level == levels)
+      dst = out_name;
+    else {
+      dst = names[level % 2];
+      sprintf (dst, "%s.level%d", out_name, level);
+    }
+
+    result = stream_subdivide_level (src, dst, batch_faces);
+
+    if (src != in_name)
+      remove (src);
+    src = dst;
+  }
+
+  if (result != 0 && src != in_name && src != out_name)
+    remove (src);
+
+  delete[] names[0];
+  delete[] names[1];
+  return (result);
+}
@@ -0,0 +1,26 @@
+/*
+
+Out-of-core regular subdivision of PLY files
+
+*/
+
+#ifndef __STREAM_SUBDIVIDE_H__
+#define __STREAM_SUBDIVIDE_H__
+
+/* default number of faces held in memory at once */
+const int STREAM_BATCH_FACES = 65536;
+
+/*
+Subdivide a triangle mesh in a PLY file "levels" times, splitting every
+triangle into four as Polyhedron::subdivideRegular() does, and write the
+result to a binary_little_endian PLY file, with positions of the same type
+as the input's.  Only the vertex positions and the edge midpoint table are
+kept in memory; faces are streamed through in batches of batch_faces.
+Properties other than the positions and the faces' vertex indices are
+left out of the result, which is noted on stderr.
+Returns 0 on success, -1 on failure.
+*/
+int stream_subdivide_regular(char *in_name, char *out_name, int levels,
+                             int batch_faces = STREAM_BATCH_FACES);
+
+#endif /* __STREAM_SUBDIVIDE_H__ */